@@ -43,3 +43,108 @@ layout(set = BindlessDescriptorSet, binding = BindlessSamplerBinding) \
 
 #define GetTexture2D(index) uGlobalTextures2D[index]
 #define GetTextureCube(index) uGlobalTexturesCube[index]
+
+// --- Texture slots, see TextureCache::GetTextureSlotsBufferHandle() --- //
+
+// Streamed textures move to a new slot when their mip levels change, frames in flight keep sampling the previous one
+RegisterBuffer(std430, readonly, TextureSlotBuffer, {
+    uint slots[MAX_DESCRIPTOR_COUNT];
+});
+#define GetTextureSlot(textureSlots, textureIndex) GetResource(TextureSlotBuffer, textureSlots).slots[textureIndex]
+
+// --- Virtual textures, see VirtualTextureCache.h --- //
+
+#define VirtualTexturePageSize 128
+#define VirtualTexturePageBorder 4 // texels of the neighboring pages around each page in the page cache
+#define VirtualTexturePageSlotSize (VirtualTexturePageSize + 2 * VirtualTexturePageBorder)
+#define VirtualTextureFeedbackTileSize 16 // a single pixel of each tile writes the pages it samples
+
+struct VirtualTexture
+{
+    uint width; // of level 0
+    uint height;
+    uint levelCount; // split in pages, 0 if the texture is not virtual
+    uint firstPage; // levels follow each other from the finest
+    uint pageCache; // texture of the resident pages of the format
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+// Textures are indexed by the handle of their coarsest levels
+RegisterBuffer(std430, readonly, VirtualTextureBuffer, {
+    VirtualTexture textures[MAX_DESCRIPTOR_COUNT];
+    uint pages[]; // 0 if not resident, otherwise 1 << 31 | slotY << 16 | slotX
+});
+
+// Read back by the CPU once the frame completes
+RegisterBuffer(std430, restrict, TextureFeedbackBuffer, {
+    uint frame;
+    uint capacity;
+    uint count;
+    uint pad;
+    uint requests[]; // textureIndex << 22 | level << 18 | pageY << 9 | pageX
+});
+
+void RequestVirtualTexturePage(uint feedback, uint textureIndex, uint level, uvec2 page, uvec2 pixel)
+{
+    // Another pixel of the tile every frame, all of them are visited after 256 frames
+    const uint tileArea = VirtualTextureFeedbackTileSize * VirtualTextureFeedbackTileSize;
+    uint tilePixel = (GetResource(TextureFeedbackBuffer, feedback).frame * 7u) % tileArea;
+    uvec2 requestPixel = uvec2(tilePixel % VirtualTextureFeedbackTileSize, tilePixel / VirtualTextureFeedbackTileSize);
+    if (any(notEqual(pixel % VirtualTextureFeedbackTileSize, requestPixel)))
+        return;
+
+    uint requestIndex = atomicAdd(GetResource(TextureFeedbackBuffer, feedback).count, 1u);
+    if (requestIndex < GetResource(TextureFeedbackBuffer, feedback).capacity)
+        GetResource(TextureFeedbackBuffer, feedback).requests[requestIndex] = (textureIndex << 22) | (level << 18) | (page.y << 9) | page.x;
+}
+
+// Samples the finest resident page around the level of the gradients, or the coarsest levels when no page is resident.
+// Levels are not blended and page caches are sampled without anisotropy.
+vec4 SampleVirtualTexture2D(uint virtualTextures, uint feedback, uint textureIndex, vec2 uv, vec2 dUVdx, vec2 dUVdy, uvec2 pixel)
+{
+    VirtualTexture virtualTexture = GetResource(VirtualTextureBuffer, virtualTextures).textures[textureIndex];
+    uvec2 size = uvec2(virtualTexture.width, virtualTexture.height);
+    vec2 dx = dUVdx * vec2(size);
+    vec2 dy = dUVdy * vec2(size);
+    uint level = uint(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0)));
+    if (level >= virtualTexture.levelCount)
+        return textureGrad(GetTexture2D(textureIndex), uv, dUVdx, dUVdy);
+
+    // Pages wrap around like the repeat address mode
+    vec2 wrappedUV = fract(uv);
+    uvec2 pageCount = size / VirtualTexturePageSize;
+    uint pageOffset = virtualTexture.firstPage;
+    for (uint i = 0; i < level; ++i)
+        pageOffset += (pageCount.x >> i) * (pageCount.y >> i);
+
+    RequestVirtualTexturePage(feedback, textureIndex, level, min(uvec2(wrappedUV * vec2(pageCount >> level)), (pageCount >> level) - 1u), pixel);
+
+    // Coarser pages cover the missing ones until they are loaded
+    for (uint i = level; i < virtualTexture.levelCount; ++i)
+    {
+        uvec2 levelPageCount = pageCount >> i;
+        vec2 pageCoord = wrappedUV * vec2(levelPageCount);
+        uvec2 page = min(uvec2(pageCoord), levelPageCount - 1u);
+        uint entry = GetResource(VirtualTextureBuffer, virtualTextures).pages[pageOffset + page.y * levelPageCount.x + page.x];
+        if (entry != 0u)
+        {
+            uvec2 slot = uvec2(entry & 0xffffu, (entry >> 16) & 0x7fffu);
+            vec2 cacheTexel = vec2(slot * VirtualTexturePageSlotSize + VirtualTexturePageBorder) + (pageCoord - vec2(page)) * VirtualTexturePageSize;
+            vec2 cacheSize = vec2(textureSize(GetTexture2D(virtualTexture.pageCache), 0));
+            return textureLod(GetTexture2D(virtualTexture.pageCache), cacheTexel / cacheSize, 0.0);
+        }
+        pageOffset += levelPageCount.x * levelPageCount.y;
+    }
+    return textureGrad(GetTexture2D(textureIndex), uv, dUVdx, dUVdy);
+}
+
+// Samples a texture loaded by the texture cache, streamed, virtual or neither. virtualTextures is invalid when virtual texturing is disabled.
+// Virtual textures are never streamed, they keep the slot of their handle.
+vec4 SampleTexture2D(uint textureSlots, uint virtualTextures, uint feedback, uint textureIndex, vec2 uv, vec2 dUVdx, vec2 dUVdy, uvec2 pixel)
+{
+    if (virtualTextures < MAX_DESCRIPTOR_COUNT && GetResource(VirtualTextureBuffer, virtualTextures).textures[textureIndex].levelCount != 0u)
+        return SampleVirtualTexture2D(virtualTextures, feedback, textureIndex, uv, dUVdx, dUVdy, pixel);
+    return textureGrad(GetTexture2D(GetTextureSlot(textureSlots, textureIndex)), uv, dUVdx, dUVdy);
+}
@@ -0,0 +1,16 @@
+// assumes:
+// #include "bindless.glsl"
+
+// Matches IndirectDrawData, indexed with gl_InstanceIndex
+// since each indirect command's firstInstance is the index of its first draw data
+struct DrawData
+{
+    uint sceneNodeIndex;
+    uint materialIndex;
+};
+
+RegisterBuffer(std430, readonly, DrawDataBuffer, {
+    DrawData draws[];
+});
+
+#define GetDrawData(drawDataBuffer) GetResource(DrawDataBuffer, drawDataBuffer).draws
@@ -97,12 +97,17 @@ RegisterBuffer(std430, readonly, MaterialBuffer, {
 });
 #define GetMaterials(bufferHandle) GetResource(MaterialBuffer, bufferHandle).materials
 
+// Shaders sampling streamed or virtual textures define it before including this file, see SampleTexture2D() in bindless.glsl
+#ifndef SampleMaterialTexture
+#define SampleMaterialTexture(textureIndex, uv) texture(GetTexture2D(textureIndex), uv)
+#endif
+
 vec4 GetBaseColor(Material material, vec2 fragTexCoord)
 {
     if (material.baseColorTexture < MAX_DESCRIPTOR_COUNT)
     {
-        vec4 sRgbColor = texture(GetTexture2D(material.baseColorTexture), fragTexCoord);
-        return material.baseColor * accurateSRGBToLinear(sRgbColor);
+        // sRGB format, the sampler returns linear values
+        return material.baseColor * SampleMaterialTexture(material.baseColorTexture, fragTexCoord);
     }
     return material.baseColor;
 }
@@ -112,8 +117,7 @@ vec4 GetEmissive(Material material, vec2 fragTexCoord)
 {
     if (material.emissiveTexture < MAX_DESCRIPTOR_COUNT)
     {
-        vec4 sRgbColor = texture(GetTexture2D(material.emissiveTexture), fragTexCoord);
-        return material.emissive * accurateSRGBToLinear(sRgbColor);
+        return material.emissive * SampleMaterialTexture(material.emissiveTexture, fragTexCoord);
     }
     return material.emissive;
 }
@@ -124,7 +128,9 @@ vec3 GetNormal(Material material, vec3 fragPos, vec2 fragTexCoord, vec3 fragNorm
     vec3 tangentNormal;
     if (material.normalsTexture < MAX_DESCRIPTOR_COUNT)
     {
-        tangentNormal = texture(GetTexture2D(material.normalsTexture), fragTexCoord).xyz * 2.0 - 1.0;
+        // Two channel format, z is reconstructed from the unit length
+        vec2 xy = SampleMaterialTexture(material.normalsTexture, fragTexCoord).xy * 2.0 - 1.0;
+        tangentNormal = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
     }
     else
     {
@@ -148,7 +154,7 @@ vec3 GetOcclusionRoughnessMetallic(Material material, vec2 fragTexCoord)
 {
     if (material.oclusionMetallicRoughnessTexture < MAX_DESCRIPTOR_COUNT)
     {
-        vec4 result = texture(GetTexture2D(material.oclusionMetallicRoughnessTexture), fragTexCoord);
+        vec4 result = SampleMaterialTexture(material.oclusionMetallicRoughnessTexture, fragTexCoord);
         return vec3(material.ambientOcclusion * result.r, material.perceptualRoughness * result.g, material.metallic * result.b);
     }
     return vec3(material.ambientOcclusion, material.perceptualRoughness, material.metallic);
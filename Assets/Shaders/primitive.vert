@@ -5,26 +5,19 @@
 
 // --- Inputs / Outputs --- //
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec2 inTexCoord;
+// Vertices are read from the position and attribute streams, see vertex_format.glsl
 
 layout(location = 0) out vec2 fragTexCoord;
 layout(location = 1) out vec3 fragNormal;
 layout(location = 2) out vec3 fragPos;
 layout(location = 3) out vec3 viewPos;
-
-// --- Push Contants -- //
-
-layout(push_constant)
-    uniform SceneNodeIndex {
-	    layout(offset = 0) uint sceneNodeIndex; // index into MeshTransforms.transforms
-        layout(offset = 4) uint materialIndex;
-    } pc;
+layout(location = 4) flat out uint fragMaterialIndex;
 
 // --- Descriptors --- //
 
 #include "view.glsl"
+#include "draw_data.glsl"
+#include "vertex_format.glsl"
 
 RegisterBuffer(std430, readonly, MeshTransforms, {
     mat4 transforms[];
@@ -38,7 +31,10 @@ layout(set = 1, binding = 0) uniform DrawParameters {
   uint lightCount;
   uint materials;
   uint shadowTransforms;
-  uint pad0; uint pad1;
+  uint drawData;
+  uint nodeBounds;
+  uint positions;
+  uint attributes;
 } uDrawParams;
 
 #define GetView() GetResource(ViewUniforms, uDrawParams.view).view
@@ -47,11 +43,15 @@ layout(set = 1, binding = 0) uniform DrawParameters {
 // ---
 
 void main() {
-    mat4 transform = GetTransforms()[pc.sceneNodeIndex];
-    vec4 pos = transform * vec4(inPosition, 1.0); 
+    DrawData drawData = GetDrawData(uDrawParams.drawData)[gl_InstanceIndex];
+    mat4 transform = GetTransforms()[drawData.sceneNodeIndex];
+    vec3 position = LoadPosition(uDrawParams.positions, uint(gl_VertexIndex), uDrawParams.nodeBounds, drawData.sceneNodeIndex);
+    VertexAttributes attributes = LoadAttributes(uDrawParams.attributes, uint(gl_VertexIndex));
+    vec4 pos = transform * vec4(position, 1.0);
     fragPos = pos.xyz / pos.w;
     gl_Position = GetView().proj * GetView().view * vec4(fragPos, 1.0);
-    fragTexCoord = inTexCoord;
-    fragNormal = normalize(transpose(inverse(mat3(transform))) * inNormal);
+    fragTexCoord = attributes.uv;
+    fragNormal = normalize(transpose(inverse(mat3(transform))) * attributes.normal);
     viewPos = GetView().pos;
+    fragMaterialIndex = drawData.materialIndex;
 }
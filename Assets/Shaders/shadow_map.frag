@@ -16,7 +16,8 @@ layout(push_constant)
 layout(set = 1, binding = 0) uniform DrawParameters {
     uint meshTransforms;
     uint shadowViews;
-    uint pad0; uint pad1;
+    uint drawData;
+    uint pad0;
 } uDrawParams;
 
 void main() {
@@ -5,17 +5,13 @@
 
 // --- Inputs / Outputs --- //
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec2 inTexCoord;
+// Only positions are read, see vertex_format.glsl
 
 // --- Constants --- //
 
-// todo (hbedard): use draw indirect instead
 layout(push_constant)
     uniform ShadowIndex {
 	    layout(offset = 0) uint shadowIndex; // index into shadow.transforms
-	    layout(offset = 4) uint sceneTreeNodeIndex; // index into model.transforms
     } pc;
 
 // --- Descriptors --- //
@@ -26,6 +22,9 @@ struct ShadowView {
     vec3 pos;
 };
 
+#include "draw_data.glsl"
+#include "vertex_format.glsl"
+
 RegisterBuffer(std430, readonly, MeshTransforms, {
     mat4 transforms[];
 });
@@ -37,7 +36,9 @@ RegisterBuffer(std430, readonly, ShadowViews, {
 layout(set = 1, binding = 0) uniform DrawParameters {
     uint meshTransforms;
     uint shadowViews;
-    uint pad0; uint pad1;
+    uint drawData;
+    uint nodeBounds;
+    uint positions;
 } uDrawParams;
 
 #define GetMeshTransforms() GetResource(MeshTransforms, uDrawParams.meshTransforms).transforms
@@ -46,7 +47,9 @@ layout(set = 1, binding = 0) uniform DrawParameters {
 // ---
 
 void main() {
-    vec3 fragPos = vec3(GetMeshTransforms()[pc.sceneTreeNodeIndex] * vec4(inPosition, 1.0));
+    uint sceneNodeIndex = GetDrawData(uDrawParams.drawData)[gl_InstanceIndex].sceneNodeIndex;
+    vec3 position = LoadPosition(uDrawParams.positions, uint(gl_VertexIndex), uDrawParams.nodeBounds, sceneNodeIndex);
+    vec3 fragPos = vec3(GetMeshTransforms()[sceneNodeIndex] * vec4(position, 1.0));
     ShadowView shadow = GetShadowViews()[pc.shadowIndex];
     gl_Position = shadow.proj * shadow.view * vec4(fragPos, 1.0);
 }
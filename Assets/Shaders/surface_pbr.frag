@@ -9,20 +9,10 @@ layout(location = 0) in vec2 fragTexCoord;
 layout(location = 1) in vec3 fragNormal;
 layout(location = 2) in vec3 fragPos;
 layout(location = 3) in vec3 viewPos;
+layout(location = 4) flat in uint fragMaterialIndex; // index into material.properties
 
 layout(location = 0) out vec4 outColor;
 
-// --- Constants --- //
-
-layout(push_constant)
-    uniform MaterialIndex {
-	    layout(offset = 0) uint sceneNodeIndex;
-	    layout(offset = 4) uint materialIndex; // index into material.properties
-    } pc;
-
-#include "view.glsl"
-#include "pbr.glsl"
-
 layout(set = 1, binding = 0) uniform DrawParameters {
   uint view;
   uint transforms;
@@ -30,9 +20,22 @@ layout(set = 1, binding = 0) uniform DrawParameters {
   uint lightCount;
   uint materials;
   uint shadows;
-  uint pad0; uint pad1;
+  uint drawData;
+  uint nodeBounds;
+  uint positions;
+  uint attributes;
+  uint virtualTextures;
+  uint textureFeedback;
+  uint textureSlots;
 } uDrawParams;
 
+// Material textures can be streamed or virtual, the pages they sample are written to the feedback of the frame
+#define SampleMaterialTexture(textureIndex, uv) \
+    SampleTexture2D(uDrawParams.textureSlots, uDrawParams.virtualTextures, uDrawParams.textureFeedback, textureIndex, uv, dFdx(uv), dFdy(uv), uvec2(gl_FragCoord.xy))
+
+#include "view.glsl"
+#include "pbr.glsl"
+
 #define GetView() GetResource(ViewUniforms, uDrawParams.view).view
 
 void main() {
@@ -42,7 +45,7 @@ void main() {
     uint debugEquation = view.debugEquation;
     vec4 color = BRDF_Lighting(
         fragPos, fragTexCoord, fragNormal, viewPos,
-        uDrawParams.materials, pc.materialIndex,
+        uDrawParams.materials, fragMaterialIndex,
         uDrawParams.lights, uDrawParams.lightCount,
         uDrawParams.shadows, 
         view);
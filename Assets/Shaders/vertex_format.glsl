@@ -0,0 +1,95 @@
+// assumes:
+// #include "bindless.glsl"
+
+// Matches VertexFormat
+#define VERTEX_FORMAT_FLOAT 0
+#define VERTEX_FORMAT_QUANTIZED 1
+
+// Set from MeshAllocator::GetVertexFormat() when creating the pipeline
+layout(constant_id = 0) const uint kVertexFormat = VERTEX_FORMAT_FLOAT;
+
+// Matches the bounds of SceneTree::GetBoundsBufferHandle()
+struct NodeBounds
+{
+    vec4 center;
+    vec4 extent;
+};
+
+RegisterBuffer(std430, readonly, NodeBoundsBuffer, {
+    NodeBounds bounds[];
+});
+
+#define GetNodeBounds(boundsBuffer) GetResource(NodeBoundsBuffer, boundsBuffer).bounds
+
+// Vertices are pulled with gl_VertexIndex from two streams, see MeshAllocator:
+// - positions: vec3 or QuantizedPosition
+// - attributes: VertexAttributes or QuantizedAttributes
+RegisterBuffer(std430, readonly, VertexPositions, {
+    uint positions[];
+});
+
+RegisterBuffer(std430, readonly, VertexAttributeStream, {
+    uint attributes[];
+});
+
+#define GetVertexPositions(positionsBuffer) GetResource(VertexPositions, positionsBuffer).positions
+#define GetVertexAttributes(attributesBuffer) GetResource(VertexAttributeStream, attributesBuffer).attributes
+
+struct VertexAttributes
+{
+    vec3 normal;
+    vec2 uv;
+};
+
+// Returns the position in the local space of the scene node, quantized positions
+// are normalized to the local bounding box of the scene node
+vec3 LoadPosition(uint positionsBuffer, uint vertexIndex, uint boundsBuffer, uint sceneNodeIndex)
+{
+    if (kVertexFormat == VERTEX_FORMAT_FLOAT)
+    {
+        uint i = 3 * vertexIndex;
+        return uintBitsToFloat(uvec3(
+            GetVertexPositions(positionsBuffer)[i],
+            GetVertexPositions(positionsBuffer)[i + 1],
+            GetVertexPositions(positionsBuffer)[i + 2]));
+    }
+
+    uint i = 2 * vertexIndex;
+    vec3 position = vec3(
+        unpackSnorm2x16(GetVertexPositions(positionsBuffer)[i]),
+        unpackSnorm2x16(GetVertexPositions(positionsBuffer)[i + 1]).x);
+    NodeBounds bounds = GetNodeBounds(boundsBuffer)[sceneNodeIndex];
+    return bounds.center.xyz + position * bounds.extent.xyz;
+}
+
+// Quantized normals are octahedral encoded
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+VertexAttributes LoadAttributes(uint attributesBuffer, uint vertexIndex)
+{
+    VertexAttributes attributes;
+    if (kVertexFormat == VERTEX_FORMAT_FLOAT)
+    {
+        uint i = 5 * vertexIndex;
+        attributes.normal = uintBitsToFloat(uvec3(
+            GetVertexAttributes(attributesBuffer)[i],
+            GetVertexAttributes(attributesBuffer)[i + 1],
+            GetVertexAttributes(attributesBuffer)[i + 2]));
+        attributes.uv = uintBitsToFloat(uvec2(
+            GetVertexAttributes(attributesBuffer)[i + 3],
+            GetVertexAttributes(attributesBuffer)[i + 4]));
+        return attributes;
+    }
+
+    uint i = 2 * vertexIndex;
+    attributes.normal = DecodeOctahedral(unpackSnorm2x16(GetVertexAttributes(attributesBuffer)[i]));
+    attributes.uv = unpackHalf2x16(GetVertexAttributes(attributesBuffer)[i + 1]);
+    return attributes;
+}
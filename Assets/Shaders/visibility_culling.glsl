@@ -0,0 +1,158 @@
+// assumes:
+// #include "bindless.glsl"
+
+// Shared by the visibility culling passes.
+// Draws with the same mesh and material are grouped so that their visible
+// instances end up in a single instanced indirect command.
+
+// Matches GPUCulling::DrawInput
+struct DrawInput {
+    uint sceneNodeIndex;
+    uint materialIndex;
+    uint groupIndex;
+    uint pad0;
+};
+
+// Matches kMaxMeshLodCount
+#define MAX_MESH_LOD_COUNT 4
+
+// Matches GPUCulling::GroupLod
+struct MeshLod {
+    uint firstIndex;
+    uint indexCount;
+};
+
+// Matches GPUCulling::DrawGroup, inputs of a group are contiguous
+struct DrawGroup {
+    MeshLod lods[MAX_MESH_LOD_COUNT]; // lods[0] is the mesh itself
+    uint lodCount; // coarser levels
+    uint firstDraw; // first input of the group
+    uint batchIndex; // relative to the view's first batch
+    uint firstCluster;
+    uint clusterCount; // 0 if the group is not drawn per meshlet
+    int vertexOffset; // for 16-bit indices
+    uint indexTypeSlot; // batch of the group in views that don't use group batches
+    uint pad0;
+};
+
+// Matches GPUCulling::ClusterInput, a meshlet of a clustered group
+struct ClusterInput {
+    vec4 sphere; // local center, radius
+    vec4 cone; // local axis, cutoff
+    uint firstIndex;
+    uint indexCount;
+    uint groupIndex;
+    uint pad0;
+};
+
+// Local bounding box of a scene node, see SceneTree::GetBoundsBufferHandle()
+struct NodeBounds {
+    vec4 center;
+    vec4 extent;
+};
+
+// Matches GPUCulling::View
+struct CullingView {
+    vec4 planes[6]; // normals point inside
+    uint inputCount; // tests inputs [0, inputCount)
+    uint groupCount; // groups of those inputs
+    uint firstBatch;
+    uint useGroupBatches; // 0: groups go to firstBatch + indexTypeSlot
+    uint firstGroupSlot; // into instance counts
+    uint firstInstance; // into draw data
+    uint clusterCount; // 0: clustered groups are drawn as a whole
+    uint lodBias; // added to the level of detail selected from the distance
+    vec3 origin; // camera position, for levels of detail and the normal cone test
+    float lodDistanceScale; // see LodSelection
+};
+
+// Matches VkDrawIndexedIndirectCommand
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+// Matches IndirectDrawData
+struct DrawData {
+    uint sceneNodeIndex;
+    uint materialIndex;
+};
+
+RegisterBuffer(std430, readonly, CullingDrawInputs, {
+    DrawInput inputs[];
+});
+
+RegisterBuffer(std430, readonly, CullingDrawGroups, {
+    DrawGroup groups[];
+});
+
+RegisterBuffer(std430, readonly, CullingClusters, {
+    ClusterInput clusters[];
+});
+
+RegisterBuffer(std430, readonly, CullingNodeBounds, {
+    NodeBounds bounds[];
+});
+
+RegisterBuffer(std430, readonly, MeshTransforms, {
+    mat4 transforms[];
+});
+
+RegisterBuffer(std430, readonly, CullingViews, {
+    CullingView views[];
+});
+
+RegisterBuffer(std430, readonly, CullingBatches, {
+    uint firstCommands[];
+});
+
+RegisterBuffer(std430, coherent, CullingInstanceCounts, {
+    uint instanceCounts[];
+});
+
+RegisterBuffer(std430, coherent, CullingLodLevels, {
+    uint lodLevels[];
+});
+
+RegisterBuffer(std430, coherent, CullingDrawCounts, {
+    uint counts[];
+});
+
+RegisterBuffer(std430, writeonly, CullingDrawCommands, {
+    DrawCommand commands[];
+});
+
+RegisterBuffer(std430, writeonly, CullingDrawData, {
+    DrawData draws[];
+});
+
+layout(set = 1, binding = 0) uniform DrawParameters {
+    uint inputs;
+    uint groups;
+    uint clusters;
+    uint bounds;
+    uint transforms;
+    uint views;
+    uint batches;
+    uint instanceCounts;
+    uint lodLevels;
+    uint counts;
+    uint commands;
+    uint drawData;
+} uDrawParams;
+
+#define GetInputs() GetResource(CullingDrawInputs, uDrawParams.inputs).inputs
+#define GetGroups() GetResource(CullingDrawGroups, uDrawParams.groups).groups
+#define GetClusters() GetResource(CullingClusters, uDrawParams.clusters).clusters
+#define GetBounds() GetResource(CullingNodeBounds, uDrawParams.bounds).bounds
+#define GetTransforms() GetResource(MeshTransforms, uDrawParams.transforms).transforms
+#define GetViews() GetResource(CullingViews, uDrawParams.views).views
+#define GetFirstCommands() GetResource(CullingBatches, uDrawParams.batches).firstCommands
+#define GetInstanceCounts() GetResource(CullingInstanceCounts, uDrawParams.instanceCounts).instanceCounts
+#define GetLodLevels() GetResource(CullingLodLevels, uDrawParams.lodLevels).lodLevels
+#define GetCounts() GetResource(CullingDrawCounts, uDrawParams.counts).counts
+#define GetCommands() GetResource(CullingDrawCommands, uDrawParams.commands).commands
+#define GetDrawData() GetResource(CullingDrawData, uDrawParams.drawData).draws
@@ -146,7 +146,7 @@ if __name__ == '__main__':
 	print("[SPIRV] Outputing shaders to: {}".format(output_path))
 
 	# Load files in directory
-	files_in_directory = get_files_in_directory(shaders_path, ["glsl", "frag", "vert"])
+	files_in_directory = get_files_in_directory(shaders_path, ["glsl", "frag", "vert", "comp"])
 	if not files_in_directory:
 		print("No files to build")
 		exit(0)
@@ -164,7 +164,7 @@ if __name__ == '__main__':
 	# Clear hash of files that do not exist anymore
 	for filename, file_hash in last_file_hashes.items():
 		file_output = os.path.join(output_path, shader_filename_to_spv(filename))
-		has_output = os.path.splitext(filename)[1] in [ ".frag", ".vert" ]
+		has_output = os.path.splitext(filename)[1] in [ ".frag", ".vert", ".comp" ]
 		if has_output and not os.path.exists(file_output):
 			last_file_hashes[filename] = ""
 
@@ -203,7 +203,7 @@ if __name__ == '__main__':
 	for filename, file_hash in last_file_hashes.items():
 		if not filename in current_file_hashes:
 			file_output = os.path.join(output_path, shader_filename_to_spv(filename))
-			has_output = os.path.splitext(filename)[1] in [ ".frag", ".vert" ]
+			has_output = os.path.splitext(filename)[1] in [ ".frag", ".vert", ".comp" ]
 			if has_output and os.path.exists(file_output):
 				print("[SPIRV] Deleting obsolete output: {}".format(file_output))
 				os.remove(file_output)
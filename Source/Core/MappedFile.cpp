@@ -0,0 +1,122 @@
+#include <MappedFile.h>
+
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+#if defined(_WIN32)
+		m_file = std::exchange(other.m_file, nullptr);
+		m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+
+std::optional<MappedFile> MappedFile::Open(const std::filesystem::path& filePath)
+{
+	MappedFile mappedFile;
+
+	HANDLE file = ::CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return std::nullopt;
+	mappedFile.m_file = file;
+
+	LARGE_INTEGER fileSize = {};
+	if (!::GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		return std::nullopt;
+
+	HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+		return std::nullopt;
+	mappedFile.m_mapping = mapping;
+
+	void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+		return std::nullopt;
+
+	mappedFile.m_data = static_cast<const std::byte*>(data);
+	mappedFile.m_size = static_cast<size_t>(fileSize.QuadPart);
+	return mappedFile;
+}
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr)
+		::UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		::CloseHandle(m_mapping);
+	if (m_file != nullptr)
+		::CloseHandle(m_file);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = nullptr;
+}
+
+#else
+
+std::optional<MappedFile> MappedFile::Open(const std::filesystem::path& filePath)
+{
+	int file = ::open(filePath.c_str(), O_RDONLY);
+	if (file < 0)
+		return std::nullopt;
+
+	struct stat fileStat = {};
+	if (::fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		::close(file);
+		return std::nullopt;
+	}
+
+	// The mapping stays valid after closing the file descriptor
+	const size_t size = static_cast<size_t>(fileStat.st_size);
+	void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (data == MAP_FAILED)
+		return std::nullopt;
+
+	MappedFile mappedFile;
+	mappedFile.m_data = static_cast<const std::byte*>(data);
+	mappedFile.m_size = size;
+	return mappedFile;
+}
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr)
+		::munmap(const_cast<std::byte*>(m_data), m_size);
+
+	m_data = nullptr;
+	m_size = 0;
+}
+
+#endif
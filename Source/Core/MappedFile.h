@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+
+// Read-only view of a whole file mapped in memory, unmapped on destruction
+class MappedFile
+{
+public:
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	~MappedFile();
+
+	// Returns std::nullopt if the file doesn't exist, is empty or cannot be mapped
+	static std::optional<MappedFile> Open(const std::filesystem::path& filePath);
+
+	const std::byte* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	MappedFile() = default;
+
+	void Close();
+
+	const std::byte* m_data = nullptr;
+	size_t m_size = 0;
+#if defined(_WIN32)
+	void* m_file = nullptr; // HANDLE
+	void* m_mapping = nullptr; // HANDLE
+#endif
+};
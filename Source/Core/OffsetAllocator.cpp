@@ -0,0 +1,122 @@
+#include <OffsetAllocator.h>
+
+#include <cassert>
+#include <iterator>
+
+float OffsetAllocator::Stats::GetFragmentation() const
+{
+	const uint32_t freeSize = GetFreeSize();
+	return freeSize == 0 ? 0.0f : 1.0f - static_cast<float>(largestFreeRange) / static_cast<float>(freeSize);
+}
+
+OffsetAllocator::OffsetAllocator(uint32_t size)
+{
+	Grow(size);
+}
+
+uint32_t OffsetAllocator::Allocate(uint32_t size)
+{
+	if (size == 0)
+		return kInvalidOffset;
+
+	auto bestFit = m_freeRangesBySize.lower_bound(size);
+	if (bestFit == m_freeRangesBySize.end())
+		return kInvalidOffset;
+
+	// The remainder of the free range stays free
+	const uint32_t offset = bestFit->second;
+	const uint32_t freeSize = bestFit->first;
+	RemoveFreeRange(m_freeRangesByOffset.find(offset));
+	if (freeSize > size)
+		AddFreeRange(offset + size, freeSize - size);
+
+	m_allocations.emplace(offset, size);
+	m_usedSize += size;
+	return offset;
+}
+
+void OffsetAllocator::Free(uint32_t offset)
+{
+	auto allocation = m_allocations.find(offset);
+	assert(allocation != m_allocations.end());
+	uint32_t size = allocation->second;
+	m_allocations.erase(allocation);
+	m_usedSize -= size;
+
+	// Merge with the free ranges right after and right before
+	auto next = m_freeRangesByOffset.lower_bound(offset);
+	if (next != m_freeRangesByOffset.end() && next->first == offset + size)
+	{
+		size += next->second;
+		next = std::next(next);
+		RemoveFreeRange(std::prev(next));
+	}
+	if (next != m_freeRangesByOffset.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			RemoveFreeRange(previous);
+		}
+	}
+	AddFreeRange(offset, size);
+}
+
+void OffsetAllocator::Grow(uint32_t newSize)
+{
+	if (newSize <= m_size)
+		return;
+
+	// Extend the last free range if it reaches the end
+	uint32_t offset = m_size;
+	if (!m_freeRangesByOffset.empty())
+	{
+		auto last = std::prev(m_freeRangesByOffset.end());
+		if (last->first + last->second == m_size)
+		{
+			offset = last->first;
+			RemoveFreeRange(last);
+		}
+	}
+	AddFreeRange(offset, newSize - offset);
+	m_size = newSize;
+}
+
+uint32_t OffsetAllocator::GetAllocationSize(uint32_t offset) const
+{
+	auto allocation = m_allocations.find(offset);
+	return allocation != m_allocations.end() ? allocation->second : 0;
+}
+
+OffsetAllocator::Stats OffsetAllocator::GetStats() const
+{
+	Stats stats;
+	stats.size = m_size;
+	stats.usedSize = m_usedSize;
+	stats.allocationCount = static_cast<uint32_t>(m_allocations.size());
+	stats.freeRangeCount = static_cast<uint32_t>(m_freeRangesByOffset.size());
+	stats.largestFreeRange = m_freeRangesBySize.empty() ? 0 : std::prev(m_freeRangesBySize.end())->first;
+	return stats;
+}
+
+void OffsetAllocator::AddFreeRange(uint32_t offset, uint32_t size)
+{
+	m_freeRangesByOffset.emplace(offset, size);
+	m_freeRangesBySize.emplace(size, offset);
+}
+
+void OffsetAllocator::RemoveFreeRange(std::map<uint32_t, uint32_t>::iterator it)
+{
+	auto [first, last] = m_freeRangesBySize.equal_range(it->second);
+	for (auto sizeIt = first; sizeIt != last; ++sizeIt)
+	{
+		if (sizeIt->second == it->first)
+		{
+			m_freeRangesBySize.erase(sizeIt);
+			break;
+		}
+	}
+	m_freeRangesByOffset.erase(it);
+}
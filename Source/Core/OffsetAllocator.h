@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <unordered_map>
+
+// Hands out ranges of [0, size) to sub-allocate a buffer, offsets and sizes being in any unit (e.g. elements).
+// Free ranges are kept sorted by size to pick the smallest one that fits (best fit) and by offset to merge
+// a freed range with its free neighbours, so allocating and freeing are O(log n) in the number of free ranges.
+class OffsetAllocator
+{
+public:
+	static constexpr uint32_t kInvalidOffset = (std::numeric_limits<uint32_t>::max)();
+
+	struct Stats
+	{
+		uint32_t size = 0;
+		uint32_t usedSize = 0;
+		uint32_t allocationCount = 0;
+		uint32_t freeRangeCount = 0;
+		uint32_t largestFreeRange = 0;
+
+		uint32_t GetFreeSize() const { return size - usedSize; }
+
+		// 0 when all free space is contiguous, close to 1 when it is scattered in small ranges
+		float GetFragmentation() const;
+	};
+
+	explicit OffsetAllocator(uint32_t size = 0);
+
+	// Returns kInvalidOffset if no free range is large enough
+	uint32_t Allocate(uint32_t size);
+
+	// offset must have been returned by Allocate()
+	void Free(uint32_t offset);
+
+	// Adds free space at the end
+	void Grow(uint32_t newSize);
+
+	uint32_t GetAllocationSize(uint32_t offset) const;
+	uint32_t GetSize() const { return m_size; }
+
+	Stats GetStats() const;
+
+private:
+	void AddFreeRange(uint32_t offset, uint32_t size);
+	void RemoveFreeRange(std::map<uint32_t, uint32_t>::iterator it);
+
+	uint32_t m_size = 0;
+	uint32_t m_usedSize = 0;
+	std::map<uint32_t, uint32_t> m_freeRangesByOffset; // offset -> size
+	std::multimap<uint32_t, uint32_t> m_freeRangesBySize; // size -> offset
+	std::unordered_map<uint32_t, uint32_t> m_allocations; // offset -> size
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Calls func(i) for every i in [0, count) from worker threads and returns once all calls are done.
+// Items are handed out one at a time so that items of uneven cost still balance across threads.
+template <class Func>
+void ParallelFor(size_t count, Func&& func)
+{
+	const size_t hardwareThreadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+	const size_t threadCount = (std::min)(count, hardwareThreadCount);
+	if (threadCount <= 1)
+	{
+		for (size_t i = 0; i < count; ++i)
+			func(i);
+		return;
+	}
+
+	std::atomic<size_t> nextIndex = 0;
+	auto worker = [&nextIndex, &func, count]() {
+		for (size_t i = nextIndex++; i < count; i = nextIndex++)
+			func(i);
+	};
+
+	// The calling thread works too
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (size_t i = 0; i < threadCount - 1; ++i)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
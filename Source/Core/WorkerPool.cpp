@@ -0,0 +1,59 @@
+#include <WorkerPool.h>
+
+WorkerPool::WorkerPool(size_t threadCount)
+{
+	m_threads.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i)
+		m_threads.emplace_back([this]() { RunTasks(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_isStopping = true;
+	}
+	m_taskSubmitted.notify_all();
+
+	// Threads only stop once there are no tasks left
+	for (std::thread& thread : m_threads)
+		thread.join();
+}
+
+void WorkerPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_taskSubmitted.notify_one();
+}
+
+void WorkerPool::Wait()
+{
+	std::unique_lock lock(m_mutex);
+	m_tasksDone.wait(lock, [this]() { return m_tasks.empty() && m_runningTaskCount == 0; });
+}
+
+void WorkerPool::RunTasks()
+{
+	std::unique_lock lock(m_mutex);
+	while (true)
+	{
+		m_taskSubmitted.wait(lock, [this]() { return !m_tasks.empty() || m_isStopping; });
+		if (m_tasks.empty())
+			return; // stopping
+
+		std::function<void()> task = std::move(m_tasks.front());
+		m_tasks.pop_front();
+		m_runningTaskCount++;
+
+		lock.unlock();
+		task();
+		lock.lock();
+
+		m_runningTaskCount--;
+		if (m_tasks.empty() && m_runningTaskCount == 0)
+			m_tasksDone.notify_all();
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads running submitted tasks in the background, in submission order.
+// Unlike ParallelFor(), the submitting thread can keep working until it calls Wait().
+class WorkerPool
+{
+public:
+	explicit WorkerPool(size_t threadCount = (std::max)(std::thread::hardware_concurrency(), 1u));
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Waits for the submitted tasks
+	~WorkerPool();
+
+	void Submit(std::function<void()> task);
+
+	// Returns once all submitted tasks are done
+	void Wait();
+
+private:
+	void RunTasks();
+
+	std::mutex m_mutex;
+	std::condition_variable m_taskSubmitted;
+	std::condition_variable m_tasksDone;
+	std::deque<std::function<void()>> m_tasks;
+	size_t m_runningTaskCount = 0;
+	bool m_isStopping = false;
+	std::vector<std::thread> m_threads;
+};
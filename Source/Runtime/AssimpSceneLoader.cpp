@@ -7,14 +7,25 @@
 #include <Renderer/ShadowSystem.h>
 #include <Renderer/CameraViewSystem.h>
 #include <Renderer/SceneTree.h>
+#include <Renderer/TextureCache.h>
 #include <RHI/CommandRingBuffer.h>
+#include <MeshOptimization.h>
+#include <ParallelFor.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
 #include <assimp/GltfMaterial.h>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
-#include <string>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <compare>
 #include <filesystem>
+#include <map>
 #include <numbers>
+#include <string>
 
 namespace
 {
@@ -43,6 +54,481 @@ namespace
 
 		return color;
 	}
+
+	bool IsCookedSceneUpToDate(const std::filesystem::path& sourcePath, const std::filesystem::path& cookedPath)
+	{
+		std::error_code error;
+		const auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+		if (error)
+			return false;
+
+		const auto cookedTime = std::filesystem::last_write_time(cookedPath, error);
+		return !error && cookedTime >= sourceTime;
+	}
+
+	void CookLights(const aiScene& scene, CookedSceneBuilder& builder)
+	{
+		uint32_t nbShadowCastingLights = 0;
+
+		builder.lights.reserve(scene.mNumLights);
+		for (int i = 0; i < scene.mNumLights; ++i)
+		{
+			aiLight* aLight = scene.mLights[i];
+
+			aiNode* node = scene.mRootNode->FindNode(aLight->mName);
+			glm::mat4 transform = ::ComputeAiNodeGlobalTransform(node);
+
+			CookedLight cookedLight = {};
+			Light& light = cookedLight.light;
+			light.type = static_cast<uint32_t>(aLight->mType);
+			light.color = glm::make_vec4(&aLight->mColorDiffuse.r);
+			light.intensity = std::max(light.color.r, std::max(light.color.g, light.color.b));
+			if (light.intensity > 1.0f)
+			{
+				light.color /= light.intensity;
+			}
+			light.position = transform[3];
+			light.intensity = 10.0f * light.intensity / 683.0f;
+
+			if ((aLight->mType == aiLightSource_DIRECTIONAL) || (aLight->mType == aiLightSource_SPOT))
+			{
+				light.direction = glm::make_vec3(&aLight->mDirection.x);
+				light.direction = glm::vec3(transform * glm::vec4(light.direction, 0.0f));
+
+				if (light.type == aiLightSource_DIRECTIONAL)
+				{
+					light.shadowIndex = nbShadowCastingLights++;
+					cookedLight.castsShadows = 1;
+				}
+				if (aLight->mType == aiLightSource_SPOT)
+				{
+					light.cosInnerAngle = std::cos(aLight->mAngleInnerCone);
+					light.cosOuterAngle = std::cos(aLight->mAngleOuterCone);
+				}
+			}
+			else if (aLight->mType == aiLightSource_POINT)
+			{
+				static constexpr float SMALL_NUMBER = 1.0e-6f;
+				static constexpr float BIG_NUMBER = 1.0e6f; // todo (hbedard): that's no good
+				light.falloffRadius = aLight->mAttenuationConstant > SMALL_NUMBER ? 1.0f / aLight->mAttenuationConstant : BIG_NUMBER;
+			}
+
+			builder.lights.push_back(std::move(cookedLight));
+		}
+	}
+
+	void CookCamera(const aiScene& scene, CookedSceneBuilder& builder)
+	{
+		if (scene.mNumCameras == 0)
+			return;
+
+		aiCamera* camera = scene.mCameras[0];
+		aiNode* node = scene.mRootNode->FindNode(camera->mName);
+		glm::mat4 transform = ::ComputeAiNodeGlobalTransform(node);
+
+		CookedCamera cookedCamera;
+		cookedCamera.position = transform[3];
+		cookedCamera.lookAt = glm::vec3(0.0f);
+		cookedCamera.up = transform[1];
+		cookedCamera.fieldOfView = camera->mHorizontalFOV * 180 / M_PI * 2;
+		builder.cameras.push_back(std::move(cookedCamera));
+	}
+
+	void CookMaterials(const aiScene& scene, CookedSceneBuilder& builder)
+	{
+		builder.materials.resize(scene.mNumMaterials);
+		for (size_t i = 0; i < builder.materials.size(); ++i)
+		{
+			const aiMaterial& assimpMaterial = *scene.mMaterials[i];
+			CookedMaterial& material = builder.materials[i];
+
+			// Properties
+			aiColor4D color = {};
+			if (assimpMaterial.Get(AI_MATKEY_BASE_COLOR, color) == aiReturn_SUCCESS)
+			{
+				material.properties.baseColor = glm::make_vec4(&color.r);
+			}
+
+			aiColor4D emissive = {};
+			if (assimpMaterial.Get(AI_MATKEY_COLOR_EMISSIVE, emissive) == aiReturn_SUCCESS)
+			{
+				material.properties.emissive = glm::make_vec4(&emissive.r);
+			}
+
+			float ior = 1.5f;
+			if (assimpMaterial.Get(AI_MATKEY_REFRACTI, ior) == aiReturn_SUCCESS)
+			{
+				material.properties.f0 = std::pow(((ior - 1.0f) / (ior + 1.0f)), 2);
+			}
+
+			float metallic = 0.0f;
+			if (assimpMaterial.Get(AI_MATKEY_METALLIC_FACTOR, metallic) == aiReturn_SUCCESS)
+			{
+				material.properties.metallic = metallic;
+			}
+
+			float roughness = 0.0f;
+			if (assimpMaterial.Get(AI_MATKEY_ROUGHNESS_FACTOR, roughness) == aiReturn_SUCCESS)
+			{
+				material.properties.perceptualRoughness = roughness;
+			}
+
+			// If a material is translucent, opacity will be fetched from the base color alpha channel
+			aiString alphaMode;
+			if (assimpMaterial.Get(AI_MATKEY_GLTF_ALPHAMODE, alphaMode) == aiReturn_SUCCESS)
+			{
+				if (alphaMode.C_Str() == std::string("MASK"))
+				{
+					material.pipelineProperties.alphaMode = AlphaMode::eMask;
+				}
+				else if (alphaMode.C_Str() == std::string("BLEND"))
+				{
+					material.pipelineProperties.alphaMode = AlphaMode::eBlend;
+				}
+				else
+				{
+					material.pipelineProperties.alphaMode = AlphaMode::eOpaque;
+				}
+			}
+
+			// Textures are loaded at runtime from their path relative to the scene
+			for (int textureIndex = 0; textureIndex < (int)MaterialTextureType::eCount; ++textureIndex)
+			{
+				material.properties.textures[textureIndex] = TextureHandle::Invalid;
+			}
+
+			auto cookTexturePath = [&builder, &assimpMaterial, &material](aiTextureType type, size_t textureIndex) {
+				if (assimpMaterial.GetTextureCount(type) > 0)
+				{
+					aiString textureFile;
+					assimpMaterial.GetTexture(type, 0, &textureFile);
+					material.texturePaths[textureIndex] = builder.AddString(textureFile.C_Str());
+				}
+			};
+
+			cookTexturePath(aiTextureType_BASE_COLOR, static_cast<size_t>(MaterialTextureType::eBaseColor));
+			cookTexturePath(aiTextureType_EMISSIVE, static_cast<size_t>(MaterialTextureType::eEmissive));
+			cookTexturePath(aiTextureType_GLTF_METALLIC_ROUGHNESS, static_cast<size_t>(MaterialTextureType::eOcclusionMetallicRoughness));
+			cookTexturePath(aiTextureType_NORMALS, static_cast<size_t>(MaterialTextureType::eNormals));
+		}
+	}
+
+	// Vertices and indices of a mesh are written to a range reserved up front
+	struct MeshConversion
+	{
+		const aiMesh* mesh = nullptr; // null until a node references the mesh
+		uint32_t firstVertex = 0;
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+
+		// Computed by the conversion
+		BoundingBox boundingBox;
+		float maxVertexDistance = 0.0f;
+		uint32_t transformedVertexCountBefore = 0; // before reordering, to report the ACMR
+		uint32_t transformedVertexCountAfter = 0;
+		std::vector<Meshlet> meshlets; // index ranges relative to firstIndex
+		uint32_t firstMeshlet = 0; // in the cooked scene
+		std::vector<std::vector<uint32_t>> lods; // indices relative to firstVertex
+		uint32_t firstLod = 0; // in the cooked scene
+	};
+
+	// Visits nodes and reserves the geometry of their meshes, which is converted afterwards.
+	// conversions are indexed by aiMesh index so that nodes referencing the same mesh share its geometry.
+	void CookNodeAndChildren(
+		const aiScene& scene,
+		const aiNode& node,
+		uint32_t parentIndex,
+		CookedSceneBuilder& builder,
+		std::vector<MeshConversion>& conversions,
+		std::vector<uint32_t>& meshSourceIndices,
+		uint32_t& vertexCount,
+		uint32_t& indexCount)
+	{
+		const uint32_t nodeIndex = static_cast<uint32_t>(builder.nodes.size());
+
+		// Keep a scene node for every file node, even without meshes,
+		// so that moving a node also moves its children.
+		CookedSceneNode cookedNode;
+		// Convert from row-major (aiMatrix4x4) to column-major (glm::mat4)
+		// Note: don't know if all formats supported by assimp are row-major but Collada is.
+		cookedNode.localTransform = glm::transpose(glm::make_mat4(&node.mTransformation.a1));
+		cookedNode.parentIndex = parentIndex;
+		cookedNode.firstMesh = static_cast<uint32_t>(builder.meshes.size());
+		cookedNode.meshCount = node.mNumMeshes;
+		builder.nodes.push_back(std::move(cookedNode));
+
+		for (size_t i = 0; i < node.mNumMeshes; ++i)
+		{
+			const uint32_t sourceIndex = node.mMeshes[i];
+			const aiMesh* aMesh = scene.mMeshes[sourceIndex];
+
+			MeshConversion& conversion = conversions[sourceIndex];
+			if (conversion.mesh == nullptr)
+			{
+				conversion.mesh = aMesh;
+				conversion.firstVertex = vertexCount;
+				conversion.firstIndex = indexCount;
+				conversion.indexCount = aMesh->mNumFaces > 0 ? aMesh->mNumFaces * aMesh->mFaces->mNumIndices : 0;
+
+				vertexCount += aMesh->mNumVertices;
+				indexCount += conversion.indexCount;
+			}
+
+			CookedMesh mesh;
+			mesh.firstIndex = conversion.firstIndex;
+			mesh.indexCount = conversion.indexCount;
+			mesh.materialIndex = aMesh->mMaterialIndex;
+			builder.meshes.push_back(mesh);
+			meshSourceIndices.push_back(sourceIndex);
+		}
+
+		for (int i = 0; i < node.mNumChildren; ++i)
+			CookNodeAndChildren(scene, *node.mChildren[i], nodeIndex, builder, conversions, meshSourceIndices, vertexCount, indexCount);
+	}
+
+	// Only writes to the mesh's own ranges so that meshes can be converted concurrently
+	void ConvertMesh(MeshConversion& conversion, gsl::span<Vertex> vertices, gsl::span<uint32_t> indices)
+	{
+		const aiMesh* aMesh = conversion.mesh;
+
+		bool hasUV[2] = { aMesh->HasTextureCoords(0), aMesh->HasTextureCoords(1) };
+		bool hasNormals = aMesh->HasNormals();
+
+		BoundingBox box;
+		float maxVertexDistance2 = 0.0f;
+		Vertex* vertex = vertices.data() + conversion.firstVertex;
+		for (size_t v = 0; v < aMesh->mNumVertices; ++v, ++vertex)
+		{
+			vertex->pos = glm::make_vec3(&aMesh->mVertices[v].x);
+			vertex->uv = hasUV[0] ? glm::make_vec2(&aMesh->mTextureCoords[0][v].x) : glm::vec2(0.0f);
+			vertex->uv.y = -vertex->uv.y; // v axis flipped for vulkan
+			vertex->normal = hasNormals ? glm::make_vec3(&aMesh->mNormals[v].x) : glm::vec3(0.0f);
+
+			maxVertexDistance2 = (std::max)(maxVertexDistance2, glm::dot(vertex->pos, vertex->pos));
+			box.min = (glm::min)(box.min, vertex->pos);
+			box.max = (glm::max)(box.max, vertex->pos);
+		}
+		conversion.boundingBox = box;
+		conversion.maxVertexDistance = std::sqrt(maxVertexDistance2);
+
+		const uint32_t faceIndexCount = aMesh->mNumFaces > 0 ? aMesh->mFaces->mNumIndices : 0;
+		gsl::span<uint32_t> meshIndices = indices.subspan(conversion.firstIndex, conversion.indexCount);
+		uint32_t* index = meshIndices.data();
+		for (size_t f = 0; f < aMesh->mNumFaces; ++f)
+		{
+			for (size_t fi = 0; fi < faceIndexCount; ++fi)
+			{
+				*index++ = aMesh->mFaces[f].mIndices[fi];
+			}
+		}
+
+		// Reorder triangles for the post-transform cache, then vertices in order of use, then split in meshlets
+		if (faceIndexCount == 3)
+		{
+			gsl::span<Vertex> meshVertices = vertices.subspan(conversion.firstVertex, aMesh->mNumVertices);
+			conversion.transformedVertexCountBefore = ::CountTransformedVertices(meshIndices, aMesh->mNumVertices);
+			::OptimizeVertexCache(meshIndices, aMesh->mNumVertices);
+			::OptimizeVertexFetch(meshIndices, meshVertices);
+			conversion.transformedVertexCountAfter = ::CountTransformedVertices(meshIndices, aMesh->mNumVertices);
+			::BuildMeshlets(meshIndices, meshVertices, conversion.meshlets);
+			conversion.lods = ::BuildLods(meshIndices, meshVertices, kMaxMeshLodCount - 1);
+		}
+
+		// Relative to the first vertex of the scene
+		for (uint32_t& meshIndex : meshIndices)
+		{
+			meshIndex += conversion.firstVertex;
+		}
+	}
+
+	void CookSceneNodes(const aiScene& scene, CookedSceneBuilder& builder)
+	{
+		std::vector<MeshConversion> conversions(scene.mNumMeshes);
+		std::vector<uint32_t> meshSourceIndices; // aiMesh index of each cooked mesh
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+		::CookNodeAndChildren(scene, *scene.mRootNode, kInvalidCookedIndex, builder, conversions, meshSourceIndices, vertexCount, indexCount);
+
+		builder.vertices.resize(vertexCount);
+		builder.indices.resize(indexCount);
+		ParallelFor(conversions.size(), [&conversions, &builder](size_t i) {
+			if (conversions[i].mesh != nullptr)
+				::ConvertMesh(conversions[i], builder.vertices, builder.indices);
+		});
+
+		for (MeshConversion& conversion : conversions)
+		{
+			conversion.firstMeshlet = static_cast<uint32_t>(builder.meshlets.size());
+			for (Meshlet meshlet : conversion.meshlets)
+			{
+				meshlet.firstIndex += conversion.firstIndex;
+				builder.meshlets.push_back(meshlet);
+			}
+		}
+		// Levels of detail are appended after the indices of all meshes
+		uint64_t lodTriangleCount = 0;
+		for (MeshConversion& conversion : conversions)
+		{
+			conversion.firstLod = static_cast<uint32_t>(builder.meshLods.size());
+			for (const std::vector<uint32_t>& lodIndices : conversion.lods)
+			{
+				CookedMeshLod& lod = builder.meshLods.emplace_back();
+				lod.firstIndex = static_cast<uint32_t>(builder.indices.size());
+				lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+				for (uint32_t index : lodIndices)
+					builder.indices.push_back(index + conversion.firstVertex);
+				lodTriangleCount += lodIndices.size() / 3;
+			}
+		}
+		for (size_t meshIndex = 0; meshIndex < builder.meshes.size(); ++meshIndex)
+		{
+			const MeshConversion& conversion = conversions[meshSourceIndices[meshIndex]];
+			builder.meshes[meshIndex].firstMeshlet = conversion.firstMeshlet;
+			builder.meshes[meshIndex].meshletCount = static_cast<uint32_t>(conversion.meshlets.size());
+			builder.meshes[meshIndex].firstLod = conversion.firstLod;
+			builder.meshes[meshIndex].lodCount = static_cast<uint32_t>(conversion.lods.size());
+		}
+
+		for (CookedSceneNode& node : builder.nodes)
+		{
+			for (uint32_t meshIndex = node.firstMesh; meshIndex < node.firstMesh + node.meshCount; ++meshIndex)
+			{
+				const MeshConversion& conversion = conversions[meshSourceIndices[meshIndex]];
+				node.boundingBox = node.boundingBox.Union(conversion.boundingBox);
+				builder.maxVertexDistance = (std::max)(builder.maxVertexDistance, conversion.maxVertexDistance);
+			}
+		}
+
+		// Average cache miss ratio: transformed vertices per triangle
+		uint64_t triangleCount = 0;
+		uint64_t transformedVertexCountBefore = 0;
+		uint64_t transformedVertexCountAfter = 0;
+		for (const MeshConversion& conversion : conversions)
+		{
+			if (conversion.transformedVertexCountAfter == 0)
+				continue;
+			triangleCount += conversion.indexCount / 3;
+			transformedVertexCountBefore += conversion.transformedVertexCountBefore;
+			transformedVertexCountAfter += conversion.transformedVertexCountAfter;
+		}
+		if (triangleCount > 0)
+		{
+			std::cout << "Vertex cache ACMR (" << kVertexCacheSize << " entries): "
+				<< static_cast<double>(transformedVertexCountBefore) / triangleCount << " -> "
+				<< static_cast<double>(transformedVertexCountAfter) / triangleCount << std::endl;
+			std::cout << "Levels of detail: " << builder.meshLods.size() << " (" << lodTriangleCount << " triangles)" << std::endl;
+		}
+	}
+
+	// Parses the source file with Assimp, the importer is released once the scene is converted
+	CookedSceneBuilder CookScene(const std::filesystem::path& sourcePath)
+	{
+		Assimp::Importer importer;
+		// Identical vertices are welded so that triangles can share them in the post-transform cache
+		const unsigned int flags = aiProcess_Triangulate
+			| aiProcess_GenNormals
+			| aiProcess_JoinIdenticalVertices;
+		const aiScene* scene = importer.ReadFile(sourcePath.string(), flags);
+		if (scene == nullptr)
+		{
+			std::cout << importer.GetErrorString() << std::endl;
+			throw std::runtime_error("Cannot load scene, file not found or parsing failed");
+		}
+
+		CookedSceneBuilder builder;
+		::CookLights(*scene, builder);
+		::CookCamera(*scene, builder);
+		::CookMaterials(*scene, builder);
+		::CookSceneNodes(*scene, builder);
+		return builder;
+	}
+
+	// A cooked mesh, quantized in the bounding box of a node when vertices are quantized
+	struct MeshKey
+	{
+		uint32_t firstIndex = 0; // of the cooked mesh
+		std::array<float, 6> box = {}; // min, max
+
+		auto operator<=>(const MeshKey&) const = default;
+	};
+
+	// Square root of the ratio between the areas of the triangles in texture space and in mesh space
+	float ComputeUvDensity(gsl::span<const Vertex> vertices, gsl::span<const uint32_t> indices)
+	{
+		double area = 0.0;
+		double uvArea = 0.0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const Vertex& v0 = vertices[indices[i]];
+			const Vertex& v1 = vertices[indices[i + 1]];
+			const Vertex& v2 = vertices[indices[i + 2]];
+			area += glm::length(glm::cross(v1.pos - v0.pos, v2.pos - v0.pos));
+			const glm::vec2 uv1 = v1.uv - v0.uv;
+			const glm::vec2 uv2 = v2.uv - v0.uv;
+			uvArea += std::abs(uv1.x * uv2.y - uv1.y * uv2.x);
+		}
+		return area > 0.0 ? static_cast<float>(std::sqrt(uvArea / area)) : 0.0f;
+	}
+
+	// Copies the indices of a cooked mesh with its levels of detail and meshlets, and its vertices when they are
+	// quantized in the given box. sceneVertexOffset is where the cooked vertices were copied otherwise.
+	// Returns the geometry of the mesh, without material.
+	Mesh AddMesh(MeshAllocator& meshAllocator, const CookedScene& cookedScene, const CookedMesh& cookedMesh, const BoundingBox& box, uint32_t sceneVertexOffset)
+	{
+		Mesh mesh;
+		mesh.nbIndices = cookedMesh.indexCount;
+		gsl::span<const uint32_t> indices = cookedScene.GetIndices().subspan(cookedMesh.firstIndex, cookedMesh.indexCount);
+		if (indices.empty())
+			return mesh;
+
+		// Vertices of a mesh are contiguous, levels of detail only use a subset of them
+		const auto [firstVertex, lastVertex] = std::minmax_element(indices.begin(), indices.end());
+		const uint32_t meshVertexCount = *lastVertex - *firstVertex + 1;
+		uint32_t baseVertex = sceneVertexOffset + *firstVertex;
+		if (meshAllocator.GetVertexFormat() == VertexFormat::eQuantized)
+		{
+			baseVertex = meshAllocator.AddQuantizedVertices(cookedScene.GetVertices().subspan(*firstVertex, meshVertexCount), box);
+		}
+
+		// 16-bit indices are relative to the first vertex of the mesh, which is given to draws instead
+		mesh.indexType = MeshAllocator::GetIndexType(meshVertexCount);
+		mesh.vertexOffset = mesh.indexType == vk::IndexType::eUint16 ? static_cast<int32_t>(baseVertex) : 0;
+		const uint32_t vertexOffset = mesh.indexType == vk::IndexType::eUint16 ? 0 - *firstVertex : baseVertex - *firstVertex; // unsigned wrap around
+		mesh.indexOffset = meshAllocator.AddIndices(indices, vertexOffset, mesh.indexType);
+		mesh.uvDensity = ComputeUvDensity(cookedScene.GetVertices(), indices);
+
+		mesh.firstMeshlet = meshAllocator.AddMeshlets(
+			cookedScene.GetMeshlets().subspan(cookedMesh.firstMeshlet, cookedMesh.meshletCount),
+			static_cast<int64_t>(mesh.indexOffset) - cookedMesh.firstIndex);
+		mesh.meshletCount = cookedMesh.meshletCount;
+
+		mesh.lodCount = cookedMesh.lodCount;
+		for (uint32_t lodIndex = 0; lodIndex < cookedMesh.lodCount; ++lodIndex)
+		{
+			const CookedMeshLod& cookedLod = cookedScene.GetMeshLods()[cookedMesh.firstLod + lodIndex];
+			gsl::span<const uint32_t> lodIndices = cookedScene.GetIndices().subspan(cookedLod.firstIndex, cookedLod.indexCount);
+			mesh.lods[lodIndex].indexOffset = meshAllocator.AddIndices(lodIndices, vertexOffset, mesh.indexType);
+			mesh.lods[lodIndex].nbIndices = cookedLod.indexCount;
+		}
+		return mesh;
+	}
+
+	TextureUsage GetTextureUsage(MaterialTextureType textureType)
+	{
+		switch (textureType)
+		{
+		case MaterialTextureType::eBaseColor:
+		case MaterialTextureType::eEmissive:
+			return TextureUsage::eColor;
+		case MaterialTextureType::eNormals:
+			return TextureUsage::eNormals;
+		case MaterialTextureType::eAmbientOcclusion:
+			return TextureUsage::eMask;
+		case MaterialTextureType::eOcclusionMetallicRoughness:
+		default:
+			return TextureUsage::eData;
+		}
+	}
 }
 
 AssimpSceneLoader::AssimpSceneLoader(
@@ -70,77 +556,46 @@ void AssimpSceneLoader::ResetCamera()
 
 void AssimpSceneLoader::LoadScene(vk::CommandBuffer commandBuffer)
 {
-	int flags = aiProcess_Triangulate
-		| aiProcess_GenNormals
-		| aiProcess_JoinIdenticalVertices;
+	const std::filesystem::path sourcePath = AssetPath(m_sceneDir + "/" + m_sceneFilename).GetPathOnDisk();
+	std::filesystem::path cookedPath = sourcePath;
+	cookedPath += CookedScene::kFileExtension;
 
-	auto sceneName = AssetPath(m_sceneDir + "/" + m_sceneFilename);
+	std::optional<CookedScene> cookedScene;
+	if (::IsCookedSceneUpToDate(sourcePath, cookedPath))
+	{
+		cookedScene = CookedScene::Load(cookedPath);
+	}
 
-	m_assimp.importer = std::make_unique<Assimp::Importer>();
-	std::string scenePathStr = sceneName.GetPathOnDisk().string();
-	m_assimp.scene = m_assimp.importer->ReadFile(scenePathStr, 0);
-	if (m_assimp.scene == nullptr)
+	if (!cookedScene)
 	{
-		std::cout << m_assimp.importer->GetErrorString() << std::endl;
-		throw std::runtime_error("Cannot load scene, file not found or parsing failed");
+		std::vector<std::byte> data = ::CookScene(sourcePath).Serialize();
+		if (!CookedScene::Save(cookedPath, data))
+		{
+			std::cout << "Cannot write cooked scene " << cookedPath << std::endl;
+		}
+		cookedScene = CookedScene::FromMemory(std::move(data));
+		assert(cookedScene);
 	}
 
-	LoadLights(commandBuffer);
-	LoadMaterials(commandBuffer);
-	LoadSceneNodes(commandBuffer);
+	LoadLights(*cookedScene);
+	LoadMaterials(*cookedScene);
+	LoadSceneNodes(*cookedScene);
+
+	gsl::span<const CookedCamera> cameras = cookedScene->GetCameras();
+	m_camera = cameras.empty() ? std::nullopt : std::optional<CookedCamera>(cameras.front());
+	m_maxVertexDist = cookedScene->GetMaxVertexDistance();
 	LoadCamera();
 }
 
-void AssimpSceneLoader::LoadLights(vk::CommandBuffer buffer)
+void AssimpSceneLoader::LoadLights(const CookedScene& cookedScene)
 {
-	GetRenderScene().GetLightSystem()->ReserveLights(m_assimp.scene->mNumLights);
-
-	uint32_t nbShadowCastingLights = 0;
+	gsl::span<const CookedLight> lights = cookedScene.GetLights();
+	GetRenderScene().GetLightSystem()->ReserveLights(lights.size());
 
-	for (int i = 0; i < m_assimp.scene->mNumLights; ++i)
+	for (const CookedLight& cookedLight : lights)
 	{
-		aiLight* aLight = m_assimp.scene->mLights[i];
-
-		aiNode* node = m_assimp.scene->mRootNode->FindNode(aLight->mName);
-		glm::mat4 transform = ::ComputeAiNodeGlobalTransform(node);
-		
-		Light light;
-		light.type = static_cast<uint32_t>(aLight->mType);
-		light.color = glm::make_vec4(&aLight->mColorDiffuse.r);
-		light.intensity = std::max(light.color.r, std::max(light.color.g, light.color.b));
-		if (light.intensity > 1.0f)
-		{
-			light.color /= light.intensity;
-		}
-		light.position = transform[3];
-		light.intensity = 10.0f * light.intensity / 683.0f;
-
-		bool hasShadows = false;
-		if ((aLight->mType == aiLightSource_DIRECTIONAL) || (aLight->mType == aiLightSource_SPOT))
-		{
-			light.direction = glm::make_vec3(&aLight->mDirection.x);
-			light.direction = glm::vec3(transform * glm::vec4(light.direction, 0.0f));
-
-			if (light.type == aiLightSource_DIRECTIONAL)
-			{
-				light.shadowIndex = nbShadowCastingLights++;
-				hasShadows = true;
-			}
-			if (aLight->mType == aiLightSource_SPOT)
-			{
-				light.cosInnerAngle = std::cos(aLight->mAngleInnerCone);
-				light.cosOuterAngle = std::cos(aLight->mAngleOuterCone);
-			}
-		}
-		else if (aLight->mType == aiLightSource_POINT)
-		{
-			static constexpr float SMALL_NUMBER = 1.0e-6f;
-			static constexpr float BIG_NUMBER = 1.0e6f; // todo (hbedard): that's no good
-			light.falloffRadius = aLight->mAttenuationConstant > SMALL_NUMBER ? 1.0f / aLight->mAttenuationConstant : BIG_NUMBER;
-		}
-
-		LightID lightID = GetRenderScene().GetLightSystem()->AddLight(std::move(light));
-		if (hasShadows)
+		LightID lightID = GetRenderScene().GetLightSystem()->AddLight(cookedLight.light);
+		if (cookedLight.castsShadows != 0)
 		{
 			ShadowID shadowID = GetRenderScene().GetShadowSystem()->CreateShadowMap(lightID);
 			GetRenderScene().GetLightSystem()->SetLightShadowID(lightID, shadowID);
@@ -154,208 +609,108 @@ void AssimpSceneLoader::LoadCamera()
 {
 	Camera& sceneCamera = GetRenderScene().GetCameraViewSystem()->GetCamera();
 
-	if (m_assimp.scene->mNumCameras > 0)
+	if (m_camera)
 	{
-		aiCamera* camera = m_assimp.scene->mCameras[0];
-		aiNode* node = m_assimp.scene->mRootNode->FindNode(camera->mName);
-		glm::mat4 transform = ComputeAiNodeGlobalTransform(node);
-		glm::vec3 pos = transform[3];
-		glm::vec3 lookat = glm::vec3(0.0f);
-		glm::vec3 up = transform[1];
-		sceneCamera.SetCameraView(pos, lookat, up);
-		sceneCamera.SetFieldOfView(camera->mHorizontalFOV * 180 / M_PI * 2);
+		sceneCamera.SetCameraView(m_camera->position, m_camera->lookAt, m_camera->up);
+		sceneCamera.SetFieldOfView(m_camera->fieldOfView);
 	}
 	else
 	{
 		// Init camera to see the model
 		kInitOrbitCameraRadius = m_maxVertexDist * 15.0f;
-		Camera& sceneCamera = GetRenderScene().GetCameraViewSystem()->GetCamera();
 		sceneCamera.SetCameraView(glm::vec3(kInitOrbitCameraRadius, kInitOrbitCameraRadius, kInitOrbitCameraRadius), glm::vec3(0, 0, 0), glm::vec3(0, 0, 1));
 	}
 }
 
-void AssimpSceneLoader::LoadSceneNodes(vk::CommandBuffer commandBuffer)
+void AssimpSceneLoader::LoadSceneNodes(const CookedScene& cookedScene)
 {
-	m_maxVertexDist = 0.0f;
-	LoadNodeAndChildren(m_assimp.scene->mRootNode, glm::mat4(1.0f));
-}
-
-void AssimpSceneLoader::LoadNodeAndChildren(aiNode* node, glm::mat4 transform)
-{
-	// Convert from row-major (aiMatrix4x4) to column-major (glm::mat4)
-	// Note: don't know if all formats supported by assimp are row-major but Collada is.
-	glm::mat4 nodeTransform = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
-
-	glm::mat4 newTransform = transform * nodeTransform;
-
-	if (node->mNumMeshes > 0)
-		LoadSceneNode(*node, newTransform);
-
-	for (int i = 0; i < node->mNumChildren; ++i)
-		LoadNodeAndChildren(node->mChildren[i], newTransform);
-}
-
-SceneNodeHandle AssimpSceneLoader::LoadSceneNode(const aiNode& fileNode, glm::mat4 transform)
-{
-	constexpr float maxFloat = std::numeric_limits<float>::max();
-
-	BoundingBox box;
+	gsl::not_null<MeshAllocator*> meshAllocator = GetRenderScene().GetMeshAllocator();
+	gsl::not_null<SceneTree*> sceneTree = GetRenderScene().GetSceneTree();
+
+	// Vertices are copied in bulk, cooked indices are relative to the first vertex of the scene.
+	// Quantized vertices are relative to the bounding box of their node instead, so meshes
+	// are copied once per box, nodes instancing the same meshes usually share the same box.
+	// Indices are copied per mesh since small meshes use 16-bit indices.
+	const bool isQuantized = meshAllocator->GetVertexFormat() == VertexFormat::eQuantized;
+	uint32_t vertexOffset = 0;
+	if (!isQuantized && !cookedScene.GetVertices().empty())
+	{
+		vertexOffset = meshAllocator->AddVertices(cookedScene.GetVertices());
+	}
+	std::map<MeshKey, Mesh> addedMeshes;
 
+	gsl::span<const CookedSceneNode> nodes = cookedScene.GetNodes();
+	gsl::span<const CookedMesh> cookedMeshes = cookedScene.GetMeshes();
+	std::vector<SceneNodeHandle> sceneNodeIDs;
+	sceneNodeIDs.reserve(nodes.size());
 	std::vector<Mesh> meshes;
-	meshes.reserve(m_assimp.scene->mNumMeshes);
-
-	for (size_t i = 0; i < fileNode.mNumMeshes; ++i)
+	for (const CookedSceneNode& node : nodes)
 	{
-		aiMesh* aMesh = m_assimp.scene->mMeshes[fileNode.mMeshes[i]];
-
-		{
-			Mesh mesh;
-			mesh.indexOffset = GetRenderScene().GetMeshAllocator()->GetIndexCount();
-			mesh.nbIndices = (vk::DeviceSize)aMesh->mNumFaces * aMesh->mFaces->mNumIndices;
-			mesh.materialHandle = m_materials[aMesh->mMaterialIndex];
-			meshes.push_back(std::move(mesh));
-		}
-
-		size_t vertexIndexOffset = GetRenderScene().GetMeshAllocator()->GetVertexCount();
-
-		bool hasUV[2] = { aMesh->HasTextureCoords(0), aMesh->HasTextureCoords(1) };
-		bool hasColor = aMesh->HasVertexColors(0);
-		bool hasNormals = aMesh->HasNormals();
-
-		GetRenderScene().GetMeshAllocator()->ReserveVertices(aMesh->mNumVertices);
-		for (size_t v = 0; v < aMesh->mNumVertices; ++v)
+		const SceneNodeHandle parent = node.parentIndex != kInvalidCookedIndex ? sceneNodeIDs[node.parentIndex] : SceneNodeHandle::Invalid;
+		const SceneNodeHandle sceneNodeID = sceneTree->CreateNode(node.localTransform, node.boundingBox, parent);
+		sceneNodeIDs.push_back(sceneNodeID);
+		if (node.meshCount == 0)
 		{
-			Vertex vertex;
-			vertex.pos = glm::make_vec3(&aMesh->mVertices[v].x);
-			vertex.uv = hasUV[0] ? glm::make_vec2(&aMesh->mTextureCoords[0][v].x) : glm::vec2(0.0f);
-			vertex.uv.y = -vertex.uv.y; // v axis flipped for vulkan
-			vertex.normal = hasNormals ? glm::make_vec3(&aMesh->mNormals[v].x) : glm::vec3(0.0f);
-
-			m_maxVertexDist = (std::max)(m_maxVertexDist, glm::length(vertex.pos - glm::vec3(0.0f)));
-			box.min = (glm::min)(box.min, vertex.pos);
-			box.max = (glm::max)(box.max, vertex.pos);
-
-			GetRenderScene().GetMeshAllocator()->AddVertex(std::move(vertex));
+			continue; // only used to transform its children
 		}
 
-		GetRenderScene().GetMeshAllocator()->ReserveIndices((size_t)aMesh->mNumFaces * (aMesh->mFaces->mNumIndices + 1));
-		for (size_t f = 0; f < aMesh->mNumFaces; ++f)
+		meshes.clear();
+		for (const CookedMesh& cookedMesh : cookedMeshes.subspan(node.firstMesh, node.meshCount))
 		{
-			for (size_t fi = 0; fi < aMesh->mFaces->mNumIndices; ++fi)
+			MeshKey key = { cookedMesh.firstIndex };
+			if (isQuantized)
 			{
-				GetRenderScene().GetMeshAllocator()->AddIndex(aMesh->mFaces[f].mIndices[fi] + vertexIndexOffset);
+				key.box = {
+					node.boundingBox.min.x, node.boundingBox.min.y, node.boundingBox.min.z,
+					node.boundingBox.max.x, node.boundingBox.max.y, node.boundingBox.max.z };
 			}
-		}
-	}
-
-	SceneNodeHandle sceneNodeID = GetRenderScene().GetSceneTree()->CreateNode(transform, box);
-	GetRenderScene().GetMeshAllocator()->GroupMeshes(sceneNodeID, meshes);
-
-	// Transform the bounding box to world space
-	box = box.Transform(transform);
+			auto [it, wasAdded] = addedMeshes.try_emplace(key);
+			if (wasAdded)
+				it->second = ::AddMesh(*meshAllocator, cookedScene, cookedMesh, node.boundingBox, vertexOffset);
 
-	// Then add it to the global world bounding box
-	m_boundingBox = m_boundingBox.Union(box);
+			Mesh mesh = it->second;
+			mesh.materialHandle = m_materials[cookedMesh.materialIndex];
+			meshes.push_back(std::move(mesh));
+		}
+		meshAllocator->GroupMeshes(sceneNodeID, meshes);
 
-	return sceneNodeID;
+		// Transform the bounding box to world space, then add it to the global world bounding box
+		BoundingBox box = node.boundingBox.Transform(sceneTree->GetTransform(sceneNodeID));
+		m_boundingBox = m_boundingBox.Union(box);
+	}
 }
 
-void AssimpSceneLoader::LoadMaterials(vk::CommandBuffer commandBuffer)
+void AssimpSceneLoader::LoadMaterials(const CookedScene& cookedScene)
 {
+	gsl::span<const CookedMaterial> materials = cookedScene.GetMaterials();
+
 	// Check if we already have all materials set-up
-	if (m_materials.size() == m_assimp.scene->mNumMaterials)
+	if (m_materials.size() == materials.size())
 		return;
 
 	// Create a material instance per material description in the scene
 	// todo: eventually create materials according to the needs of materials in the scene
 	// to support different types of materials
-	m_materials.resize(m_assimp.scene->mNumMaterials, MaterialHandle(MaterialShadingDomain::Surface, MaterialShadingModel::Lit, 0));
+	m_materials.resize(materials.size(), MaterialHandle(MaterialShadingDomain::Surface, MaterialShadingModel::Lit, 0));
 	for (size_t i = 0; i < m_materials.size(); ++i)
 	{
-		auto& assimpMaterial = m_assimp.scene->mMaterials[i];
+		const CookedMaterial& material = materials[i];
 
-		// Properties
 		MaterialInstanceInfo materialInfo;
+		materialInfo.properties = material.properties;
+		materialInfo.pipelineProperties = material.pipelineProperties;
 
-		aiColor4D color = {};
-		if (assimpMaterial->Get(AI_MATKEY_BASE_COLOR, color) == aiReturn_SUCCESS)
-		{
-			materialInfo.properties.baseColor = glm::make_vec4(&color.r);
-		}
-
-		aiColor4D emissive = {};
-		if (assimpMaterial->Get(AI_MATKEY_COLOR_EMISSIVE, emissive) == aiReturn_SUCCESS)
-		{
-			materialInfo.properties.emissive = glm::make_vec4(&emissive.r);
-		}
-
-		float ior = 1.5f;
-		if (assimpMaterial->Get(AI_MATKEY_REFRACTI, ior) == aiReturn_SUCCESS)
+		// Load textures, the format depends on how the material samples them
+		for (size_t textureIndex = 0; textureIndex < material.texturePaths.size(); ++textureIndex)
 		{
-			materialInfo.properties.f0 = std::pow(((ior - 1.0f) / (ior + 1.0f)), 2);
-		}
+			if (material.texturePaths[textureIndex].size == 0)
+				continue;
 
-		float metallic = 0.0f;
-		if (assimpMaterial->Get(AI_MATKEY_METALLIC_FACTOR, metallic) == aiReturn_SUCCESS)
-		{
-			materialInfo.properties.metallic = metallic;
+			std::filesystem::path texturePath = m_sceneDir / std::filesystem::path(cookedScene.GetString(material.texturePaths[textureIndex]));
+			materialInfo.properties.textures[textureIndex] = m_renderer->GetTextureCache()->LoadTexture(
+				AssetPath(texturePath), ::GetTextureUsage(static_cast<MaterialTextureType>(textureIndex)));
 		}
 
-		float roughness = 0.0f;
-		if (assimpMaterial->Get(AI_MATKEY_ROUGHNESS_FACTOR, roughness) == aiReturn_SUCCESS)
-		{
-			materialInfo.properties.perceptualRoughness = roughness;
-		}
-
-		// If a material is translucent, opacity will be fetched from the base color alpha channel
-		aiString alphaMode;
-		if (assimpMaterial->Get(AI_MATKEY_GLTF_ALPHAMODE, alphaMode) == aiReturn_SUCCESS)
-		{
-			if (alphaMode.C_Str() == std::string("MASK"))
-			{
-				materialInfo.pipelineProperties.alphaMode = AlphaMode::eMask;
-			}
-			else if (alphaMode.C_Str() == std::string("BLEND"))
-			{
-				materialInfo.pipelineProperties.alphaMode = AlphaMode::eBlend;
-			}
-			else
-			{
-				materialInfo.pipelineProperties.alphaMode = AlphaMode::eOpaque;
-			}
-		}
-
-//#ifdef DEBUG_MODE
-//		aiString name;
-//		assimpMaterial->Get(AI_MATKEY_NAME, name);
-//		material->name = std::string(name.C_Str());
-//#endif
-	
-		// Create default textures
-		for (int textureIndex = 0; textureIndex < (int)MaterialTextureType::eCount; ++textureIndex)
-		{
-			materialInfo.properties.textures[textureIndex] = TextureHandle::Invalid;
-		}
-
-		// Load textures
-		auto loadTexture = [this, &assimpMaterial, &commandBuffer, &materialInfo](aiTextureType type, size_t textureIndex) { // todo: move this to a function
-			if (assimpMaterial->GetTextureCount(type) > 0)
-			{
-				aiString textureFile;
-				assimpMaterial->GetTexture(type, 0, &textureFile);
-				std::filesystem::path texturePath = m_sceneDir / std::filesystem::path(textureFile.C_Str());
-				materialInfo.properties.textures[textureIndex] = m_renderer->GetTextureCache()->LoadTexture(AssetPath(texturePath));
-			}
-		};
-
-		// todo: use sRGB format for color textures if necessary
-		// it looks like gamma correction is OK for now but it might
-		// not be the case for all textures
-		loadTexture(aiTextureType_BASE_COLOR, static_cast<size_t>(MaterialTextureType::eBaseColor));
-		loadTexture(aiTextureType_EMISSIVE, static_cast<size_t>(MaterialTextureType::eEmissive));
-		loadTexture(aiTextureType_GLTF_METALLIC_ROUGHNESS, static_cast<size_t>(MaterialTextureType::eOcclusionMetallicRoughness));
-		loadTexture(aiTextureType_NORMALS, static_cast<size_t>(MaterialTextureType::eNormals));
-
 		m_materials[i] = GetRenderScene().GetMaterialSystem()->CreateMaterialInstance(materialInfo);
 	}
 }
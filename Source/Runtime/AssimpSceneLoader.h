@@ -9,10 +9,8 @@
 #include <Renderer/Camera.h>
 #include <Renderer/ViewProperties.h>
 
-#include <assimp/Importer.hpp> 
-#include <assimp/scene.h>     
-#include <assimp/postprocess.h>
-#include <assimp/cimport.h>
+#include <CookedScene.h>
+
 #include <glm_includes.h>
 #include <gsl/pointers>
 
@@ -43,14 +41,12 @@ public:
 private:
 	RenderScene& GetRenderScene();
 
-	// Uses scene materials
+	// Loads the cooked scene next to the source file, cooks it first if it is missing or outdated
 	void LoadScene(vk::CommandBuffer commandBuffer);
-	void LoadLights(vk::CommandBuffer buffer);
+	void LoadLights(const CookedScene& cookedScene);
 	void LoadCamera();
-	void LoadSceneNodes(vk::CommandBuffer commandBuffer);
-	void LoadNodeAndChildren(aiNode* node, glm::mat4 transform);
-	SceneNodeHandle LoadSceneNode(const aiNode& fileNode, glm::mat4 transform);
-	void LoadMaterials(vk::CommandBuffer commandBuffer);
+	void LoadSceneNodes(const CookedScene& cookedScene);
+	void LoadMaterials(const CookedScene& cookedScene);
 
 private:
 	gsl::not_null<Renderer*> m_renderer;
@@ -63,10 +59,5 @@ private:
 	BoundingBox m_boundingBox;
 	float m_maxVertexDist = 0.0f;
 	std::vector<MaterialHandle> m_materials;
-
-	struct AssimpData
-	{
-		std::unique_ptr<Assimp::Importer> importer = nullptr;
-		const aiScene* scene = nullptr;
-	} m_assimp;
+	std::optional<CookedCamera> m_camera;
 };
@@ -22,6 +22,12 @@ struct BoundingBox
 		return box;
 	}
 
+	// Default constructed boxes are empty (min > max)
+	bool IsValid() const
+	{
+		return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+	}
+
 	bool Intersects(const BoundingBox& box) const
 	{
 		return
@@ -60,6 +66,26 @@ struct BoundingBox
 		return box;
 	}
 
+	// Faster than Transform() but only valid for affine transforms (Arvo, Graphics Gems 1990)
+	BoundingBox TransformAffine(const glm::mat4& transform) const
+	{
+		if (!IsValid())
+			return *this;
+
+		const glm::vec3 center = 0.5f * (min + max);
+		const glm::vec3 extent = 0.5f * (max - min);
+		const glm::vec3 newCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+		const glm::vec3 newExtent =
+			glm::abs(glm::vec3(transform[0])) * extent.x +
+			glm::abs(glm::vec3(transform[1])) * extent.y +
+			glm::abs(glm::vec3(transform[2])) * extent.z;
+
+		BoundingBox box;
+		box.min = newCenter - newExtent;
+		box.max = newCenter + newExtent;
+		return box;
+	}
+
 	glm::vec3 min = glm::vec3(+(std::numeric_limits<float>::max)());
 	glm::vec3 max = glm::vec3(-(std::numeric_limits<float>::max)());
 };
@@ -0,0 +1,303 @@
+#include <BoundingVolumeHierarchy.h>
+
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+	glm::vec3 GetCenter(const BoundingBox& box)
+	{
+		return 0.5f * (box.min + box.max);
+	}
+
+	enum class FrustumTest
+	{
+		eOutside,
+		eIntersects,
+		eInside
+	};
+
+	FrustumTest TestFrustum(const Frustum& frustum, const BoundingBox& box)
+	{
+		const glm::vec3 center = GetCenter(box);
+		const glm::vec3 extent = 0.5f * (box.max - box.min);
+
+		FrustumTest result = FrustumTest::eInside;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			const glm::vec3 normal = glm::vec3(plane);
+			const float distance = glm::dot(normal, center) + plane.w;
+			const float radius = glm::dot(glm::abs(normal), extent);
+			if (distance < -radius)
+				return FrustumTest::eOutside;
+			if (distance < radius)
+				result = FrustumTest::eIntersects;
+		}
+		return result;
+	}
+
+	// Slab test
+	bool IntersectsRay(const BoundingBox& box, glm::vec3 origin, glm::vec3 inverseDirection, float maxDistance)
+	{
+		const glm::vec3 t0 = (box.min - origin) * inverseDirection;
+		const glm::vec3 t1 = (box.max - origin) * inverseDirection;
+		const glm::vec3 tMin = (glm::min)(t0, t1);
+		const glm::vec3 tMax = (glm::max)(t0, t1);
+		const float tEnter = (std::max)((std::max)(tMin.x, tMin.y), (std::max)(tMin.z, 0.0f));
+		const float tExit = (std::min)((std::min)(tMax.x, tMax.y), (std::min)(tMax.z, maxDistance));
+		return tEnter <= tExit;
+	}
+}
+
+void BoundingVolumeHierarchy::Build(const std::vector<BoundingBox>& boxes)
+{
+	m_nodes.clear();
+	m_parents.clear();
+	m_primitiveIndices.clear();
+	m_boxes = boxes;
+	m_primitiveLeaves.assign(boxes.size(), kNoNode);
+	m_dirtyNodes.clear();
+	m_isDirty.clear();
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(boxes.size()); ++i)
+	{
+		if (boxes[i].IsValid())
+			m_primitiveIndices.push_back(i);
+	}
+
+	if (m_primitiveIndices.empty())
+		return;
+
+	// A binary tree with leaves of at least 1 primitive has less than 2N nodes
+	m_nodes.reserve(2 * m_primitiveIndices.size());
+
+	Node root;
+	root.firstChildOrPrimitive = 0;
+	root.primitiveCount = static_cast<uint32_t>(m_primitiveIndices.size());
+	m_nodes.push_back(root);
+	Subdivide(0);
+
+	// Links to walk up the tree from moved primitives
+	m_parents.assign(m_nodes.size(), kNoNode);
+	for (uint32_t i = 0; i < static_cast<uint32_t>(m_nodes.size()); ++i)
+	{
+		const Node& node = m_nodes[i];
+		if (node.primitiveCount == 0)
+		{
+			m_parents[node.firstChildOrPrimitive] = i;
+			m_parents[node.firstChildOrPrimitive + 1] = i;
+			continue;
+		}
+
+		for (uint32_t j = 0; j < node.primitiveCount; ++j)
+			m_primitiveLeaves[m_primitiveIndices[node.firstChildOrPrimitive + j]] = i;
+	}
+	m_isDirty.assign(m_nodes.size(), false);
+}
+
+void BoundingVolumeHierarchy::Subdivide(uint32_t nodeIndex)
+{
+	const uint32_t first = m_nodes[nodeIndex].firstChildOrPrimitive;
+	const uint32_t count = m_nodes[nodeIndex].primitiveCount;
+	const auto begin = m_primitiveIndices.begin() + first;
+	const auto end = begin + count;
+
+	BoundingBox nodeBox;
+	BoundingBox centerBox;
+	for (auto it = begin; it != end; ++it)
+	{
+		const BoundingBox& box = m_boxes[*it];
+		nodeBox = nodeBox.Union(box);
+		const glm::vec3 center = GetCenter(box);
+		centerBox.min = (glm::min)(centerBox.min, center);
+		centerBox.max = (glm::max)(centerBox.max, center);
+	}
+	m_nodes[nodeIndex].box = nodeBox;
+
+	if (count <= kMaxPrimitivesPerLeaf)
+		return;
+
+	// Median split along the axis where centers are the most spread out
+	const glm::vec3 spread = centerBox.max - centerBox.min;
+	int axis = 0;
+	if (spread.y > spread[axis]) axis = 1;
+	if (spread.z > spread[axis]) axis = 2;
+
+	if (spread[axis] <= 0.0f)
+		return; // all centers at the same position, no split would help
+
+	const uint32_t leftCount = count / 2;
+	std::nth_element(begin, begin + leftCount, end, [this, axis](uint32_t a, uint32_t b) {
+		return GetCenter(m_boxes[a])[axis] < GetCenter(m_boxes[b])[axis];
+	});
+
+	const uint32_t leftIndex = static_cast<uint32_t>(m_nodes.size());
+	Node left;
+	left.firstChildOrPrimitive = first;
+	left.primitiveCount = leftCount;
+	Node right;
+	right.firstChildOrPrimitive = first + leftCount;
+	right.primitiveCount = count - leftCount;
+	m_nodes.push_back(left);
+	m_nodes.push_back(right);
+
+	m_nodes[nodeIndex].firstChildOrPrimitive = leftIndex;
+	m_nodes[nodeIndex].primitiveCount = 0;
+
+	Subdivide(leftIndex);
+	Subdivide(leftIndex + 1);
+}
+
+void BoundingVolumeHierarchy::SetPrimitiveBox(uint32_t primitiveIndex, const BoundingBox& box)
+{
+	m_boxes[primitiveIndex] = box;
+
+	// Ancestors of a node already marked are marked too
+	for (uint32_t i = m_primitiveLeaves[primitiveIndex]; i != kNoNode && !m_isDirty[i]; i = m_parents[i])
+	{
+		m_isDirty[i] = true;
+		m_dirtyNodes.push_back(i);
+	}
+}
+
+void BoundingVolumeHierarchy::Refit()
+{
+	// Children are after their parent so a decreasing order updates them first
+	std::sort(m_dirtyNodes.begin(), m_dirtyNodes.end(), std::greater<>());
+	for (uint32_t i : m_dirtyNodes)
+	{
+		Node& node = m_nodes[i];
+		BoundingBox nodeBox;
+		if (node.primitiveCount > 0)
+		{
+			for (uint32_t j = 0; j < node.primitiveCount; ++j)
+			{
+				nodeBox = nodeBox.Union(m_boxes[m_primitiveIndices[node.firstChildOrPrimitive + j]]);
+			}
+		}
+		else
+		{
+			nodeBox = m_nodes[node.firstChildOrPrimitive].box.Union(m_nodes[node.firstChildOrPrimitive + 1].box);
+		}
+		node.box = nodeBox;
+		m_isDirty[i] = false;
+	}
+	m_dirtyNodes.clear();
+}
+
+void BoundingVolumeHierarchy::AddSubtreePrimitives(uint32_t nodeIndex, std::vector<uint32_t>& primitiveIndices) const
+{
+	const Node& node = m_nodes[nodeIndex];
+	if (node.primitiveCount > 0)
+	{
+		const auto begin = m_primitiveIndices.begin() + node.firstChildOrPrimitive;
+		primitiveIndices.insert(primitiveIndices.end(), begin, begin + node.primitiveCount);
+	}
+	else
+	{
+		AddSubtreePrimitives(node.firstChildOrPrimitive, primitiveIndices);
+		AddSubtreePrimitives(node.firstChildOrPrimitive + 1, primitiveIndices);
+	}
+}
+
+void BoundingVolumeHierarchy::QueryBox(const BoundingBox& box, std::vector<uint32_t>& primitiveIndices) const
+{
+	if (m_nodes.empty())
+		return;
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty())
+	{
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if (!node.box.Intersects(box))
+			continue;
+
+		if (node.primitiveCount == 0)
+		{
+			stack.push_back(node.firstChildOrPrimitive);
+			stack.push_back(node.firstChildOrPrimitive + 1);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < node.primitiveCount; ++i)
+		{
+			const uint32_t primitiveIndex = m_primitiveIndices[node.firstChildOrPrimitive + i];
+			if (m_boxes[primitiveIndex].Intersects(box))
+				primitiveIndices.push_back(primitiveIndex);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& primitiveIndices) const
+{
+	if (m_nodes.empty())
+		return;
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty())
+	{
+		const uint32_t nodeIndex = stack.back();
+		const Node& node = m_nodes[nodeIndex];
+		stack.pop_back();
+
+		const FrustumTest test = TestFrustum(frustum, node.box);
+		if (test == FrustumTest::eOutside)
+			continue;
+
+		// No need to test anything below nodes fully inside
+		if (test == FrustumTest::eInside)
+		{
+			AddSubtreePrimitives(nodeIndex, primitiveIndices);
+			continue;
+		}
+
+		if (node.primitiveCount == 0)
+		{
+			stack.push_back(node.firstChildOrPrimitive);
+			stack.push_back(node.firstChildOrPrimitive + 1);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < node.primitiveCount; ++i)
+		{
+			const uint32_t primitiveIndex = m_primitiveIndices[node.firstChildOrPrimitive + i];
+			if (TestFrustum(frustum, m_boxes[primitiveIndex]) != FrustumTest::eOutside)
+				primitiveIndices.push_back(primitiveIndex);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::QueryRay(glm::vec3 origin, glm::vec3 direction, float maxDistance, std::vector<uint32_t>& primitiveIndices) const
+{
+	if (m_nodes.empty())
+		return;
+
+	// Division by 0 gives +/- infinity which the slab test handles
+	const glm::vec3 inverseDirection = 1.0f / direction;
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty())
+	{
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if (!IntersectsRay(node.box, origin, inverseDirection, maxDistance))
+			continue;
+
+		if (node.primitiveCount == 0)
+		{
+			stack.push_back(node.firstChildOrPrimitive);
+			stack.push_back(node.firstChildOrPrimitive + 1);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < node.primitiveCount; ++i)
+		{
+			const uint32_t primitiveIndex = m_primitiveIndices[node.firstChildOrPrimitive + i];
+			if (IntersectsRay(m_boxes[primitiveIndex], origin, inverseDirection, maxDistance))
+				primitiveIndices.push_back(primitiveIndex);
+		}
+	}
+}
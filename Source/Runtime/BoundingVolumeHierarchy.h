@@ -0,0 +1,58 @@
+#pragma once
+
+#include <BoundingBox.h>
+#include <Frustum.h>
+
+#include <glm_includes.h>
+#include <cstdint>
+#include <vector>
+
+// Binary tree of axis-aligned boxes built over a list of primitive boxes.
+// Queries return indices into the list of boxes given to Build().
+class BoundingVolumeHierarchy
+{
+public:
+	// Invalid boxes (e.g. nodes without geometry) are not inserted
+	void Build(const std::vector<BoundingBox>& boxes);
+
+	// Moves a primitive given to Build(), its leaf and their ancestors are refit by the next call to Refit()
+	void SetPrimitiveBox(uint32_t primitiveIndex, const BoundingBox& box);
+
+	// Updates the bounds of the nodes above moved primitives, the tree topology is kept
+	void Refit();
+
+	size_t GetPrimitiveCount() const { return m_boxes.size(); }
+
+	// Union of all primitive boxes
+	BoundingBox GetBoundingBox() const { return m_nodes.empty() ? BoundingBox() : m_nodes[0].box; }
+
+	// Results are appended to primitiveIndices
+	void QueryBox(const BoundingBox& box, std::vector<uint32_t>& primitiveIndices) const;
+	void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& primitiveIndices) const;
+	void QueryRay(glm::vec3 origin, glm::vec3 direction, float maxDistance, std::vector<uint32_t>& primitiveIndices) const;
+
+private:
+	struct Node
+	{
+		BoundingBox box;
+		uint32_t firstChildOrPrimitive = 0; // children are stored next to each other
+		uint32_t primitiveCount = 0; // 0 for inner nodes
+	};
+
+	static constexpr uint32_t kMaxPrimitivesPerLeaf = 4;
+	static constexpr uint32_t kNoNode = ~0U;
+
+	void Subdivide(uint32_t nodeIndex);
+	void AddSubtreePrimitives(uint32_t nodeIndex, std::vector<uint32_t>& primitiveIndices) const;
+
+	// Children are always after their parent
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_parents; // per node, kNoNode for the root
+	std::vector<uint32_t> m_primitiveIndices; // sorted so that each leaf has a contiguous range
+	std::vector<BoundingBox> m_boxes; // primitive boxes, indexed as given to Build()
+	std::vector<uint32_t> m_primitiveLeaves; // per primitive, kNoNode for invalid boxes
+
+	// Nodes to refit, each one is followed by its ancestors
+	std::vector<uint32_t> m_dirtyNodes;
+	std::vector<uint8_t> m_isDirty; // per node
+};
@@ -0,0 +1,180 @@
+#include <CookedScene.h>
+
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+namespace
+{
+	constexpr std::array<char, 4> kMagic = { 'C', 'S', 'C', 'N' };
+	constexpr size_t kSectionAlignment = 16; // largest alignment of section elements (glm aligned types)
+	constexpr size_t kSectionCount = static_cast<size_t>(CookedSceneSection::eCount);
+
+	struct SectionHeader
+	{
+		uint64_t offset = 0; // from the start of the file
+		uint64_t size = 0; // in bytes
+		uint32_t elementSize = 0; // to detect layout changes without a version bump
+		uint32_t padding = 0;
+	};
+
+	struct FileHeader
+	{
+		std::array<char, 4> magic = kMagic;
+		uint32_t version = CookedScene::kVersion;
+		uint32_t sectionCount = static_cast<uint32_t>(kSectionCount);
+		float maxVertexDistance = 0.0f;
+		std::array<SectionHeader, kSectionCount> sections;
+	};
+
+	constexpr std::array<uint32_t, kSectionCount> kElementSizes = {
+		sizeof(CookedSceneNode),
+		sizeof(CookedMesh),
+		sizeof(Vertex),
+		sizeof(uint32_t),
+		sizeof(CookedLight),
+		sizeof(CookedCamera),
+		sizeof(CookedMaterial),
+		sizeof(char),
+		sizeof(Meshlet),
+		sizeof(CookedMeshLod),
+	};
+
+	constexpr size_t AlignUp(size_t size, size_t alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	template <class T>
+	void WriteSection(CookedSceneSection section, const std::vector<T>& elements, FileHeader& header, std::vector<std::byte>& output)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+
+		const size_t offset = AlignUp(output.size(), kSectionAlignment);
+		const size_t size = elements.size() * sizeof(T);
+		output.resize(offset + size);
+		if (size > 0)
+			memcpy(output.data() + offset, elements.data(), size);
+
+		SectionHeader& sectionHeader = header.sections[static_cast<size_t>(section)];
+		sectionHeader.offset = offset;
+		sectionHeader.size = size;
+		sectionHeader.elementSize = sizeof(T);
+	}
+}
+
+CookedString CookedSceneBuilder::AddString(std::string_view str)
+{
+	CookedString cookedString;
+	cookedString.offset = static_cast<uint32_t>(strings.size());
+	cookedString.size = static_cast<uint32_t>(str.size());
+	strings.insert(strings.end(), str.begin(), str.end());
+	return cookedString;
+}
+
+std::vector<std::byte> CookedSceneBuilder::Serialize() const
+{
+	FileHeader header;
+	header.maxVertexDistance = maxVertexDistance;
+
+	std::vector<std::byte> output(sizeof(FileHeader));
+	::WriteSection(CookedSceneSection::eNodes, nodes, header, output);
+	::WriteSection(CookedSceneSection::eMeshes, meshes, header, output);
+	::WriteSection(CookedSceneSection::eVertices, vertices, header, output);
+	::WriteSection(CookedSceneSection::eIndices, indices, header, output);
+	::WriteSection(CookedSceneSection::eLights, lights, header, output);
+	::WriteSection(CookedSceneSection::eCameras, cameras, header, output);
+	::WriteSection(CookedSceneSection::eMaterials, materials, header, output);
+	::WriteSection(CookedSceneSection::eStrings, strings, header, output);
+	::WriteSection(CookedSceneSection::eMeshlets, meshlets, header, output);
+	::WriteSection(CookedSceneSection::eMeshLods, meshLods, header, output);
+
+	memcpy(output.data(), &header, sizeof(FileHeader));
+	return output;
+}
+
+std::optional<CookedScene> CookedScene::Load(const std::filesystem::path& filePath)
+{
+	CookedScene scene;
+	scene.m_mappedFile = MappedFile::Open(filePath);
+	if (!scene.m_mappedFile || !scene.Validate())
+		return std::nullopt;
+
+	return scene;
+}
+
+std::optional<CookedScene> CookedScene::FromMemory(std::vector<std::byte> data)
+{
+	CookedScene scene;
+	scene.m_data = std::move(data);
+	if (!scene.Validate())
+		return std::nullopt;
+
+	return scene;
+}
+
+bool CookedScene::Save(const std::filesystem::path& filePath, gsl::span<const std::byte> data)
+{
+	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return file.good();
+}
+
+std::string_view CookedScene::GetString(CookedString str) const
+{
+	gsl::span<const char> strings = GetSection<char>(CookedSceneSection::eStrings);
+	assert(str.offset + str.size <= strings.size());
+	return std::string_view(strings.data() + str.offset, str.size);
+}
+
+float CookedScene::GetMaxVertexDistance() const
+{
+	FileHeader header;
+	memcpy(&header, GetBytes().data(), sizeof(FileHeader));
+	return header.maxVertexDistance;
+}
+
+bool CookedScene::Validate() const
+{
+	gsl::span<const std::byte> bytes = GetBytes();
+	if (bytes.size() < sizeof(FileHeader))
+		return false;
+
+	FileHeader header;
+	memcpy(&header, bytes.data(), sizeof(FileHeader));
+	if (header.magic != kMagic || header.version != kVersion || header.sectionCount != kSectionCount)
+		return false;
+
+	for (size_t i = 0; i < kSectionCount; ++i)
+	{
+		const SectionHeader& section = header.sections[i];
+		if (section.elementSize != kElementSizes[i] ||
+			section.offset % kSectionAlignment != 0 ||
+			section.size % section.elementSize != 0 ||
+			section.offset > bytes.size() ||
+			section.size > bytes.size() - section.offset)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+gsl::span<const std::byte> CookedScene::GetBytes() const
+{
+	if (m_mappedFile)
+		return gsl::span<const std::byte>(m_mappedFile->GetData(), m_mappedFile->GetSize());
+
+	return gsl::span<const std::byte>(m_data.data(), m_data.size());
+}
+
+gsl::span<const std::byte> CookedScene::GetSectionBytes(CookedSceneSection section) const
+{
+	// Sections were validated on load
+	const SectionHeader& sectionHeader = reinterpret_cast<const FileHeader*>(GetBytes().data())->sections[static_cast<size_t>(section)];
+	return GetBytes().subspan(static_cast<size_t>(sectionHeader.offset), static_cast<size_t>(sectionHeader.size));
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <Renderer/LightSystem.h>
+#include <Renderer/MaterialSystem.h>
+#include <Renderer/MeshAllocator.h>
+#include <BoundingBox.h>
+#include <MappedFile.h>
+
+#include <glm_includes.h>
+#include <gsl/span>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Scene data converted once from a source file (e.g. with Assimp) and stored
+// in a versioned binary file. Every section is a flat array of the structures
+// below so that a mapped file can be used as is, without parsing.
+
+inline constexpr uint32_t kInvalidCookedIndex = (std::numeric_limits<uint32_t>::max)();
+
+// Nodes are in creation order, parents before their children
+struct CookedSceneNode
+{
+	glm::mat4 localTransform;
+	BoundingBox boundingBox; // local, invalid if the node has no meshes
+	uint32_t parentIndex = kInvalidCookedIndex;
+	uint32_t firstMesh = 0;
+	uint32_t meshCount = 0;
+	uint32_t padding = 0;
+};
+
+// Meshes of different nodes can share the same index range
+struct CookedMesh
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	uint32_t materialIndex = 0; // into the materials section
+	uint32_t firstMeshlet = 0; // into the meshlets section
+	uint32_t meshletCount = 0;
+	uint32_t firstLod = 0; // into the mesh LODs section
+	uint32_t lodCount = 0; // coarser levels, the mesh itself being level 0
+	uint32_t padding = 0;
+};
+
+// Simplified version of a mesh, its indices use the vertices of the mesh
+struct CookedMeshLod
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+};
+
+struct CookedLight
+{
+	Light light;
+	uint32_t castsShadows = 0;
+	uint32_t padding[3] = { 0, 0, 0 };
+};
+
+struct CookedCamera
+{
+	glm::vec3 position;
+	float fieldOfView = 0.0f; // degrees
+	glm::vec3 lookAt;
+	float padding0 = 0.0f;
+	glm::vec3 up;
+	float padding1 = 0.0f;
+};
+
+// Range of characters in the strings section
+struct CookedString
+{
+	uint32_t offset = 0;
+	uint32_t size = 0;
+};
+
+// Texture handles are not stored, textures are loaded from their path relative to the scene
+struct CookedMaterial
+{
+	MaterialProperties properties = {};
+	MaterialPipelineProperties pipelineProperties = {};
+	std::array<CookedString, static_cast<size_t>(MaterialTextureType::eCount)> texturePaths; // size 0 if none
+};
+
+enum class CookedSceneSection : uint32_t
+{
+	eNodes,
+	eMeshes,
+	eVertices,
+	eIndices, // relative to the first vertex of the scene
+	eLights,
+	eCameras, // 0 or 1
+	eMaterials,
+	eStrings,
+	eMeshlets, // index ranges relative to the first index of the scene
+	eMeshLods,
+	eCount
+};
+
+// Accumulates scene data before writing it
+struct CookedSceneBuilder
+{
+	std::vector<CookedSceneNode> nodes;
+	std::vector<CookedMesh> meshes;
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<CookedLight> lights;
+	std::vector<CookedCamera> cameras;
+	std::vector<CookedMaterial> materials;
+	std::vector<char> strings;
+	std::vector<Meshlet> meshlets;
+	std::vector<CookedMeshLod> meshLods;
+	float maxVertexDistance = 0.0f;
+
+	CookedString AddString(std::string_view str);
+
+	// Returns the content of a cooked scene file
+	std::vector<std::byte> Serialize() const;
+};
+
+// Read-only access to cooked data, either mapped from a file or kept in memory
+class CookedScene
+{
+public:
+	// Bumped whenever the layout of a section or the way it is cooked changes
+	static constexpr uint32_t kVersion = 5;
+
+	static constexpr std::string_view kFileExtension = ".cooked";
+
+	// Returns std::nullopt if the file is missing, truncated or from another version
+	static std::optional<CookedScene> Load(const std::filesystem::path& filePath);
+
+	static std::optional<CookedScene> FromMemory(std::vector<std::byte> data);
+
+	// Writes the file in one go, returns false on failure
+	static bool Save(const std::filesystem::path& filePath, gsl::span<const std::byte> data);
+
+	gsl::span<const CookedSceneNode> GetNodes() const { return GetSection<CookedSceneNode>(CookedSceneSection::eNodes); }
+	gsl::span<const CookedMesh> GetMeshes() const { return GetSection<CookedMesh>(CookedSceneSection::eMeshes); }
+	gsl::span<const Vertex> GetVertices() const { return GetSection<Vertex>(CookedSceneSection::eVertices); }
+	gsl::span<const uint32_t> GetIndices() const { return GetSection<uint32_t>(CookedSceneSection::eIndices); }
+	gsl::span<const CookedLight> GetLights() const { return GetSection<CookedLight>(CookedSceneSection::eLights); }
+	gsl::span<const CookedCamera> GetCameras() const { return GetSection<CookedCamera>(CookedSceneSection::eCameras); }
+	gsl::span<const CookedMaterial> GetMaterials() const { return GetSection<CookedMaterial>(CookedSceneSection::eMaterials); }
+	gsl::span<const Meshlet> GetMeshlets() const { return GetSection<Meshlet>(CookedSceneSection::eMeshlets); }
+	gsl::span<const CookedMeshLod> GetMeshLods() const { return GetSection<CookedMeshLod>(CookedSceneSection::eMeshLods); }
+
+	std::string_view GetString(CookedString str) const;
+
+	float GetMaxVertexDistance() const;
+
+private:
+	CookedScene() = default;
+
+	bool Validate() const;
+
+	gsl::span<const std::byte> GetBytes() const;
+
+	template <class T>
+	gsl::span<const T> GetSection(CookedSceneSection section) const
+	{
+		gsl::span<const std::byte> bytes = GetSectionBytes(section);
+		return gsl::span<const T>(reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T));
+	}
+
+	gsl::span<const std::byte> GetSectionBytes(CookedSceneSection section) const;
+
+	std::optional<MappedFile> m_mappedFile;
+	std::vector<std::byte> m_data; // when not mapped
+};
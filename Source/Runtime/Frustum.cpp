@@ -0,0 +1,42 @@
+#include <Frustum.h>
+
+Frustum Frustum::FromMatrix(const glm::mat4& viewProj)
+{
+	// Gribb & Hartmann, rows of the column-major matrix
+	const glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+	const glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+	const glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+	const glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+	Frustum frustum;
+	frustum.planes[eLeft] = row3 + row0;
+	frustum.planes[eRight] = row3 - row0;
+	frustum.planes[eBottom] = row3 + row1;
+	frustum.planes[eTop] = row3 - row1;
+	frustum.planes[eNear] = row2; // 0 <= z
+	frustum.planes[eFar] = row3 - row2;
+
+	for (glm::vec4& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+bool Frustum::Intersects(const BoundingBox& box) const
+{
+	const glm::vec3 center = 0.5f * (box.min + box.max);
+	const glm::vec3 extent = 0.5f * (box.max - box.min);
+
+	for (const glm::vec4& plane : planes)
+	{
+		const glm::vec3 normal = glm::vec3(plane);
+		const float distance = glm::dot(normal, center) + plane.w;
+		const float radius = glm::dot(glm::abs(normal), extent);
+		if (distance < -radius)
+			return false;
+	}
+
+	return true;
+}
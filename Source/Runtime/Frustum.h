@@ -0,0 +1,29 @@
+#pragma once
+
+#include <BoundingBox.h>
+#include <glm_includes.h>
+
+#include <array>
+
+struct Frustum
+{
+	enum Plane
+	{
+		eLeft = 0,
+		eRight,
+		eBottom,
+		eTop,
+		eNear,
+		eFar,
+		eCount
+	};
+
+	// Extracts planes from a Vulkan clip space transform (depth in [0, 1])
+	static Frustum FromMatrix(const glm::mat4& viewProj);
+
+	// Conservative test, may return true for boxes close to the frustum corners
+	bool Intersects(const BoundingBox& box) const;
+
+	// Plane normals point inside the frustum: dot(plane.xyz, p) + plane.w >= 0 inside
+	std::array<glm::vec4, Plane::eCount> planes;
+};
@@ -0,0 +1,365 @@
+#include <MeshOptimization.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t kInvalidIndex = ~0U;
+
+	// Triangles using each vertex, as offsets into a single array
+	struct VertexTriangles
+	{
+		std::vector<uint32_t> offsets; // vertexCount + 1
+		std::vector<uint32_t> triangles;
+
+		VertexTriangles(gsl::span<const uint32_t> indices, uint32_t vertexCount)
+			: offsets(vertexCount + 1, 0)
+			, triangles(indices.size())
+		{
+			for (uint32_t index : indices)
+				offsets[index + 1]++;
+			for (uint32_t v = 0; v < vertexCount; ++v)
+				offsets[v + 1] += offsets[v];
+
+			std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); ++i)
+				triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		gsl::span<const uint32_t> Get(uint32_t vertex) const
+		{
+			return gsl::span<const uint32_t>(triangles.data() + offsets[vertex], offsets[vertex + 1] - offsets[vertex]);
+		}
+	};
+
+	// Bounding sphere and normal cone of the triangles of a meshlet
+	void ComputeMeshletBounds(Meshlet& meshlet, gsl::span<const uint32_t> indices, gsl::span<const Vertex> vertices)
+	{
+		gsl::span<const uint32_t> meshletIndices = indices.subspan(meshlet.firstIndex, meshlet.indexCount);
+
+		glm::vec3 boxMin(std::numeric_limits<float>::max());
+		glm::vec3 boxMax(std::numeric_limits<float>::lowest());
+		for (uint32_t index : meshletIndices)
+		{
+			boxMin = (glm::min)(boxMin, vertices[index].pos);
+			boxMax = (glm::max)(boxMax, vertices[index].pos);
+		}
+		meshlet.center = 0.5f * (boxMin + boxMax);
+		meshlet.radius = 0.0f;
+		for (uint32_t index : meshletIndices)
+		{
+			meshlet.radius = (std::max)(meshlet.radius, glm::distance(meshlet.center, vertices[index].pos));
+		}
+
+		// Normals of counter-clockwise triangles
+		std::vector<glm::vec3> normals;
+		normals.reserve(meshletIndices.size() / 3);
+		glm::vec3 normalSum(0.0f);
+		for (size_t i = 0; i + 2 < meshletIndices.size(); i += 3)
+		{
+			const glm::vec3& a = vertices[meshletIndices[i]].pos;
+			const glm::vec3& b = vertices[meshletIndices[i + 1]].pos;
+			const glm::vec3& c = vertices[meshletIndices[i + 2]].pos;
+			const glm::vec3 normal = glm::cross(b - a, c - a);
+			const float length = glm::length(normal);
+			if (length > 0.0f)
+			{
+				normals.push_back(normal / length);
+				normalSum += normals.back();
+			}
+		}
+
+		meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+		meshlet.coneCutoff = 1.0f;
+		const float sumLength = glm::length(normalSum);
+		if (sumLength == 0.0f)
+			return;
+
+		meshlet.coneAxis = normalSum / sumLength;
+		float minDot = 1.0f;
+		for (const glm::vec3& normal : normals)
+		{
+			minDot = (std::min)(minDot, glm::dot(normal, meshlet.coneAxis));
+		}
+
+		// A cone wider than a hemisphere always has front-facing triangles
+		if (minDot > 0.0f)
+			meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+
+	// Merges vertices per cell of a grid of gridSize cells along the largest side of the box,
+	// each cell is replaced by its vertex closest to the average position of the cell
+	void ClusterVertices(
+		gsl::span<const uint32_t> indices,
+		gsl::span<const Vertex> vertices,
+		const glm::vec3& boxMin,
+		float cellSize,
+		uint32_t gridSize,
+		std::vector<uint32_t>& simplifiedIndices)
+	{
+		const uint64_t cellsPerAxis = gridSize + 1;
+		auto getCell = [&](uint32_t vertex) {
+			const glm::uvec3 cell = glm::uvec3((vertices[vertex].pos - boxMin) / cellSize);
+			return (cell.x * cellsPerAxis + cell.y) * cellsPerAxis + cell.z;
+		};
+
+		struct Cell
+		{
+			glm::vec3 positionSum = glm::vec3(0.0f);
+			uint32_t vertexCount = 0;
+			uint32_t representative = kInvalidIndex;
+			float representativeDistance2 = 0.0f;
+		};
+		std::unordered_map<uint64_t, Cell> cells;
+		constexpr uint64_t kNoCell = ~0ULL;
+		std::vector<uint64_t> vertexCells(vertices.size(), kNoCell);
+		for (uint32_t index : indices)
+		{
+			if (vertexCells[index] != kNoCell)
+				continue;
+
+			vertexCells[index] = getCell(index);
+			Cell& cell = cells[vertexCells[index]];
+			cell.positionSum += vertices[index].pos;
+			cell.vertexCount++;
+		}
+		for (uint32_t index : indices)
+		{
+			Cell& cell = cells[vertexCells[index]];
+			const glm::vec3 offset = vertices[index].pos - cell.positionSum / static_cast<float>(cell.vertexCount);
+			const float distance2 = glm::dot(offset, offset);
+			if (cell.representative == kInvalidIndex || distance2 < cell.representativeDistance2)
+			{
+				cell.representative = index;
+				cell.representativeDistance2 = distance2;
+			}
+		}
+
+		// Triangles with merged corners are dropped
+		simplifiedIndices.clear();
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const uint32_t a = cells[vertexCells[indices[i]]].representative;
+			const uint32_t b = cells[vertexCells[indices[i + 1]]].representative;
+			const uint32_t c = cells[vertexCells[indices[i + 2]]].representative;
+			if (a != b && b != c && c != a)
+				simplifiedIndices.insert(simplifiedIndices.end(), { a, b, c });
+		}
+	}
+}
+
+void OptimizeVertexCache(gsl::span<uint32_t> indices, uint32_t vertexCount)
+{
+	assert(indices.size() % 3 == 0);
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	const VertexTriangles vertexTriangles(indices, vertexCount);
+
+	std::vector<uint32_t> liveTriangles(vertexCount); // not emitted yet
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		liveTriangles[v] = static_cast<uint32_t>(vertexTriangles.Get(v).size());
+
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	std::vector<uint8_t> isEmitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnds; // recently used vertices, to restart from when a fan runs out of triangles
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	uint32_t timestamp = kVertexCacheSize + 1;
+	uint32_t cursor = 0; // next vertex to try once dead ends are exhausted
+	uint32_t fanVertex = 0;
+	while (fanVertex != kInvalidIndex)
+	{
+		// Emit all remaining triangles around the fanning vertex
+		candidates.clear();
+		for (uint32_t triangle : vertexTriangles.Get(fanVertex))
+		{
+			if (isEmitted[triangle])
+				continue;
+
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				const uint32_t v = indices[3 * triangle + corner];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (timestamp - cacheTimestamps[v] > kVertexCacheSize)
+					cacheTimestamps[v] = timestamp++;
+			}
+			isEmitted[triangle] = 1;
+		}
+
+		// Next fanning vertex: the candidate that will still be in the cache once its triangles are emitted,
+		// preferring the oldest one
+		fanVertex = kInvalidIndex;
+		uint32_t bestPriority = 0;
+		for (uint32_t v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+
+			uint32_t priority = 0;
+			if (timestamp - cacheTimestamps[v] + 2 * liveTriangles[v] <= kVertexCacheSize)
+				priority = timestamp - cacheTimestamps[v];
+			if (fanVertex == kInvalidIndex || priority > bestPriority)
+			{
+				bestPriority = priority;
+				fanVertex = v;
+			}
+		}
+
+		// Dead end: restart from a recent vertex, otherwise from the next vertex in input order
+		while (fanVertex == kInvalidIndex && !deadEnds.empty())
+		{
+			const uint32_t v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[v] > 0)
+				fanVertex = v;
+		}
+		while (fanVertex == kInvalidIndex && cursor < vertexCount)
+		{
+			if (liveTriangles[cursor] > 0)
+				fanVertex = cursor;
+			cursor++;
+		}
+	}
+
+	assert(output.size() == indices.size());
+	std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void OptimizeVertexFetch(gsl::span<uint32_t> indices, gsl::span<Vertex> vertices)
+{
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	std::vector<uint32_t> remap(vertexCount, kInvalidIndex);
+
+	uint32_t nextVertex = 0;
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == kInvalidIndex)
+			remap[index] = nextVertex++;
+		index = remap[index];
+	}
+	for (uint32_t& newIndex : remap)
+	{
+		if (newIndex == kInvalidIndex)
+			newIndex = nextVertex++;
+	}
+
+	std::vector<Vertex> reordered(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		reordered[remap[v]] = vertices[v];
+	std::copy(reordered.begin(), reordered.end(), vertices.begin());
+}
+
+void BuildMeshlets(gsl::span<const uint32_t> indices, gsl::span<const Vertex> vertices, std::vector<Meshlet>& meshlets)
+{
+	assert(indices.size() % 3 == 0);
+
+	// Meshlet that last used each vertex, to count unique vertices
+	std::vector<uint32_t> vertexMeshlets(vertices.size(), kInvalidIndex);
+
+	Meshlet meshlet;
+	uint32_t meshletID = static_cast<uint32_t>(meshlets.size());
+	uint32_t vertexCount = 0;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		uint32_t newVertexCount = 0;
+		for (size_t corner = 0; corner < 3; ++corner)
+			newVertexCount += vertexMeshlets[indices[i + corner]] != meshletID ? 1 : 0;
+
+		// Triangles stay in order so that the cache optimized order is kept within meshlets
+		if (vertexCount + newVertexCount > Meshlet::kMaxVertices || meshlet.indexCount / 3 + 1 > Meshlet::kMaxTriangles)
+		{
+			::ComputeMeshletBounds(meshlet, indices, vertices);
+			meshlets.push_back(meshlet);
+
+			meshlet = Meshlet();
+			meshlet.firstIndex = static_cast<uint32_t>(i);
+			meshletID++;
+			vertexCount = 0;
+		}
+
+		for (size_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t& vertexMeshlet = vertexMeshlets[indices[i + corner]];
+			if (vertexMeshlet != meshletID)
+			{
+				vertexMeshlet = meshletID;
+				vertexCount++;
+			}
+		}
+		meshlet.indexCount += 3;
+	}
+
+	if (meshlet.indexCount > 0)
+	{
+		::ComputeMeshletBounds(meshlet, indices, vertices);
+		meshlets.push_back(meshlet);
+	}
+}
+
+std::vector<std::vector<uint32_t>> BuildLods(gsl::span<const uint32_t> indices, gsl::span<const Vertex> vertices, uint32_t maxLodCount)
+{
+	assert(indices.size() % 3 == 0);
+
+	// Not worth a level of detail below this
+	constexpr size_t kMinTriangleCount = 64;
+
+	glm::vec3 boxMin(std::numeric_limits<float>::max());
+	glm::vec3 boxMax(std::numeric_limits<float>::lowest());
+	for (uint32_t index : indices)
+	{
+		boxMin = (glm::min)(boxMin, vertices[index].pos);
+		boxMax = (glm::max)(boxMax, vertices[index].pos);
+	}
+	const glm::vec3 boxSize = boxMax - boxMin;
+	const float maxSize = (std::max)({ boxSize.x, boxSize.y, boxSize.z });
+
+	std::vector<std::vector<uint32_t>> lods;
+	std::vector<uint32_t> simplifiedIndices;
+	size_t triangleCount = indices.size() / 3;
+	uint32_t gridSize = 256;
+	while (lods.size() < maxLodCount && triangleCount / 2 >= kMinTriangleCount && maxSize > 0.0f)
+	{
+		// Coarser grids until the triangle count is halved
+		const size_t targetIndexCount = 3 * (triangleCount / 2);
+		do
+		{
+			::ClusterVertices(indices, vertices, boxMin, maxSize / gridSize, gridSize, simplifiedIndices);
+			if (simplifiedIndices.size() > targetIndexCount)
+				gridSize = gridSize * 3 / 4;
+		} while (simplifiedIndices.size() > targetIndexCount && gridSize >= 2);
+
+		if (simplifiedIndices.size() > targetIndexCount || simplifiedIndices.size() / 3 < kMinTriangleCount)
+			break;
+
+		::OptimizeVertexCache(simplifiedIndices, static_cast<uint32_t>(vertices.size()));
+		triangleCount = simplifiedIndices.size() / 3;
+		lods.push_back(simplifiedIndices);
+	}
+	return lods;
+}
+
+uint32_t CountTransformedVertices(gsl::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+	// A vertex is in the FIFO if it was inserted less than cacheSize insertions ago
+	std::vector<uint32_t> insertionTimes(vertexCount, 0);
+	uint32_t insertionCount = 0;
+	for (uint32_t index : indices)
+	{
+		const bool isCached = insertionTimes[index] != 0 && insertionCount - insertionTimes[index] < cacheSize;
+		if (!isCached)
+			insertionTimes[index] = ++insertionCount;
+	}
+	return insertionCount;
+}
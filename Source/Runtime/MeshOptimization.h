@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Renderer/MeshAllocator.h>
+
+#include <gsl/span>
+
+#include <cstdint>
+#include <vector>
+
+// Import-time reordering of indexed triangle lists. Indices are relative to the first vertex of the mesh.
+
+// Post-transform vertex cache size assumed by the optimization and the statistics
+inline constexpr uint32_t kVertexCacheSize = 16;
+
+// Reorders triangles so that consecutive triangles reuse recently transformed vertices (Tipsify, Sander et al. 2007)
+void OptimizeVertexCache(gsl::span<uint32_t> indices, uint32_t vertexCount);
+
+// Reorders vertices in order of first use so that vertex fetches are mostly sequential, then remaps indices.
+// Vertices that are not referenced are moved to the end.
+void OptimizeVertexFetch(gsl::span<uint32_t> indices, gsl::span<Vertex> vertices);
+
+// Splits triangles in clusters of consecutive triangles, see Meshlet for the limits.
+// Meshlet index ranges are relative to the start of indices.
+void BuildMeshlets(gsl::span<const uint32_t> indices, gsl::span<const Vertex> vertices, std::vector<Meshlet>& meshlets);
+
+// Builds up to maxLodCount coarser versions of a mesh, each with at most half the triangles of the previous one.
+// Vertices falling in the same cell of a grid are merged (vertex clustering, Rossignac and Borrel 1993), the grid
+// is made coarser until the triangle count is low enough. Levels only reference the given vertices.
+std::vector<std::vector<uint32_t>> BuildLods(gsl::span<const uint32_t> indices, gsl::span<const Vertex> vertices, uint32_t maxLodCount);
+
+// Number of vertices transformed with a FIFO post-transform cache,
+// divided by the number of triangles it gives the average cache miss ratio (ACMR)
+uint32_t CountTransformedVertices(gsl::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = kVertexCacheSize);
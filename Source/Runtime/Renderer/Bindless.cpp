@@ -1,5 +1,6 @@
 #include <Renderer/Bindless.h>
 
+#include <RHI/ComputePipelineCache.h>
 #include <RHI/GraphicsPipelineCache.h>
 #include <RHI/Device.h>
 
@@ -113,7 +114,7 @@ vk::UniqueDescriptorSetLayout BindlessDrawParams::CreateDescriptorSetLayout()
 	binding.binding = 0;
 	binding.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
 	binding.descriptorCount = 1;
-	binding.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+	binding.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
 
 	vk::DescriptorSetLayoutCreateInfo layoutCreateInfo;
 	layoutCreateInfo.bindingCount = 1;
@@ -221,7 +222,16 @@ BindlessDescriptors::BindlessDescriptors()
 TextureHandle BindlessDescriptors::StoreTexture(vk::ImageView imageView, vk::Sampler sampler)
 {
 	uint32_t textureHandle = static_cast<uint32_t>(m_textures.size());
-	m_textures.push_back(imageView);
+	if (!m_freeTextureSlots.empty())
+	{
+		textureHandle = m_freeTextureSlots.back();
+		m_freeTextureSlots.pop_back();
+		m_textures[textureHandle] = imageView;
+	}
+	else
+	{
+		m_textures.push_back(imageView);
+	}
 
 	vk::DescriptorImageInfo imageInfo;
 	imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
@@ -240,6 +250,14 @@ TextureHandle BindlessDescriptors::StoreTexture(vk::ImageView imageView, vk::Sam
     return static_cast<TextureHandle>(textureHandle);
 }
 
+void BindlessDescriptors::ReleaseTexture(TextureHandle textureHandle)
+{
+	const uint32_t textureIndex = static_cast<uint32_t>(textureHandle);
+	assert(textureIndex < m_textures.size());
+	m_textures[textureIndex] = nullptr;
+	m_freeTextureSlots.push_back(textureIndex);
+}
+
 BufferHandle BindlessDescriptors::StoreBuffer(vk::Buffer buffer, vk::BufferUsageFlagBits usage)
 {
 	uint32_t bufferHandle = static_cast<uint32_t>(m_buffers.size());
@@ -303,8 +321,9 @@ void BindlessDescriptors::CreateDescriptorSetLayout()
 		binding.binding = i;
 		binding.descriptorType = types[i];
 		binding.descriptorCount = kMaxDescriptorCount;
-		binding.stageFlags = vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eVertex;
-		flags[i] = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+		binding.stageFlags = vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eCompute;
+		flags[i] = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+			vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
 	}
 
 	vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo;
@@ -364,7 +383,8 @@ void BindlessDescriptors::CreatePipelineLayout()
 BindlessFactory::BindlessFactory(
 	const BindlessDescriptors& bindlessDescriptors,
 	const BindlessDrawParams& bindlessDrawParams,
-	GraphicsPipelineCache& graphicsPipelineCache)
+	GraphicsPipelineCache& graphicsPipelineCache,
+	ComputePipelineCache& computePipelineCache)
 {
 	SetVector<SmallVector<vk::DescriptorSetLayoutBinding>> bindings = {
 		bindlessDescriptors.GetDescriptorSetLayoutBindings(),
@@ -379,4 +399,5 @@ BindlessFactory::BindlessFactory(
 		bindlessDrawParams.GetPipelineLayout()
 	};
 	graphicsPipelineCache.SetCommonLayout(std::move(bindings), std::move(descriptorSetLayouts), std::move(pipelineLayouts));
+	computePipelineCache.SetCommonLayout(bindlessDrawParams.GetPipelineLayout());
 }
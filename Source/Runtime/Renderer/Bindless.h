@@ -15,6 +15,7 @@ namespace vk
 	class CommandBuffer;
 }
 
+class ComputePipelineCache;
 class GraphicsPipelineCache;
 
 class BindlessDrawParams
@@ -81,7 +82,11 @@ public:
 
 	BindlessDescriptors();
 
+	// Reuses the slot of a released texture if any, slots not used by commands pending execution can be written
 	TextureHandle StoreTexture(vk::ImageView imageView, vk::Sampler sampler);
+
+	// Once the commands sampling the texture have completed, its slot is then reused by StoreTexture()
+	void ReleaseTexture(TextureHandle textureHandle);
 	BufferHandle StoreBuffer(vk::Buffer buffer, vk::BufferUsageFlagBits usage);
 
 	vk::DescriptorSet GetDescriptorSet() const { return m_descriptorSet.get(); }
@@ -91,6 +96,7 @@ public:
 
 private:
 	std::vector<vk::ImageView> m_textures;
+	std::vector<uint32_t> m_freeTextureSlots;
 	std::vector<vk::Buffer> m_buffers;
 
 	SmallVector<vk::DescriptorSetLayoutBinding> m_descriptorSetLayoutBindings;
@@ -113,5 +119,6 @@ public:
 	BindlessFactory(
 		const BindlessDescriptors& bindlessDescriptors,
 		const BindlessDrawParams& bindlessDrawParams,
-		GraphicsPipelineCache& graphicsPipelineCache);
+		GraphicsPipelineCache& graphicsPipelineCache,
+		ComputePipelineCache& computePipelineCache);
 };
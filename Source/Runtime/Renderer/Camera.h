@@ -1,6 +1,7 @@
 #pragma once
 
 #include "glm_includes.h"
+#include <Frustum.h>
 
 #include <map>
 #include <vector>
@@ -48,6 +49,16 @@ public:
 
 	std::vector<glm::vec3> ComputeFrustrumCorners() const;
 
+	Frustum ComputeFrustum() const { return Frustum::FromMatrix(m_projMatrix * m_viewMatrix); }
+
+	// Normalized direction of the ray from the eye through a pixel of the image
+	glm::vec3 ComputeRayDirection(glm::vec2 pixel) const
+	{
+		const glm::vec2 ndc = 2.0f * (pixel + 0.5f) / glm::vec2(m_imageWidth, m_imageHeight) - 1.0f;
+		const glm::vec4 farPoint = glm::inverse(m_projMatrix * m_viewMatrix) * glm::vec4(ndc, 1.0f, 1.0f);
+		return glm::normalize(glm::vec3(farPoint) / farPoint.w - m_eye);
+	}
+
 	void SetFieldOfView(float fov)
 	{
 		m_fieldOfView = fov;
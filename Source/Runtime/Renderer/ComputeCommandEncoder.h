@@ -0,0 +1,154 @@
+#pragma once
+
+#include <Renderer/Bindless.h>
+#include <RHI/ComputePipelineCache.h>
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/pointers>
+
+#include <array>
+
+// Records compute work outside of rendering, pipelines use the bindless layout
+class ComputeCommandEncoder
+{
+public:
+	ComputeCommandEncoder(
+		ComputePipelineCache& computePipelineCache,
+		const BindlessDescriptors& bindlessDescriptors,
+		const BindlessDrawParams& bindlessDrawParams
+	)
+		: m_computePipelineCache(&computePipelineCache)
+		, m_bindlessDescriptors(&bindlessDescriptors)
+		, m_bindlessDrawParams(&bindlessDrawParams)
+	{}
+
+	static uint32_t GetGroupCount(uint32_t threadCount, uint32_t groupSize)
+	{
+		return (threadCount + groupSize - 1) / groupSize;
+	}
+
+	vk::CommandBuffer GetCommandBuffer() const
+	{
+		assert(m_commandBuffer != nullptr);
+		return *m_commandBuffer;
+	}
+
+	uint32_t GetFrameIndex() const { return m_frameIndex; }
+
+	void BeginCompute(vk::CommandBuffer& commandBuffer, uint32_t frameIndex)
+	{
+		m_commandBuffer = &commandBuffer;
+		m_frameIndex = frameIndex;
+		m_pipelineID = kInvalidComputePipelineID;
+	}
+
+	void EndCompute()
+	{
+		m_commandBuffer = nullptr;
+	}
+
+	void BindPipeline(ComputePipelineID newPipelineID)
+	{
+		if (newPipelineID != m_pipelineID)
+		{
+			m_commandBuffer->bindPipeline(
+				vk::PipelineBindPoint::eCompute,
+				m_computePipelineCache->GetPipeline(newPipelineID)
+			);
+			m_pipelineID = newPipelineID;
+		}
+	}
+
+	// Binds the bindless descriptors along with the draw params, both are needed by every dispatch
+	void BindDrawParams(BindlessDrawParamsHandle handle)
+	{
+		std::array<vk::DescriptorSet, 2> descriptorSets = {
+			m_bindlessDescriptors->GetDescriptorSet(),
+			m_bindlessDrawParams->GetDescriptorSet(m_frameIndex)
+		};
+		const uint32_t offset = static_cast<uint32_t>(handle);
+		m_commandBuffer->bindDescriptorSets(
+			vk::PipelineBindPoint::eCompute,
+			m_bindlessDrawParams->GetPipelineLayout(),
+			static_cast<uint32_t>(BindlessDescriptorSet::eBindlessDescriptors),
+			static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(),
+			1, &offset);
+	}
+
+	void Dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1)
+	{
+		assert(m_pipelineID != kInvalidComputePipelineID);
+		if (groupCountX == 0 || groupCountY == 0 || groupCountZ == 0)
+			return;
+
+		m_commandBuffer->dispatch(groupCountX, groupCountY, groupCountZ);
+	}
+
+	// --- Barriers --- //
+
+	void GlobalBarrier(
+		vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+		vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask)
+	{
+		vk::MemoryBarrier2 memoryBarrier(srcStageMask, srcAccessMask, dstStageMask, dstAccessMask);
+
+		vk::DependencyInfo dependencyInfo;
+		dependencyInfo.memoryBarrierCount = 1;
+		dependencyInfo.pMemoryBarriers = &memoryBarrier;
+
+		m_commandBuffer->pipelineBarrier2(dependencyInfo);
+	}
+
+	void BufferBarrier(
+		vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size,
+		vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+		vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask)
+	{
+		vk::BufferMemoryBarrier2 bufferBarrier;
+		bufferBarrier.srcStageMask = srcStageMask;
+		bufferBarrier.srcAccessMask = srcAccessMask;
+		bufferBarrier.dstStageMask = dstStageMask;
+		bufferBarrier.dstAccessMask = dstAccessMask;
+		bufferBarrier.buffer = buffer;
+		bufferBarrier.offset = offset;
+		bufferBarrier.size = size;
+
+		vk::DependencyInfo dependencyInfo;
+		dependencyInfo.bufferMemoryBarrierCount = 1;
+		dependencyInfo.pBufferMemoryBarriers = &bufferBarrier;
+
+		m_commandBuffer->pipelineBarrier2(dependencyInfo);
+	}
+
+	void ImageBarrier(
+		vk::Image image, vk::ImageSubresourceRange subresourceRange,
+		vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+		vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+		vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask)
+	{
+		vk::ImageMemoryBarrier2 imageBarrier;
+		imageBarrier.srcStageMask = srcStageMask;
+		imageBarrier.srcAccessMask = srcAccessMask;
+		imageBarrier.dstStageMask = dstStageMask;
+		imageBarrier.dstAccessMask = dstAccessMask;
+		imageBarrier.oldLayout = oldLayout;
+		imageBarrier.newLayout = newLayout;
+		imageBarrier.image = image;
+		imageBarrier.setSubresourceRange(subresourceRange);
+
+		vk::DependencyInfo dependencyInfo;
+		dependencyInfo.imageMemoryBarrierCount = 1;
+		dependencyInfo.pImageMemoryBarriers = &imageBarrier;
+
+		m_commandBuffer->pipelineBarrier2(dependencyInfo);
+	}
+
+private:
+	gsl::not_null<ComputePipelineCache*> m_computePipelineCache;
+	gsl::not_null<const BindlessDescriptors*> m_bindlessDescriptors;
+	gsl::not_null<const BindlessDrawParams*> m_bindlessDrawParams;
+
+	uint32_t m_frameIndex = 0;
+	vk::CommandBuffer* m_commandBuffer = nullptr;
+	ComputePipelineID m_pipelineID = kInvalidComputePipelineID;
+};
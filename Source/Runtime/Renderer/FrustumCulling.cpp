@@ -0,0 +1,133 @@
+#include <Renderer/FrustumCulling.h>
+
+#include <Renderer/MeshAllocator.h>
+
+#include <cassert>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define FRUSTUM_CULLING_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	constexpr size_t kLaneCount = 4;
+
+	size_t AlignToLanes(size_t count)
+	{
+		return (count + kLaneCount - 1) & ~(kLaneCount - 1);
+	}
+}
+
+void FrustumCulling::SetBoundingBoxes(const std::vector<BoundingBox>& worldBoxes)
+{
+	m_boxCount = worldBoxes.size();
+	const size_t paddedCount = AlignToLanes(m_boxCount);
+
+	for (std::vector<float>* values : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+	{
+		values->assign(paddedCount, 0.0f);
+	}
+	m_isVisible.assign(paddedCount, 0);
+
+	for (size_t i = 0; i < m_boxCount; ++i)
+	{
+		SetBoundingBox(i, worldBoxes[i]);
+	}
+}
+
+void FrustumCulling::UpdateBoundingBoxes(const std::vector<BoundingBox>& worldBoxes, gsl::span<const uint32_t> sceneNodeIndices)
+{
+	assert(worldBoxes.size() == m_boxCount);
+	for (uint32_t i : sceneNodeIndices)
+	{
+		SetBoundingBox(i, worldBoxes[i]);
+	}
+}
+
+void FrustumCulling::SetBoundingBox(size_t index, const BoundingBox& box)
+{
+	if (!box.IsValid())
+		return; // nodes without geometry are never drawn
+
+	const glm::vec3 center = 0.5f * (box.min + box.max);
+	const glm::vec3 extent = 0.5f * (box.max - box.min);
+	m_centerX[index] = center.x;
+	m_centerY[index] = center.y;
+	m_centerZ[index] = center.z;
+	m_extentX[index] = extent.x;
+	m_extentY[index] = extent.y;
+	m_extentZ[index] = extent.z;
+}
+
+void FrustumCulling::ComputeVisibility(const Frustum& frustum)
+{
+	// A box is outside if it is fully behind any plane:
+	// dot(n, c) + d < -dot(|n|, e)
+#if FRUSTUM_CULLING_SSE
+	for (size_t i = 0; i < m_boxCount; i += kLaneCount)
+	{
+		const __m128 cx = _mm_loadu_ps(&m_centerX[i]);
+		const __m128 cy = _mm_loadu_ps(&m_centerY[i]);
+		const __m128 cz = _mm_loadu_ps(&m_centerZ[i]);
+		const __m128 ex = _mm_loadu_ps(&m_extentX[i]);
+		const __m128 ey = _mm_loadu_ps(&m_extentY[i]);
+		const __m128 ez = _mm_loadu_ps(&m_extentZ[i]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			const __m128 nx = _mm_set1_ps(plane.x);
+			const __m128 ny = _mm_set1_ps(plane.y);
+			const __m128 nz = _mm_set1_ps(plane.z);
+			const __m128 d = _mm_set1_ps(plane.w);
+			const __m128 ax = _mm_set1_ps(std::abs(plane.x));
+			const __m128 ay = _mm_set1_ps(std::abs(plane.y));
+			const __m128 az = _mm_set1_ps(std::abs(plane.z));
+
+			__m128 distance = _mm_add_ps(_mm_mul_ps(nx, cx), d);
+			distance = _mm_add_ps(distance, _mm_mul_ps(ny, cy));
+			distance = _mm_add_ps(distance, _mm_mul_ps(nz, cz));
+
+			__m128 radius = _mm_mul_ps(ax, ex);
+			radius = _mm_add_ps(radius, _mm_mul_ps(ay, ey));
+			radius = _mm_add_ps(radius, _mm_mul_ps(az, ez));
+
+			// distance + radius < 0
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+
+		const int outsideMask = _mm_movemask_ps(outside);
+		for (size_t lane = 0; lane < kLaneCount; ++lane)
+		{
+			m_isVisible[i + lane] = ((outsideMask >> lane) & 1) == 0;
+		}
+	}
+#else
+	for (size_t i = 0; i < m_boxCount; ++i)
+	{
+		bool isOutside = false;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			const float distance = plane.x * m_centerX[i] + plane.y * m_centerY[i] + plane.z * m_centerZ[i] + plane.w;
+			const float radius = std::abs(plane.x) * m_extentX[i] + std::abs(plane.y) * m_extentY[i] + std::abs(plane.z) * m_extentZ[i];
+			isOutside |= distance + radius < 0.0f;
+		}
+		m_isVisible[i] = !isOutside;
+	}
+#endif
+}
+
+void FrustumCulling::Cull(gsl::span<const MeshDrawInfo> drawCalls, std::vector<MeshDrawInfo>& visibleDrawCalls) const
+{
+	visibleDrawCalls.clear();
+	visibleDrawCalls.reserve(drawCalls.size());
+	for (const MeshDrawInfo& drawCall : drawCalls)
+	{
+		if (IsVisible(static_cast<size_t>(drawCall.sceneNodeID)))
+		{
+			visibleDrawCalls.push_back(drawCall);
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <BoundingBox.h>
+#include <Frustum.h>
+
+#include <gsl/span>
+#include <cstdint>
+#include <vector>
+
+struct MeshDrawInfo;
+
+// Tests world-space boxes of scene nodes against a view frustum.
+// Boxes are stored as structure of arrays (center/extent per axis) so that
+// 4 boxes are tested against a plane at once.
+class FrustumCulling
+{
+public:
+	// One box per scene node, indexed by SceneNodeHandle
+	void SetBoundingBoxes(const std::vector<BoundingBox>& worldBoxes);
+
+	// Only copies the boxes at sceneNodeIndices, worldBoxes must have as many boxes as the last call to SetBoundingBoxes()
+	void UpdateBoundingBoxes(const std::vector<BoundingBox>& worldBoxes, gsl::span<const uint32_t> sceneNodeIndices);
+
+	size_t GetBoxCount() const { return m_boxCount; }
+
+	void ComputeVisibility(const Frustum& frustum);
+
+	bool IsVisible(size_t sceneNodeIndex) const { return m_isVisible[sceneNodeIndex] != 0; }
+
+	// Writes the draws whose scene node is visible to visibleDrawCalls, keeping their order
+	void Cull(gsl::span<const MeshDrawInfo> drawCalls, std::vector<MeshDrawInfo>& visibleDrawCalls) const;
+
+private:
+	void SetBoundingBox(size_t index, const BoundingBox& box);
+
+	size_t m_boxCount = 0;
+
+	// Padded to a multiple of 4
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_extentX;
+	std::vector<float> m_extentY;
+	std::vector<float> m_extentZ;
+	std::vector<uint8_t> m_isVisible;
+};
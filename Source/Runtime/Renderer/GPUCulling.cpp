@@ -0,0 +1,493 @@
+#include <Renderer/GPUCulling.h>
+
+#include <Renderer/Bindless.h>
+#include <Renderer/ComputeCommandEncoder.h>
+#include <Renderer/FrustumCulling.h>
+#include <Renderer/IndirectDrawBuffer.h>
+#include <Renderer/MeshAllocator.h>
+#include <Renderer/Renderer.h>
+#include <Renderer/SceneTree.h>
+#include <RHI/CommandRingBuffer.h>
+#include <RHI/ComputePipelineCache.h>
+#include <RHI/ShaderCache.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	[[nodiscard]] std::unique_ptr<UniqueBuffer> CreateBuffer(size_t size, vk::BufferUsageFlags usage, VmaMemoryUsage memoryUsage)
+	{
+		vk::BufferCreateInfo bufferInfo({}, (std::max)(size, sizeof(uint32_t)), usage);
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = memoryUsage;
+		if (memoryUsage != VMA_MEMORY_USAGE_GPU_ONLY)
+			allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+		return std::make_unique<UniqueBuffer>(bufferInfo, allocInfo);
+	}
+
+	std::vector<uint32_t> ReadBackBuffer(const UniqueBuffer& buffer, size_t count)
+	{
+		buffer.Invalidate(0, count * sizeof(uint32_t));
+
+		std::vector<uint32_t> values(count);
+		memcpy(values.data(), buffer.GetMappedData(), count * sizeof(uint32_t));
+		return values;
+	}
+
+	template <class T>
+	[[nodiscard]] std::unique_ptr<UniqueBufferWithStaging> CreateStorageBufferWithData(CommandRingBuffer& commandRingBuffer, const std::vector<T>& data)
+	{
+		vk::CommandBuffer commandBuffer = commandRingBuffer.GetCommandBuffer();
+
+		const size_t bufferSize = (std::max)(data.size(), size_t{ 1 }) * sizeof(T);
+		auto buffer = std::make_unique<UniqueBufferWithStaging>(bufferSize, vk::BufferUsageFlagBits::eStorageBuffer);
+		memcpy(buffer->GetStagingMappedData(), reinterpret_cast<const void*>(data.data()), data.size() * sizeof(T));
+		buffer->CopyStagingToGPU(commandBuffer);
+		commandRingBuffer.DestroyAfterSubmit(buffer->ReleaseStagingBuffer());
+		return buffer;
+	}
+}
+
+const AssetPath GPUCulling::kCullingShader("/Engine/Generated/Shaders/visibility_culling_comp.spv");
+const AssetPath GPUCulling::kCompactionShader("/Engine/Generated/Shaders/visibility_compaction_comp.spv");
+const AssetPath GPUCulling::kClusterCullingShader("/Engine/Generated/Shaders/visibility_cluster_culling_comp.spv");
+
+GPUCulling::GPUCulling(Renderer& renderer, uint32_t drawCount, uint32_t cameraDrawCount, uint32_t shadowViewCount)
+	: m_renderer(&renderer)
+	, m_drawCount(drawCount)
+	, m_cameraDrawCount(cameraDrawCount)
+	, m_shadowViewCount(shadowViewCount)
+{
+	assert(cameraDrawCount <= drawCount);
+
+	gsl::not_null<BindlessDescriptors*> bindlessDescriptors = m_renderer->GetBindlessDescriptors();
+	m_drawParamsHandle = m_renderer->GetBindlessDrawParams()->DeclareParams<CullingDrawParams>();
+
+	// Each view has enough room for all its draws to be visible
+	const uint32_t instanceCount = cameraDrawCount + shadowViewCount * drawCount;
+	for (uint32_t i = 0; i < RHIConstants::kMaxFramesInFlight; ++i)
+	{
+		m_drawDataBuffers[i] = ::CreateBuffer(
+			instanceCount * sizeof(IndirectDrawData),
+			vk::BufferUsageFlagBits::eStorageBuffer,
+			VMA_MEMORY_USAGE_GPU_ONLY);
+
+		m_drawParams[i].drawData = bindlessDescriptors->StoreBuffer(m_drawDataBuffers[i]->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+		m_drawDataBufferHandles[i] = m_drawParams[i].drawData;
+	}
+}
+
+GPUCulling::~GPUCulling() = default;
+
+void GPUCulling::UploadToGPU(
+	CommandRingBuffer& commandRingBuffer,
+	const SceneTree& sceneTree,
+	gsl::span<const MeshDrawInfo> draws,
+	gsl::span<const uint32_t> cameraBatchIndices,
+	gsl::span<const Meshlet> meshlets)
+{
+	assert(draws.size() == m_drawCount);
+	assert(cameraBatchIndices.size() == m_cameraDrawCount);
+
+	gsl::not_null<BindlessDescriptors*> bindlessDescriptors = m_renderer->GetBindlessDescriptors();
+
+	CreateDrawGroups(draws, cameraBatchIndices);
+	const uint32_t groupCount = static_cast<uint32_t>(m_groups.size());
+	const std::vector<ClusterInput> clusters = CreateClusters(draws, meshlets);
+	m_clusterCount = static_cast<uint32_t>(clusters.size());
+
+	// Batches: one range of commands per camera batch, then one per index type of each shadow view.
+	// A batch emits at most one command per group, or one per meshlet of clustered groups.
+	m_cameraBatchCount = cameraBatchIndices.empty() ? 0 : cameraBatchIndices.back() + 1;
+	m_batchFirstCommands.assign(m_cameraBatchCount, 0);
+	m_batchSizes.assign(m_cameraBatchCount, 0);
+	for (uint32_t groupIndex = 0; groupIndex < m_cameraGroupCount; ++groupIndex)
+	{
+		const DrawGroup& group = m_groups[groupIndex];
+		m_batchSizes[group.batchIndex] += (std::max)(group.clusterCount, 1u);
+	}
+	uint32_t firstCommand = 0;
+	for (uint32_t batchIndex = 0; batchIndex < m_cameraBatchCount; ++batchIndex)
+	{
+		m_batchFirstCommands[batchIndex] = firstCommand;
+		firstCommand += m_batchSizes[batchIndex];
+	}
+	std::array<uint32_t, kIndexTypeCount> indexTypeGroupCounts = {};
+	for (const DrawGroup& group : m_groups)
+	{
+		indexTypeGroupCounts[group.indexTypeSlot]++;
+	}
+	for (uint32_t shadowIndex = 0; shadowIndex < m_shadowViewCount; ++shadowIndex)
+	{
+		for (uint32_t indexTypeGroupCount : indexTypeGroupCounts)
+		{
+			m_batchFirstCommands.push_back(firstCommand);
+			m_batchSizes.push_back(indexTypeGroupCount);
+			firstCommand += indexTypeGroupCount;
+		}
+	}
+	m_commandCount = firstCommand;
+
+	// Candidate draws
+	std::vector<DrawInput> inputs(draws.size());
+	for (uint32_t groupIndex = 0; groupIndex < groupCount; ++groupIndex)
+	{
+		const DrawGroup& group = m_groups[groupIndex];
+		const uint32_t lastDraw = groupIndex + 1 < groupCount ? m_groups[groupIndex + 1].firstDraw : m_drawCount;
+		for (uint32_t i = group.firstDraw; i < lastDraw; ++i)
+		{
+			inputs[i].sceneNodeIndex = static_cast<uint32_t>(draws[i].sceneNodeID);
+			inputs[i].materialIndex = draws[i].mesh.materialHandle.GetIndex();
+			inputs[i].groupIndex = groupIndex;
+		}
+	}
+	m_drawSceneNodeIndices.resize(draws.size());
+	for (size_t i = 0; i < draws.size(); ++i)
+	{
+		m_drawSceneNodeIndices[i] = inputs[i].sceneNodeIndex;
+	}
+
+	m_inputsBuffer = ::CreateStorageBufferWithData(commandRingBuffer, inputs);
+	m_groupsBuffer = ::CreateStorageBufferWithData(commandRingBuffer, m_groups);
+	m_clustersBuffer = ::CreateStorageBufferWithData(commandRingBuffer, clusters);
+	m_batchesBuffer = ::CreateStorageBufferWithData(commandRingBuffer, m_batchFirstCommands);
+
+	CullingDrawParams drawParams;
+	drawParams.inputs = bindlessDescriptors->StoreBuffer(m_inputsBuffer->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+	drawParams.groups = bindlessDescriptors->StoreBuffer(m_groupsBuffer->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+	drawParams.clusters = bindlessDescriptors->StoreBuffer(m_clustersBuffer->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+	drawParams.bounds = sceneTree.GetBoundsBufferHandle(); // local bounds, transformed in the shader
+	drawParams.batches = bindlessDescriptors->StoreBuffer(m_batchesBuffer->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+
+	// Views: each one has its own instance count and level of detail per group and its own range of draw data
+	m_views.resize(GetViewCount());
+	m_views[0].inputCount = m_cameraDrawCount;
+	m_views[0].groupCount = m_cameraGroupCount;
+	m_views[0].firstBatch = 0;
+	m_views[0].useGroupBatches = 1;
+	m_views[0].firstGroupSlot = 0;
+	m_views[0].firstInstance = 0;
+	m_views[0].clusterCount = m_clusterCount;
+	for (uint32_t shadowIndex = 0; shadowIndex < m_shadowViewCount; ++shadowIndex)
+	{
+		View& view = m_views[1 + shadowIndex];
+		view.inputCount = m_drawCount;
+		view.groupCount = groupCount;
+		view.firstBatch = m_cameraBatchCount + shadowIndex * kIndexTypeCount;
+		view.useGroupBatches = 0;
+		view.firstGroupSlot = m_cameraGroupCount + shadowIndex * groupCount;
+		view.firstInstance = m_cameraDrawCount + shadowIndex * m_drawCount;
+	}
+
+	const size_t instanceCountsSize = (m_cameraGroupCount + m_shadowViewCount * groupCount) * sizeof(uint32_t);
+	const size_t countsSize = m_batchSizes.size() * sizeof(uint32_t);
+	const vk::BufferUsageFlags readBackUsage = m_isReadBackEnabled ? vk::BufferUsageFlags(vk::BufferUsageFlagBits::eTransferSrc) : vk::BufferUsageFlags();
+	for (uint32_t i = 0; i < RHIConstants::kMaxFramesInFlight; ++i)
+	{
+		m_viewsBuffers[i] = ::CreateBuffer(m_views.size() * sizeof(View), vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		m_instanceCountsBuffers[i] = ::CreateBuffer(
+			instanceCountsSize,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | readBackUsage,
+			VMA_MEMORY_USAGE_GPU_ONLY);
+		m_lodLevelsBuffers[i] = ::CreateBuffer(
+			instanceCountsSize,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			VMA_MEMORY_USAGE_GPU_ONLY);
+		m_countsBuffers[i] = ::CreateBuffer(
+			countsSize,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst | readBackUsage,
+			VMA_MEMORY_USAGE_GPU_ONLY);
+		if (m_isReadBackEnabled)
+		{
+			m_instanceCountsReadBackBuffers[i] = ::CreateBuffer(instanceCountsSize, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU);
+			m_countsReadBackBuffers[i] = ::CreateBuffer(countsSize, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU);
+		}
+		m_commandsBuffers[i] = ::CreateBuffer(
+			m_commandCount * sizeof(vk::DrawIndexedIndirectCommand),
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+			VMA_MEMORY_USAGE_GPU_ONLY);
+
+		CullingDrawParams& frameDrawParams = m_drawParams[i];
+		frameDrawParams.inputs = drawParams.inputs;
+		frameDrawParams.groups = drawParams.groups;
+		frameDrawParams.clusters = drawParams.clusters;
+		frameDrawParams.bounds = drawParams.bounds;
+		frameDrawParams.batches = drawParams.batches;
+		frameDrawParams.transforms = sceneTree.GetTransformsBufferHandle(i);
+		frameDrawParams.views = bindlessDescriptors->StoreBuffer(m_viewsBuffers[i]->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+		frameDrawParams.instanceCounts = bindlessDescriptors->StoreBuffer(m_instanceCountsBuffers[i]->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+		frameDrawParams.lodLevels = bindlessDescriptors->StoreBuffer(m_lodLevelsBuffers[i]->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+		frameDrawParams.counts = bindlessDescriptors->StoreBuffer(m_countsBuffers[i]->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+		frameDrawParams.commands = bindlessDescriptors->StoreBuffer(m_commandsBuffers[i]->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+		m_renderer->GetBindlessDrawParams()->DefineParams(m_drawParamsHandle, frameDrawParams, i);
+	}
+
+	CreateComputePipelines();
+}
+
+void GPUCulling::CreateDrawGroups(gsl::span<const MeshDrawInfo> draws, gsl::span<const uint32_t> cameraBatchIndices)
+{
+	// A group is a run of draws of the same mesh, it doesn't cross the end of the
+	// camera draws nor a camera batch boundary so that it can be drawn as a whole.
+	// Camera draws culled per meshlet are alone in their group.
+	auto isClustered = [this, draws](uint32_t i) {
+		return i < m_cameraDrawCount && draws[i].mesh.meshletCount >= kMinClusterCount;
+	};
+	m_groups.clear();
+	m_cameraGroupCount = 0;
+	for (uint32_t i = 0; i < m_drawCount; ++i)
+	{
+		const Mesh& mesh = draws[i].mesh;
+		const uint32_t batchIndex = i < m_cameraDrawCount ? cameraBatchIndices[i] : 0;
+		const bool startsGroup = i == 0 || i == m_cameraDrawCount ||
+			isClustered(i) || isClustered(i - 1) ||
+			mesh.indexType != draws[i - 1].mesh.indexType ||
+			mesh.indexOffset != draws[i - 1].mesh.indexOffset ||
+			mesh.nbIndices != draws[i - 1].mesh.nbIndices ||
+			mesh.materialHandle != draws[i - 1].mesh.materialHandle ||
+			batchIndex != m_groups.back().batchIndex;
+		if (startsGroup)
+		{
+			if (i == m_cameraDrawCount)
+				m_cameraGroupCount = static_cast<uint32_t>(m_groups.size());
+
+			DrawGroup& group = m_groups.emplace_back();
+			group.lodCount = mesh.lodCount;
+			for (uint32_t level = 0; level <= mesh.lodCount; ++level)
+			{
+				const MeshLod lod = mesh.GetLod(level);
+				group.lods[level].firstIndex = static_cast<uint32_t>(lod.indexOffset);
+				group.lods[level].indexCount = static_cast<uint32_t>(lod.nbIndices);
+			}
+			group.firstDraw = i;
+			group.batchIndex = batchIndex;
+			group.vertexOffset = mesh.vertexOffset;
+			group.indexTypeSlot = GetIndexTypeSlot(mesh.indexType);
+			group.clusterCount = isClustered(i) ? mesh.meshletCount : 0;
+		}
+	}
+	if (m_cameraDrawCount == m_drawCount)
+		m_cameraGroupCount = static_cast<uint32_t>(m_groups.size());
+}
+
+std::vector<GPUCulling::ClusterInput> GPUCulling::CreateClusters(gsl::span<const MeshDrawInfo> draws, gsl::span<const Meshlet> meshlets)
+{
+	std::vector<ClusterInput> clusters;
+	for (uint32_t groupIndex = 0; groupIndex < m_cameraGroupCount; ++groupIndex)
+	{
+		DrawGroup& group = m_groups[groupIndex];
+		if (group.clusterCount == 0)
+			continue;
+
+		const Mesh& mesh = draws[group.firstDraw].mesh;
+		group.firstCluster = static_cast<uint32_t>(clusters.size());
+		for (const Meshlet& meshlet : meshlets.subspan(mesh.firstMeshlet, mesh.meshletCount))
+		{
+			ClusterInput& cluster = clusters.emplace_back();
+			cluster.sphere = glm::vec4(meshlet.center, meshlet.radius);
+			cluster.cone = glm::vec4(meshlet.coneAxis, meshlet.coneCutoff);
+			cluster.firstIndex = meshlet.firstIndex;
+			cluster.indexCount = meshlet.indexCount;
+			cluster.groupIndex = groupIndex;
+		}
+	}
+	return clusters;
+}
+
+void GPUCulling::CreateComputePipelines()
+{
+	gsl::not_null<ComputePipelineCache*> computePipelineCache = m_renderer->GetComputePipelineCache();
+	ShaderCache& shaderCache = computePipelineCache->GetShaderCache();
+
+	auto createPipeline = [&](const AssetPath& shaderPath) {
+		ShaderID shaderID = shaderCache.CreateShader(shaderPath.GetPathOnDisk());
+		ShaderInstanceID instanceID = shaderCache.CreateShaderInstance(shaderID);
+		return computePipelineCache->CreateComputePipeline(instanceID);
+	};
+	m_cullingPipelineID = createPipeline(kCullingShader);
+	m_compactionPipelineID = createPipeline(kCompactionShader);
+	m_clusterCullingPipelineID = createPipeline(kClusterCullingShader);
+}
+
+void GPUCulling::Update(
+	uint32_t frameIndex,
+	const Frustum& cameraFrustum,
+	const LodSelection& lodSelection,
+	gsl::span<const Frustum> shadowFrustums,
+	uint32_t shadowLodBias)
+{
+	assert(shadowFrustums.size() == m_shadowViewCount);
+
+	// Levels of detail of all views depend on the distance to the camera
+	for (View& view : m_views)
+	{
+		view.origin = lodSelection.cameraPosition;
+		view.lodDistanceScale = lodSelection.distanceScale;
+	}
+	m_views[0].planes = cameraFrustum.planes;
+	for (uint32_t shadowIndex = 0; shadowIndex < m_shadowViewCount; ++shadowIndex)
+	{
+		m_views[1 + shadowIndex].planes = shadowFrustums[shadowIndex].planes;
+		m_views[1 + shadowIndex].lodBias = shadowLodBias;
+	}
+
+	const size_t writeSize = m_views.size() * sizeof(View);
+	memcpy(m_viewsBuffers[frameIndex]->GetMappedData(), m_views.data(), writeSize);
+	m_viewsBuffers[frameIndex]->Flush(0, writeSize);
+}
+
+void GPUCulling::Dispatch(ComputeCommandEncoder& computeCommandEncoder) const
+{
+	if (m_drawCount == 0)
+		return;
+
+	const uint32_t frameIndex = computeCommandEncoder.GetFrameIndex();
+	vk::CommandBuffer commandBuffer = computeCommandEncoder.GetCommandBuffer();
+	vk::Buffer instanceCountsBuffer = m_instanceCountsBuffers[frameIndex]->Get();
+	vk::Buffer lodLevelsBuffer = m_lodLevelsBuffers[frameIndex]->Get();
+	vk::Buffer countsBuffer = m_countsBuffers[frameIndex]->Get();
+
+	// Reset instance and draw counts, the previous use of this frame's buffers is complete.
+	// Levels of detail are the minimum over visible instances.
+	commandBuffer.fillBuffer(instanceCountsBuffer, 0, VK_WHOLE_SIZE, 0);
+	commandBuffer.fillBuffer(lodLevelsBuffer, 0, VK_WHOLE_SIZE, ~0U);
+	commandBuffer.fillBuffer(countsBuffer, 0, VK_WHOLE_SIZE, 0);
+	computeCommandEncoder.GlobalBarrier(
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+	// Count visible instances of each group, select its level of detail and write their draw data, one row of groups per view
+	computeCommandEncoder.BindPipeline(m_cullingPipelineID);
+	computeCommandEncoder.BindDrawParams(m_drawParamsHandle);
+	computeCommandEncoder.Dispatch(ComputeCommandEncoder::GetGroupCount(m_drawCount, kGroupSize), GetViewCount());
+
+	computeCommandEncoder.GlobalBarrier(
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+	// Emit one instanced command per group with visible instances, using the selected level of detail
+	const uint32_t groupCount = static_cast<uint32_t>(m_groups.size());
+	computeCommandEncoder.BindPipeline(m_compactionPipelineID);
+	computeCommandEncoder.BindDrawParams(m_drawParamsHandle);
+	computeCommandEncoder.Dispatch(ComputeCommandEncoder::GetGroupCount(groupCount, kGroupSize), GetViewCount());
+
+	// Emit one command per visible meshlet of clustered groups instead, commands are
+	// only appended so both passes can run concurrently
+	if (m_clusterCount > 0)
+	{
+		computeCommandEncoder.BindPipeline(m_clusterCullingPipelineID);
+		computeCommandEncoder.BindDrawParams(m_drawParamsHandle);
+		computeCommandEncoder.Dispatch(ComputeCommandEncoder::GetGroupCount(m_clusterCount, kGroupSize), 1);
+	}
+
+	// Results are consumed by indirect draws and vertex shaders, and by the read back copies when enabled
+	vk::PipelineStageFlags2 dstStages = vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexShader;
+	vk::AccessFlags2 dstAccess = vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead;
+	if (m_isReadBackEnabled)
+	{
+		dstStages |= vk::PipelineStageFlagBits2::eTransfer;
+		dstAccess |= vk::AccessFlagBits2::eTransferRead;
+	}
+	computeCommandEncoder.GlobalBarrier(vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite, dstStages, dstAccess);
+
+	if (m_isReadBackEnabled)
+	{
+		// Buffers have at least one element, see CreateBuffer()
+		const vk::DeviceSize instanceCountsSize = (std::max)(m_cameraGroupCount + m_shadowViewCount * groupCount, 1u) * sizeof(uint32_t);
+		const vk::DeviceSize countsSize = (std::max)(m_batchSizes.size(), size_t{ 1 }) * sizeof(uint32_t);
+		commandBuffer.copyBuffer(instanceCountsBuffer, m_instanceCountsReadBackBuffers[frameIndex]->Get(), vk::BufferCopy(0, 0, instanceCountsSize));
+		commandBuffer.copyBuffer(countsBuffer, m_countsReadBackBuffers[frameIndex]->Get(), vk::BufferCopy(0, 0, countsSize));
+		computeCommandEncoder.GlobalBarrier(
+			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead);
+	}
+}
+
+IndirectCountDraw GPUCulling::GetShadowDraw(uint32_t frameIndex, uint32_t shadowIndex, vk::IndexType indexType) const
+{
+	return GetBatchDraw(frameIndex, m_cameraBatchCount + shadowIndex * kIndexTypeCount + GetIndexTypeSlot(indexType));
+}
+
+IndirectCountDraw GPUCulling::GetBatchDraw(uint32_t frameIndex, uint32_t batchIndex) const
+{
+	IndirectCountDraw draw;
+	draw.commandBuffer = m_commandsBuffers[frameIndex]->Get();
+	draw.commandOffset = m_batchFirstCommands[batchIndex] * sizeof(vk::DrawIndexedIndirectCommand);
+	draw.countBuffer = m_countsBuffers[frameIndex]->Get();
+	draw.countOffset = batchIndex * sizeof(uint32_t);
+	draw.maxDrawCount = m_batchSizes[batchIndex];
+	return draw;
+}
+
+std::vector<uint32_t> GPUCulling::GetDrawCounts(uint32_t frameIndex) const
+{
+	assert(m_isReadBackEnabled);
+	return ::ReadBackBuffer(*m_countsReadBackBuffers[frameIndex], m_batchSizes.size());
+}
+
+std::vector<uint32_t> GPUCulling::GetInstanceCounts(uint32_t frameIndex) const
+{
+	assert(m_isReadBackEnabled);
+	return ::ReadBackBuffer(*m_instanceCountsReadBackBuffers[frameIndex], m_cameraGroupCount + m_shadowViewCount * m_groups.size());
+}
+
+bool GPUCulling::ValidateReadBack(uint32_t frameIndex, gsl::span<const FrustumCulling> views) const
+{
+	assert(views.size() == GetViewCount());
+
+	if (m_drawCount == 0)
+		return true;
+
+	const std::vector<uint32_t> instanceCounts = GetInstanceCounts(frameIndex);
+	const std::vector<uint32_t> drawCounts = GetDrawCounts(frameIndex);
+
+	// Instance counts must match exactly. A visible group emits one command, or up to one per
+	// meshlet when drawn per meshlet since meshlets are also culled by their normal cone.
+	bool isValid = true;
+	std::vector<uint32_t> minDrawCounts(m_batchSizes.size(), 0);
+	std::vector<uint32_t> maxDrawCounts(m_batchSizes.size(), 0);
+	const uint32_t groupCount = static_cast<uint32_t>(m_groups.size());
+	for (uint32_t viewIndex = 0; viewIndex < GetViewCount(); ++viewIndex)
+	{
+		const View& view = m_views[viewIndex];
+		for (uint32_t groupIndex = 0; groupIndex < view.groupCount; ++groupIndex)
+		{
+			const DrawGroup& group = m_groups[groupIndex];
+			const uint32_t lastDraw = groupIndex + 1 < groupCount ? m_groups[groupIndex + 1].firstDraw : m_drawCount;
+			uint32_t expectedInstanceCount = 0;
+			for (uint32_t i = group.firstDraw; i < lastDraw; ++i)
+			{
+				if (views[viewIndex].IsVisible(m_drawSceneNodeIndices[i]))
+					expectedInstanceCount++;
+			}
+
+			const uint32_t instanceCount = instanceCounts[view.firstGroupSlot + groupIndex];
+			if (instanceCount != expectedInstanceCount)
+			{
+				std::cerr << "GPU culling: group " << groupIndex << " of view " << viewIndex << " has " << instanceCount
+					<< " visible instances instead of " << expectedInstanceCount << std::endl;
+				isValid = false;
+			}
+
+			if (expectedInstanceCount == 0)
+				continue;
+
+			const uint32_t batchIndex = view.firstBatch + (view.useGroupBatches != 0 ? group.batchIndex : group.indexTypeSlot);
+			const bool isClustered = view.clusterCount > 0 && group.clusterCount > 0;
+			minDrawCounts[batchIndex] += isClustered ? 0 : 1;
+			maxDrawCounts[batchIndex] += isClustered ? group.clusterCount : 1;
+		}
+	}
+
+	for (size_t batchIndex = 0; batchIndex < drawCounts.size(); ++batchIndex)
+	{
+		if (drawCounts[batchIndex] < minDrawCounts[batchIndex] || drawCounts[batchIndex] > maxDrawCounts[batchIndex])
+		{
+			std::cerr << "GPU culling: batch " << batchIndex << " has " << drawCounts[batchIndex] << " commands instead of "
+				<< minDrawCounts[batchIndex] << " to " << maxDrawCounts[batchIndex] << std::endl;
+			isValid = false;
+		}
+	}
+	return isValid;
+}
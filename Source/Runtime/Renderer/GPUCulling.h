@@ -0,0 +1,236 @@
+#pragma once
+
+#include <Renderer/BindlessDefines.h>
+#include <Renderer/MeshAllocator.h>
+#include <Frustum.h>
+#include <RHI/Buffers.h>
+#include <RHI/ComputePipelineCache.h>
+#include <RHI/constants.h>
+#include <AssetPath.h>
+#include <glm_includes.h>
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/pointers>
+#include <gsl/span>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class CommandRingBuffer;
+class ComputeCommandEncoder;
+class FrustumCulling;
+class Renderer;
+class SceneTree;
+
+// Arguments of a drawIndexedIndirectCount call
+struct IndirectCountDraw
+{
+	vk::Buffer commandBuffer;
+	vk::DeviceSize commandOffset = 0;
+	vk::Buffer countBuffer;
+	vk::DeviceSize countOffset = 0;
+	uint32_t maxDrawCount = 0;
+};
+
+// Tests draws against the camera and shadow view frustums in a compute shader.
+// Consecutive draws of the same mesh and material form a group, the visible
+// instances of a group are drawn with a single instanced command. Commands are
+// appended to per-batch ranges of an indirect command buffer, the number of
+// commands of each batch being written by the shader.
+//
+// The first draws are tested against the camera and split in batches
+// (e.g. one per graphics pipeline and index type), all draws are tested against
+// each shadow view, which has one batch per index type.
+//
+// Camera draws of meshes with enough meshlets are drawn per meshlet instead:
+// meshlets of a visible draw are tested against the frustum and their normal
+// cone, and each visible meshlet emits its own command.
+//
+// Each visible group is drawn with a level of detail picked from the distance of
+// its closest visible instance to the camera, shadow views can use coarser levels.
+class GPUCulling
+{
+public:
+	static const AssetPath kCullingShader;
+	static const AssetPath kCompactionShader;
+	static const AssetPath kClusterCullingShader;
+
+	// Below this number of meshlets, a mesh is culled and drawn as a whole
+	static constexpr uint32_t kMinClusterCount = 8;
+
+	GPUCulling(Renderer& renderer, uint32_t drawCount, uint32_t cameraDrawCount, uint32_t shadowViewCount);
+	~GPUCulling();
+
+	// One per frame in flight, the data of visible draws indexed with gl_InstanceIndex
+	gsl::span<const BufferHandle> GetDrawDataBufferHandles() const { return m_drawDataBufferHandles; }
+
+	// draws: all candidates, camera draws first, identical meshes must be contiguous to be instanced
+	// cameraBatchIndices: batch of each camera draw, batches must be contiguous and in increasing order,
+	// and draws of a batch must use the same index type
+	// meshlets: referenced by the meshes of the draws, see MeshAllocator::GetMeshlets()
+	void UploadToGPU(
+		CommandRingBuffer& commandRingBuffer,
+		const SceneTree& sceneTree,
+		gsl::span<const MeshDrawInfo> draws,
+		gsl::span<const uint32_t> cameraBatchIndices,
+		gsl::span<const Meshlet> meshlets);
+
+	// lodSelection: camera position and scale, also used for the normal cone test of meshlets
+	// shadowLodBias: number of levels of detail coarser than the camera's used by shadow views
+	void Update(
+		uint32_t frameIndex,
+		const Frustum& cameraFrustum,
+		const LodSelection& lodSelection,
+		gsl::span<const Frustum> shadowFrustums,
+		uint32_t shadowLodBias);
+
+	// Must be recorded outside of rendering, before the draws that use the results
+	void Dispatch(ComputeCommandEncoder& computeCommandEncoder) const;
+
+	uint32_t GetCameraBatchCount() const { return m_cameraBatchCount; }
+
+	IndirectCountDraw GetCameraDraw(uint32_t frameIndex, uint32_t batchIndex) const { return GetBatchDraw(frameIndex, batchIndex); }
+
+	// Draws using the index buffer of indexType
+	IndirectCountDraw GetShadowDraw(uint32_t frameIndex, uint32_t shadowIndex, vk::IndexType indexType) const;
+
+	// Must be called before UploadToGPU(), each dispatch then copies its counts to host visible memory
+	void EnableReadBack() { m_isReadBackEnabled = true; }
+
+	// Command count of each batch (camera batches then shadow view batches) written by the
+	// last dispatch for this frame index. Only valid once that frame completed.
+	std::vector<uint32_t> GetDrawCounts(uint32_t frameIndex) const;
+
+	// Visible instance count of each group of each view (camera groups then the groups of each shadow view)
+	std::vector<uint32_t> GetInstanceCounts(uint32_t frameIndex) const;
+
+	// Compares the counts read back for this frame index with the visibility of scene nodes computed
+	// on the CPU, one FrustumCulling per view with the frustums of the last Update(), camera first.
+	// Mismatches are written to std::cerr.
+	bool ValidateReadBack(uint32_t frameIndex, gsl::span<const FrustumCulling> views) const;
+
+private:
+	// Matches DrawInput in visibility_culling.glsl
+	struct DrawInput
+	{
+		uint32_t sceneNodeIndex = 0;
+		uint32_t materialIndex = 0;
+		uint32_t groupIndex = 0;
+		uint32_t padding = 0;
+	};
+
+	// Matches MeshLod in visibility_culling.glsl
+	struct GroupLod
+	{
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+	};
+
+	// Matches DrawGroup in visibility_culling.glsl
+	struct DrawGroup
+	{
+		std::array<GroupLod, kMaxMeshLodCount> lods;
+		uint32_t lodCount = 0; // coarser levels
+		uint32_t firstDraw = 0;
+		uint32_t batchIndex = 0;
+		uint32_t firstCluster = 0;
+		uint32_t clusterCount = 0; // 0 if the group is not drawn per meshlet
+		int32_t vertexOffset = 0;
+		uint32_t indexTypeSlot = 0; // batch of the group in shadow views
+		uint32_t padding = 0;
+	};
+
+	// Matches ClusterInput in visibility_culling.glsl, a meshlet of a clustered group
+	struct ClusterInput
+	{
+		glm::vec4 sphere; // local center, radius
+		glm::vec4 cone; // local axis, cutoff
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		uint32_t groupIndex = 0;
+		uint32_t padding = 0;
+	};
+
+	// Matches CullingView in visibility_culling.glsl
+	struct View
+	{
+		std::array<glm::vec4, Frustum::Plane::eCount> planes;
+		uint32_t inputCount = 0;
+		uint32_t groupCount = 0;
+		uint32_t firstBatch = 0;
+		uint32_t useGroupBatches = 0; // 0: groups go to firstBatch + their index type slot
+		uint32_t firstGroupSlot = 0;
+		uint32_t firstInstance = 0;
+		uint32_t clusterCount = 0; // 0 to draw clustered groups as a whole
+		uint32_t lodBias = 0;
+		glm::vec3 origin; // camera position
+		float lodDistanceScale = 0.0f;
+	};
+
+	struct CullingDrawParams
+	{
+		BufferHandle inputs = BufferHandle::Invalid;
+		BufferHandle groups = BufferHandle::Invalid;
+		BufferHandle clusters = BufferHandle::Invalid;
+		BufferHandle bounds = BufferHandle::Invalid;
+		BufferHandle transforms = BufferHandle::Invalid;
+		BufferHandle views = BufferHandle::Invalid;
+		BufferHandle batches = BufferHandle::Invalid;
+		BufferHandle instanceCounts = BufferHandle::Invalid;
+		BufferHandle lodLevels = BufferHandle::Invalid;
+		BufferHandle counts = BufferHandle::Invalid;
+		BufferHandle commands = BufferHandle::Invalid;
+		BufferHandle drawData = BufferHandle::Invalid;
+	};
+
+	static constexpr uint32_t kGroupSize = 64; // local_size_x
+	static constexpr uint32_t kIndexTypeCount = 2; // 32-bit then 16-bit
+
+	static uint32_t GetIndexTypeSlot(vk::IndexType indexType) { return indexType == vk::IndexType::eUint16 ? 1 : 0; }
+
+	IndirectCountDraw GetBatchDraw(uint32_t frameIndex, uint32_t batchIndex) const;
+	void CreateDrawGroups(gsl::span<const MeshDrawInfo> draws, gsl::span<const uint32_t> cameraBatchIndices);
+	std::vector<ClusterInput> CreateClusters(gsl::span<const MeshDrawInfo> draws, gsl::span<const Meshlet> meshlets);
+	void CreateComputePipelines();
+	uint32_t GetViewCount() const { return 1 + m_shadowViewCount; }
+
+	gsl::not_null<Renderer*> m_renderer;
+	uint32_t m_drawCount = 0;
+	uint32_t m_cameraDrawCount = 0;
+	uint32_t m_shadowViewCount = 0;
+	uint32_t m_cameraBatchCount = 0;
+	uint32_t m_cameraGroupCount = 0;
+	uint32_t m_commandCount = 0; // upper bound, one per group and view or one per meshlet
+	uint32_t m_clusterCount = 0;
+	bool m_isReadBackEnabled = false;
+	std::vector<uint32_t> m_drawSceneNodeIndices;
+	std::vector<DrawGroup> m_groups;
+	std::vector<uint32_t> m_batchFirstCommands;
+	std::vector<uint32_t> m_batchSizes;
+	std::vector<View> m_views;
+
+	ComputePipelineID m_cullingPipelineID = kInvalidComputePipelineID;
+	ComputePipelineID m_compactionPipelineID = kInvalidComputePipelineID;
+	ComputePipelineID m_clusterCullingPipelineID = kInvalidComputePipelineID;
+
+	BindlessDrawParamsHandle m_drawParamsHandle = BindlessDrawParamsHandle::Invalid;
+
+	// GPU resources
+	std::unique_ptr<UniqueBufferWithStaging> m_inputsBuffer;
+	std::unique_ptr<UniqueBufferWithStaging> m_groupsBuffer;
+	std::unique_ptr<UniqueBufferWithStaging> m_clustersBuffer;
+	std::unique_ptr<UniqueBufferWithStaging> m_batchesBuffer;
+	template <class T>
+	using PerFrame = std::array<T, RHIConstants::kMaxFramesInFlight>;
+	PerFrame<std::unique_ptr<UniqueBuffer>> m_viewsBuffers;
+	PerFrame<std::unique_ptr<UniqueBuffer>> m_instanceCountsBuffers;
+	PerFrame<std::unique_ptr<UniqueBuffer>> m_lodLevelsBuffers;
+	PerFrame<std::unique_ptr<UniqueBuffer>> m_countsBuffers;
+	PerFrame<std::unique_ptr<UniqueBuffer>> m_countsReadBackBuffers;
+	PerFrame<std::unique_ptr<UniqueBuffer>> m_instanceCountsReadBackBuffers;
+	PerFrame<std::unique_ptr<UniqueBuffer>> m_commandsBuffers;
+	PerFrame<std::unique_ptr<UniqueBuffer>> m_drawDataBuffers;
+	PerFrame<BufferHandle> m_drawDataBufferHandles;
+	PerFrame<CullingDrawParams> m_drawParams;
+};
@@ -0,0 +1,117 @@
+#include <Renderer/GeometryHeap.h>
+
+#include <RHI/CommandRingBuffer.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+GeometryHeap::GeometryHeap(vk::BufferUsageFlags usage, std::vector<uint32_t> streamElementSizes, vk::DeviceSize reserveSize)
+	: m_usage(usage)
+	, m_streamElementSizes(std::move(streamElementSizes))
+	, m_reserveSize(reserveSize)
+	, m_pendingCopies(m_streamElementSizes.size())
+{
+}
+
+uint32_t GeometryHeap::GetElementSize() const
+{
+	return std::accumulate(m_streamElementSizes.begin(), m_streamElementSizes.end(), 0u);
+}
+
+uint32_t GeometryHeap::Allocate(uint32_t count)
+{
+	assert(count > 0);
+	uint32_t offset = m_allocator.Allocate(count);
+	if (offset == OffsetAllocator::kInvalidOffset && m_buffers.empty())
+	{
+		// The buffers don't exist yet, make room at the end
+		const uint32_t size = m_allocator.GetSize();
+		if (count > (std::numeric_limits<uint32_t>::max)() - size)
+			throw std::runtime_error("Geometry heap is too large");
+
+		m_allocator.Grow(size + count);
+		offset = m_allocator.Allocate(count);
+	}
+
+	if (offset == OffsetAllocator::kInvalidOffset)
+		throw std::runtime_error("Geometry heap is full");
+
+	return offset;
+}
+
+void GeometryHeap::Free(uint32_t offset)
+{
+	const uint32_t count = m_allocator.GetAllocationSize(offset);
+	m_allocator.Free(offset);
+
+	// The range can be allocated again, don't overwrite it with writes that weren't uploaded yet
+	for (size_t stream = 0; stream < m_streamElementSizes.size(); ++stream)
+	{
+		const vk::DeviceSize first = vk::DeviceSize{ offset } * m_streamElementSizes[stream];
+		const vk::DeviceSize last = first + vk::DeviceSize{ count } * m_streamElementSizes[stream];
+		std::erase_if(m_pendingCopies[stream], [first, last](const vk::BufferCopy& copy) {
+			return copy.dstOffset >= first && copy.dstOffset < last;
+		});
+	}
+}
+
+gsl::span<std::byte> GeometryHeap::Write(uint32_t stream, uint32_t offset, uint32_t count)
+{
+	assert(offset + count <= m_allocator.GetSize());
+
+	const uint32_t elementSize = m_streamElementSizes[stream];
+	const size_t srcOffset = m_pendingData.size();
+	const size_t size = size_t{ count } * elementSize;
+	m_pendingData.resize(srcOffset + size);
+	m_pendingCopies[stream].push_back(vk::BufferCopy(srcOffset, vk::DeviceSize{ offset } * elementSize, size));
+	return gsl::span<std::byte>(m_pendingData.data() + srcOffset, size);
+}
+
+void GeometryHeap::Upload(CommandRingBuffer& commandRingBuffer)
+{
+	if (m_buffers.empty())
+	{
+		// Empty buffers are not allowed
+		const vk::DeviceSize reserveCount = m_reserveSize / GetElementSize();
+		const vk::DeviceSize size = (std::max)(vk::DeviceSize{ m_allocator.GetSize() } + reserveCount, vk::DeviceSize{ 1 });
+		m_allocator.Grow(static_cast<uint32_t>((std::min)(size, vk::DeviceSize{ (std::numeric_limits<uint32_t>::max)() })));
+
+		for (uint32_t elementSize : m_streamElementSizes)
+		{
+			vk::BufferCreateInfo bufferInfo({}, vk::DeviceSize{ m_allocator.GetSize() } * elementSize, m_usage | vk::BufferUsageFlagBits::eTransferDst);
+			m_buffers.push_back(std::make_unique<UniqueBuffer>(bufferInfo, VmaAllocationCreateInfo{ {}, VMA_MEMORY_USAGE_GPU_ONLY }));
+		}
+	}
+
+	if (m_pendingData.empty())
+		return;
+
+	auto* stagingBuffer = new UniqueBuffer(
+		vk::BufferCreateInfo({}, m_pendingData.size(), vk::BufferUsageFlagBits::eTransferSrc),
+		VmaAllocationCreateInfo{ VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU });
+	memcpy(stagingBuffer->GetMappedData(), m_pendingData.data(), m_pendingData.size());
+
+	vk::CommandBuffer commandBuffer = commandRingBuffer.GetCommandBuffer();
+	for (size_t stream = 0; stream < m_buffers.size(); ++stream)
+	{
+		if (!m_pendingCopies[stream].empty())
+			commandBuffer.copyBuffer(stagingBuffer->Get(), m_buffers[stream]->Get(), m_pendingCopies[stream]);
+		m_pendingCopies[stream].clear();
+	}
+	commandRingBuffer.DestroyAfterSubmit(stagingBuffer);
+	m_pendingData.clear();
+
+	// Geometry can be added while rendering, make the copies visible to the following draws
+	vk::MemoryBarrier2 memoryBarrier(
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eIndexInput,
+		vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eIndexRead);
+	vk::DependencyInfo dependencyInfo;
+	dependencyInfo.memoryBarrierCount = 1;
+	dependencyInfo.pMemoryBarriers = &memoryBarrier;
+	commandBuffer.pipelineBarrier2(dependencyInfo);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <RHI/Buffers.h>
+#include <OffsetAllocator.h>
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/span>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class CommandRingBuffer;
+
+// Device local buffers of same-size elements (vertices or indices) sub-allocated in ranges, so that
+// geometry can be added and freed without rebuilding the buffers. There is one buffer per stream
+// (e.g. positions and other vertex attributes), all streams use the same ranges. Writes are kept on
+// the CPU until Upload() copies them through a staging buffer. Buffers are created by the first
+// upload, large enough for what was allocated so far plus reserveSize bytes, then their size is fixed.
+class GeometryHeap
+{
+public:
+	GeometryHeap(vk::BufferUsageFlags usage, std::vector<uint32_t> streamElementSizes, vk::DeviceSize reserveSize);
+
+	// Returns the offset of the first element of the range, in elements, throws if the buffers are full
+	uint32_t Allocate(uint32_t count);
+
+	// The GPU must not be using the range anymore, e.g. after waiting for the frames in flight
+	void Free(uint32_t offset);
+
+	// Returns where to write count elements of a stream at offset in an allocated range, copied by the next Upload().
+	// The memory is only valid until the next write.
+	gsl::span<std::byte> Write(uint32_t stream, uint32_t offset, uint32_t count);
+
+	// Creates the buffers if needed and records copies for the writes since the last call
+	void Upload(CommandRingBuffer& commandRingBuffer);
+
+	vk::Buffer Get(uint32_t stream = 0) const { return m_buffers[stream]->Get(); }
+	uint32_t GetElementSize(uint32_t stream) const { return m_streamElementSizes[stream]; }
+	uint32_t GetElementSize() const; // of all streams
+
+	// Sizes are in elements
+	OffsetAllocator::Stats GetStats() const { return m_allocator.GetStats(); }
+
+private:
+	vk::BufferUsageFlags m_usage;
+	std::vector<uint32_t> m_streamElementSizes;
+	vk::DeviceSize m_reserveSize = 0;
+	OffsetAllocator m_allocator;
+	std::vector<std::unique_ptr<UniqueBuffer>> m_buffers; // [stream]
+
+	std::vector<std::byte> m_pendingData;
+	std::vector<std::vector<vk::BufferCopy>> m_pendingCopies; // [stream], from m_pendingData to the buffer, in bytes
+};
@@ -0,0 +1,70 @@
+#include <Renderer/IndirectDrawBuffer.h>
+
+#include <Renderer/Bindless.h>
+#include <Renderer/MeshAllocator.h>
+
+#include <algorithm>
+
+namespace
+{
+	[[nodiscard]] std::unique_ptr<UniqueBuffer> CreateMappedBuffer(size_t size, vk::BufferUsageFlags usage)
+	{
+		vk::BufferCreateInfo bufferInfo({}, size, usage);
+		VmaAllocationCreateInfo allocInfo{ VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU };
+		return std::make_unique<UniqueBuffer>(bufferInfo, allocInfo);
+	}
+}
+
+IndirectDrawBuffer::IndirectDrawBuffer(BindlessDescriptors& bindlessDescriptors, uint32_t maxDrawCount)
+	: m_maxDrawCount(maxDrawCount)
+{
+	// Empty buffers are not allowed
+	const size_t bufferDrawCount = (std::max)(maxDrawCount, 1U);
+
+	for (uint32_t i = 0; i < RHIConstants::kMaxFramesInFlight; ++i)
+	{
+		m_commandBuffers[i] = ::CreateMappedBuffer(bufferDrawCount * sizeof(vk::DrawIndexedIndirectCommand), vk::BufferUsageFlagBits::eIndirectBuffer);
+		m_drawDataBuffers[i] = ::CreateMappedBuffer(bufferDrawCount * sizeof(IndirectDrawData), vk::BufferUsageFlagBits::eStorageBuffer);
+		m_drawDataBufferHandles[i] = bindlessDescriptors.StoreBuffer(m_drawDataBuffers[i]->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+	}
+}
+
+void IndirectDrawBuffer::Reset(uint32_t frameIndex)
+{
+	m_frameIndex = frameIndex;
+	m_drawCount = 0;
+}
+
+IndirectDrawRange IndirectDrawBuffer::AddDraws(gsl::span<const MeshDrawInfo> drawCalls)
+{
+	assert(m_drawCount + drawCalls.size() <= m_maxDrawCount);
+
+	IndirectDrawRange range;
+	range.firstDraw = m_drawCount;
+	range.drawCount = static_cast<uint32_t>(drawCalls.size());
+	if (range.drawCount == 0)
+		return range;
+
+	auto* commands = reinterpret_cast<vk::DrawIndexedIndirectCommand*>(m_commandBuffers[m_frameIndex]->GetMappedData()) + range.firstDraw;
+	auto* drawData = reinterpret_cast<IndirectDrawData*>(m_drawDataBuffers[m_frameIndex]->GetMappedData()) + range.firstDraw;
+	for (uint32_t i = 0; i < range.drawCount; ++i)
+	{
+		const MeshDrawInfo& drawCall = drawCalls[i];
+		const uint32_t drawIndex = range.firstDraw + i;
+		commands[i] = vk::DrawIndexedIndirectCommand(
+			drawCall.mesh.nbIndices, // indexCount
+			1, // instanceCount
+			drawCall.mesh.indexOffset, // firstIndex
+			drawCall.mesh.vertexOffset, // vertexOffset
+			drawIndex // firstInstance
+		);
+		drawData[i].sceneNodeIndex = static_cast<uint32_t>(drawCall.sceneNodeID);
+		drawData[i].materialIndex = drawCall.mesh.materialHandle.GetIndex();
+	}
+
+	m_commandBuffers[m_frameIndex]->Flush(range.firstDraw * sizeof(vk::DrawIndexedIndirectCommand), range.drawCount * sizeof(vk::DrawIndexedIndirectCommand));
+	m_drawDataBuffers[m_frameIndex]->Flush(range.firstDraw * sizeof(IndirectDrawData), range.drawCount * sizeof(IndirectDrawData));
+
+	m_drawCount += range.drawCount;
+	return range;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Renderer/BindlessDefines.h>
+#include <RHI/Buffers.h>
+#include <RHI/GraphicsPipelineCache.h>
+#include <RHI/constants.h>
+
+#include <vulkan/vulkan.hpp>
+#include <gsl/pointers>
+#include <gsl/span>
+#include <array>
+#include <cstdint>
+#include <memory>
+
+class BindlessDescriptors;
+struct MeshDrawInfo;
+
+// Matches DrawData in draw_data.glsl
+struct IndirectDrawData
+{
+	uint32_t sceneNodeIndex = 0;
+	uint32_t materialIndex = 0;
+};
+
+struct IndirectDrawRange
+{
+	uint32_t firstDraw = 0;
+	uint32_t drawCount = 0;
+};
+
+// State shared by consecutive indirect draws
+struct IndirectDrawBatch
+{
+	GraphicsPipelineID pipelineID = kInvalidGraphicsPipelineID;
+	vk::IndexType indexType = vk::IndexType::eUint32;
+};
+
+// Per frame in flight buffers of VkDrawIndexedIndirectCommand and matching per-draw data.
+// Each command's firstInstance is its draw index so that shaders
+// can fetch their draw data with gl_InstanceIndex.
+class IndirectDrawBuffer
+{
+public:
+	IndirectDrawBuffer(BindlessDescriptors& bindlessDescriptors, uint32_t maxDrawCount);
+
+	// Starts writing draws for a frame, previous draws of this frame are discarded
+	void Reset(uint32_t frameIndex);
+
+	// Appends draws after the ones already written for the current frame
+	IndirectDrawRange AddDraws(gsl::span<const MeshDrawInfo> drawCalls);
+
+	uint32_t GetMaxDrawCount() const { return m_maxDrawCount; }
+
+	vk::Buffer GetIndirectBuffer(uint32_t frameIndex) const { return m_commandBuffers[frameIndex]->Get(); }
+
+	// One per frame in flight
+	gsl::span<const BufferHandle> GetDrawDataBufferHandles() const { return m_drawDataBufferHandles; }
+
+	static constexpr uint32_t kCommandStride = sizeof(vk::DrawIndexedIndirectCommand);
+
+private:
+	std::array<std::unique_ptr<UniqueBuffer>, RHIConstants::kMaxFramesInFlight> m_commandBuffers;
+	std::array<std::unique_ptr<UniqueBuffer>, RHIConstants::kMaxFramesInFlight> m_drawDataBuffers;
+	std::array<BufferHandle, RHIConstants::kMaxFramesInFlight> m_drawDataBufferHandles;
+	uint32_t m_maxDrawCount = 0;
+	uint32_t m_frameIndex = 0;
+	uint32_t m_drawCount = 0;
+};
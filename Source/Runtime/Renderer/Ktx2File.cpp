@@ -0,0 +1,358 @@
+#include <Renderer/Ktx2File.h>
+
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+	constexpr std::array<uint8_t, 12> kIdentifier = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	constexpr uint32_t kSupercompressionNone = 0;
+	constexpr uint32_t kSupercompressionZstd = 2;
+
+	// Follows the identifier
+	struct Header
+	{
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+
+		// Index
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		// followed by the supercompression global data offset and length (uint64_t), not used
+	};
+	static_assert(sizeof(Header) == 52);
+
+	constexpr std::streamoff kLevelIndexOffset = 80;
+
+	uint64_t GetBlockCount(uint32_t size) { return (std::max)((size + 3) / 4, 1u); }
+
+	// Basic data format descriptor of a block-compressed format (Khronos Data Format Specification 1.3), for other tools
+	std::vector<uint32_t> BuildDataFormatDescriptor(vk::Format format, uint32_t blockSize)
+	{
+		struct Sample
+		{
+			uint32_t channel;
+			uint32_t bitOffset;
+			uint32_t bitLength;
+		};
+
+		uint32_t colorModel = 0;
+		std::vector<Sample> samples;
+		switch (format)
+		{
+		case vk::Format::eBc1RgbUnormBlock:
+		case vk::Format::eBc1RgbSrgbBlock:
+			colorModel = 128;
+			samples = { { 0, 0, 64 } };
+			break;
+		case vk::Format::eBc1RgbaUnormBlock:
+		case vk::Format::eBc1RgbaSrgbBlock:
+			colorModel = 128;
+			samples = { { 1, 0, 64 } }; // alpha present
+			break;
+		case vk::Format::eBc3UnormBlock:
+		case vk::Format::eBc3SrgbBlock:
+			colorModel = 130;
+			samples = { { 15, 0, 64 }, { 0, 64, 64 } }; // alpha, color
+			break;
+		case vk::Format::eBc4UnormBlock:
+		case vk::Format::eBc4SnormBlock:
+			colorModel = 131;
+			samples = { { 0, 0, 64 } };
+			break;
+		case vk::Format::eBc5UnormBlock:
+		case vk::Format::eBc5SnormBlock:
+			colorModel = 132;
+			samples = { { 0, 0, 64 }, { 1, 64, 64 } }; // red, green
+			break;
+		case vk::Format::eBc6HUfloatBlock:
+		case vk::Format::eBc6HSfloatBlock:
+			colorModel = 133;
+			samples = { { 0, 0, 128 } };
+			break;
+		default:
+			colorModel = 134; // BC7
+			samples = { { 0, 0, 128 } };
+			break;
+		}
+
+		const bool isSrgb =
+			format == vk::Format::eBc1RgbSrgbBlock ||
+			format == vk::Format::eBc1RgbaSrgbBlock ||
+			format == vk::Format::eBc3SrgbBlock ||
+			format == vk::Format::eBc7SrgbBlock;
+		const uint32_t transferFunction = isSrgb ? 2 : 1;
+		const uint32_t primaries = 1; // BT.709
+
+		const uint32_t blockByteSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+		std::vector<uint32_t> words = {
+			4 + blockByteSize, // total size
+			0, // vendor and descriptor type: Khronos basic
+			2 | (blockByteSize << 16), // version and block size
+			colorModel | (primaries << 8) | (transferFunction << 16),
+			3 | (3 << 8), // 4x4 texels
+			blockSize, // bytes in plane 0
+			0,
+		};
+		for (const Sample& sample : samples)
+		{
+			words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+			words.push_back(0); // position
+			words.push_back(0); // lower
+			words.push_back(0xFFFFFFFF); // upper
+		}
+		return words;
+	}
+}
+
+Ktx2File::Ktx2File(std::filesystem::path path)
+	: m_path(std::move(path))
+{
+	std::ifstream file(m_path, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open '" + m_path.string() + "'");
+
+	std::array<uint8_t, kIdentifier.size()> identifier = {};
+	Header header = {};
+	file.read(reinterpret_cast<char*>(identifier.data()), identifier.size());
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || identifier != kIdentifier)
+		throw std::runtime_error("'" + m_path.string() + "' is not a KTX2 file");
+
+	m_format = static_cast<vk::Format>(header.vkFormat);
+	m_width = header.pixelWidth;
+	m_height = header.pixelHeight;
+	m_supercompressionScheme = header.supercompressionScheme;
+
+	const uint32_t blockSize = GetBlockSize(m_format);
+	if (blockSize == 0)
+		throw std::runtime_error("'" + m_path.string() + "' is not block-compressed with a supported format");
+	if (m_width == 0 || m_height == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+		throw std::runtime_error("'" + m_path.string() + "' is not a 2D texture");
+	if (m_supercompressionScheme != kSupercompressionNone && m_supercompressionScheme != kSupercompressionZstd)
+		throw std::runtime_error("'" + m_path.string() + "' uses an unsupported supercompression scheme");
+#ifndef HAS_ZSTD
+	if (m_supercompressionScheme == kSupercompressionZstd)
+		throw std::runtime_error("'" + m_path.string() + "' is supercompressed with zstd, which is not available in this build");
+#endif
+
+	// A level count of 0 asks to generate mip levels, which block-compressed formats can't do
+	if (header.levelCount > static_cast<uint32_t>(std::bit_width((std::max)(m_width, m_height))))
+		throw std::runtime_error("'" + m_path.string() + "' has more mip levels than its size allows");
+	m_levels.resize((std::max)(header.levelCount, 1u));
+	file.seekg(kLevelIndexOffset);
+	file.read(reinterpret_cast<char*>(m_levels.data()), m_levels.size() * sizeof(Level));
+	if (!file)
+		throw std::runtime_error("failed to read the levels of '" + m_path.string() + "'");
+
+	// Levels are read by worker threads, which can't recover from reading past the end of the file
+	const uint64_t fileSize = std::filesystem::file_size(m_path);
+	for (uint32_t level = 0; level < m_levels.size(); ++level)
+	{
+		if (m_levels[level].byteOffset > fileSize || m_levels[level].byteLength > fileSize - m_levels[level].byteOffset)
+			throw std::runtime_error("'" + m_path.string() + "' has a mip level past the end of the file");
+
+		const uint64_t size = GetBlockCount(m_width >> level) * GetBlockCount(m_height >> level) * blockSize;
+		const bool isSizeValid = m_levels[level].uncompressedByteLength == size &&
+			(m_supercompressionScheme != kSupercompressionNone || m_levels[level].byteLength == size);
+		if (!isSizeValid)
+			throw std::runtime_error("'" + m_path.string() + "' has a mip level of unexpected size");
+	}
+}
+
+bool Ktx2File::ReadLevels(void* dst, gsl::span<const vk::DeviceSize> dstOffsets, uint32_t firstLevel) const
+{
+	assert(firstLevel + dstOffsets.size() <= m_levels.size());
+
+	std::ifstream file(m_path, std::ios::binary);
+	std::vector<char> compressedData;
+	for (uint32_t level = firstLevel; level < firstLevel + dstOffsets.size(); ++level)
+	{
+		const Level& levelInfo = m_levels[level];
+		char* levelData = static_cast<char*>(dst) + dstOffsets[level - firstLevel];
+		file.seekg(levelInfo.byteOffset);
+		if (m_supercompressionScheme == kSupercompressionNone)
+		{
+			file.read(levelData, levelInfo.byteLength);
+			if (!file)
+			{
+				std::cerr << "could not read '" << m_path.string() << "'" << std::endl;
+				return false;
+			}
+			continue;
+		}
+
+#ifdef HAS_ZSTD
+		compressedData.resize(levelInfo.byteLength);
+		file.read(compressedData.data(), compressedData.size());
+		if (!file)
+		{
+			std::cerr << "could not read '" << m_path.string() << "'" << std::endl;
+			return false;
+		}
+
+		size_t result = ZSTD_decompress(levelData, levelInfo.uncompressedByteLength, compressedData.data(), compressedData.size());
+		if (ZSTD_isError(result) || result != levelInfo.uncompressedByteLength)
+		{
+			std::cerr << "could not decompress '" << m_path.string() << "'" << std::endl;
+			return false;
+		}
+#else
+		return false; // rejected by the constructor
+#endif
+	}
+	return true;
+}
+
+bool Ktx2File::ReadBlocks(uint32_t level, int32_t blockX, int32_t blockY, uint32_t blockCountX, uint32_t blockCountY, void* dst) const
+{
+	assert(m_supercompressionScheme == kSupercompressionNone);
+
+	const uint32_t blockSize = GetBlockSize(m_format);
+	const int64_t levelBlockCountX = static_cast<int64_t>(GetBlockCount(m_width >> level));
+	const int64_t levelBlockCountY = static_cast<int64_t>(GetBlockCount(m_height >> level));
+	auto wrap = [](int64_t value, int64_t count) { return ((value % count) + count) % count; };
+
+	// Each row is read in at most a few spans, split where it wraps around
+	std::ifstream file(m_path, std::ios::binary);
+	char* dstRow = static_cast<char*>(dst);
+	for (uint32_t y = 0; y < blockCountY; ++y)
+	{
+		const int64_t rowOffset = wrap(blockY + static_cast<int64_t>(y), levelBlockCountY) * levelBlockCountX;
+		uint32_t x = 0;
+		while (x < blockCountX)
+		{
+			const int64_t srcX = wrap(blockX + static_cast<int64_t>(x), levelBlockCountX);
+			const uint32_t spanCount = static_cast<uint32_t>((std::min)(static_cast<int64_t>(blockCountX - x), levelBlockCountX - srcX));
+			file.seekg(static_cast<std::streamoff>(m_levels[level].byteOffset + (rowOffset + srcX) * blockSize));
+			file.read(dstRow + static_cast<size_t>(x) * blockSize, static_cast<std::streamsize>(spanCount) * blockSize);
+			x += spanCount;
+		}
+		dstRow += static_cast<size_t>(blockCountX) * blockSize;
+	}
+
+	if (!file)
+	{
+		std::cerr << "could not read '" << m_path.string() << "'" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Ktx2File::Write(const std::filesystem::path& path, vk::Format format, uint32_t width, uint32_t height,
+	gsl::span<const std::byte> data, gsl::span<const vk::DeviceSize> levelOffsets)
+{
+	const uint32_t blockSize = GetBlockSize(format);
+	assert(blockSize != 0 && !levelOffsets.empty());
+
+	const std::vector<uint32_t> dataFormatDescriptor = BuildDataFormatDescriptor(format, blockSize);
+	const uint64_t levelIndexSize = levelOffsets.size() * sizeof(Level);
+	const uint32_t dfdByteOffset = static_cast<uint32_t>(kLevelIndexOffset + levelIndexSize);
+	const uint32_t dfdByteLength = static_cast<uint32_t>(dataFormatDescriptor.size() * sizeof(uint32_t));
+
+	Header header = {};
+	header.vkFormat = static_cast<uint32_t>(format);
+	header.typeSize = 1;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.faceCount = 1;
+	header.levelCount = static_cast<uint32_t>(levelOffsets.size());
+	header.supercompressionScheme = kSupercompressionNone;
+	header.dfdByteOffset = dfdByteOffset;
+	header.dfdByteLength = dfdByteLength;
+
+	// Levels are stored from the smallest, each aligned to the block size
+	std::vector<Level> levels(levelOffsets.size());
+	uint64_t fileOffset = dfdByteOffset + dfdByteLength;
+	for (size_t level = levels.size(); level-- > 0;)
+	{
+		const uint64_t size = (level + 1 < levelOffsets.size() ? levelOffsets[level + 1] : data.size()) - levelOffsets[level];
+		fileOffset = (fileOffset + blockSize - 1) / blockSize * blockSize;
+		levels[level] = { fileOffset, size, size };
+		fileOffset += size;
+	}
+
+	// Sources with the same content are written to the same path, possibly by several threads at once
+	static std::atomic<uint32_t> tempFileCounter = 0;
+	std::filesystem::path tempPath = path;
+	tempPath += std::format(".{}.tmp", tempFileCounter.fetch_add(1));
+	std::error_code error;
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		const uint64_t supercompressionGlobalData[2] = {};
+		file.write(reinterpret_cast<const char*>(kIdentifier.data()), kIdentifier.size());
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(supercompressionGlobalData), sizeof(supercompressionGlobalData));
+		file.write(reinterpret_cast<const char*>(levels.data()), levelIndexSize);
+		file.write(reinterpret_cast<const char*>(dataFormatDescriptor.data()), dfdByteLength);
+		for (size_t level = levels.size(); level-- > 0;)
+		{
+			const std::streamoff padding = static_cast<std::streamoff>(levels[level].byteOffset) - file.tellp();
+			const char zeros[16] = {};
+			file.write(zeros, padding);
+			file.write(reinterpret_cast<const char*>(data.data() + levelOffsets[level]), levels[level].byteLength);
+		}
+		if (!file.good())
+		{
+			file.close();
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (!error)
+		return true;
+
+	std::filesystem::remove(tempPath, error);
+	return false;
+}
+
+uint32_t Ktx2File::GetBlockSize(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eBc1RgbUnormBlock:
+	case vk::Format::eBc1RgbSrgbBlock:
+	case vk::Format::eBc1RgbaUnormBlock:
+	case vk::Format::eBc1RgbaSrgbBlock:
+	case vk::Format::eBc4UnormBlock:
+	case vk::Format::eBc4SnormBlock:
+		return 8;
+	case vk::Format::eBc3UnormBlock:
+	case vk::Format::eBc3SrgbBlock:
+	case vk::Format::eBc5UnormBlock:
+	case vk::Format::eBc5SnormBlock:
+	case vk::Format::eBc6HUfloatBlock:
+	case vk::Format::eBc6HSfloatBlock:
+	case vk::Format::eBc7UnormBlock:
+	case vk::Format::eBc7SrgbBlock:
+		return 16;
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <gsl/span>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// 2D texture in a KTX2 container with block-compressed mip levels (BC1, BC3, BC4, BC5, BC6H or BC7),
+// uncompressed or supercompressed with zstd. See https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+class Ktx2File
+{
+public:
+	// Reads the header and the level index, throws if the texture is not supported
+	explicit Ktx2File(std::filesystem::path path);
+
+	vk::Format GetFormat() const { return m_format; }
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	uint32_t GetLevelCount() const { return static_cast<uint32_t>(m_levels.size()); }
+	bool IsSupercompressed() const { return m_supercompressionScheme != 0; }
+
+	// Size of the mip level once decompressed, in bytes
+	vk::DeviceSize GetLevelSize(uint32_t level) const { return m_levels[level].uncompressedByteLength; }
+
+	// Reads and decompresses the mip levels from firstLevel to dst, level firstLevel + i at dstOffsets[i].
+	// Returns false if the file can't be read anymore or decompression fails.
+	bool ReadLevels(void* dst, gsl::span<const vk::DeviceSize> dstOffsets, uint32_t firstLevel = 0) const;
+
+	// Reads blockCountX x blockCountY blocks of a mip level starting at blockX, blockY to dst, one row after the other.
+	// Blocks outside of the level wrap around like the repeat address mode. The file must not be supercompressed.
+	bool ReadBlocks(uint32_t level, int32_t blockX, int32_t blockY, uint32_t blockCountX, uint32_t blockCountY, void* dst) const;
+
+	// Bytes per 4x4 block, 0 for formats that are not supported
+	static uint32_t GetBlockSize(vk::Format format);
+
+	// Writes a file without supercompression, data holds the mip levels from the largest, level i at levelOffsets[i].
+	// The file is written next to path under a unique name then renamed, so that readers never see a partial file
+	// and concurrent writers of the same path don't interleave. Returns false on failure.
+	static bool Write(const std::filesystem::path& path, vk::Format format, uint32_t width, uint32_t height,
+		gsl::span<const std::byte> data, gsl::span<const vk::DeviceSize> levelOffsets);
+
+private:
+	struct Level
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	std::filesystem::path m_path;
+	vk::Format m_format = vk::Format::eUndefined;
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	uint32_t m_supercompressionScheme = 0;
+	std::vector<Level> m_levels; // from the largest
+};
@@ -1,6 +1,8 @@
 #include <Renderer/MaterialSystem.h>
 
 #include <Renderer/Bindless.h>
+#include <Renderer/GPUCulling.h>
+#include <Renderer/IndirectDrawBuffer.h>
 #include <Renderer/LightSystem.h>
 #include <Renderer/RenderCommandEncoder.h>
 #include <Renderer/SceneTree.h>
@@ -17,6 +19,7 @@ MaterialSystem::MaterialSystem(
 	GraphicsPipelineCache& graphicsPipelineCache,
 	BindlessDescriptors& bindlessDescriptors,
 	BindlessDrawParams& bindlessDrawParams,
+	const MeshAllocator& meshAllocator,
 	SceneTree& sceneTree,
 	LightSystem& lightSystem,
 	ShadowSystem& shadowSystem
@@ -25,12 +28,14 @@ MaterialSystem::MaterialSystem(
 	, m_graphicsPipelineCache(&graphicsPipelineCache)
 	, m_bindlessDescriptors(&bindlessDescriptors)
 	, m_bindlessDrawParams(&bindlessDrawParams)
+	, m_meshAllocator(&meshAllocator)
 	, m_sceneTree(&sceneTree)
 	, m_lightSystem(&lightSystem)
 	, m_shadowSystem(&shadowSystem)
 	, m_nextHandle(MaterialShadingDomain::Surface, MaterialShadingModel::Lit, 0)
 {
 	m_drawParamsHandle = m_bindlessDrawParams->DeclareParams<MaterialDrawParams>();
+	m_culledDrawParamsHandle = m_bindlessDrawParams->DeclareParams<MaterialDrawParams>();
 }
 
 void MaterialSystem::Reset(const Swapchain& swapchain)
@@ -65,39 +70,117 @@ void MaterialSystem::SetViewBufferHandles(gsl::span<const BufferHandle> viewBuff
 	std::copy(viewBufferHandles.begin(), viewBufferHandles.end(), std::back_inserter(m_viewBufferHandles));
 }
 
+void MaterialSystem::SetDrawDataBufferHandles(gsl::span<const BufferHandle> drawDataBufferHandles)
+{
+	m_drawDataBufferHandles.clear();
+	m_drawDataBufferHandles.reserve(drawDataBufferHandles.size());
+	std::copy(drawDataBufferHandles.begin(), drawDataBufferHandles.end(), std::back_inserter(m_drawDataBufferHandles));
+}
+
+void MaterialSystem::SetCulledDrawDataBufferHandles(gsl::span<const BufferHandle> drawDataBufferHandles)
+{
+	m_culledDrawDataBufferHandles.clear();
+	m_culledDrawDataBufferHandles.reserve(drawDataBufferHandles.size());
+	std::copy(drawDataBufferHandles.begin(), drawDataBufferHandles.end(), std::back_inserter(m_culledDrawDataBufferHandles));
+}
+
+void MaterialSystem::SetVirtualTextureBufferHandles(BufferHandle virtualTextureBufferHandle, gsl::span<const BufferHandle> textureFeedbackBufferHandles)
+{
+	m_drawParams.virtualTextures = virtualTextureBufferHandle;
+	m_textureFeedbackBufferHandles.assign(textureFeedbackBufferHandles.begin(), textureFeedbackBufferHandles.end());
+}
+
 void MaterialSystem::UploadToGPU(CommandRingBuffer& commandRingBuffer)
 {
 	CreatePendingInstances();
 	CreateAndUploadStorageBuffer(commandRingBuffer);
 
 	assert(!m_viewBufferHandles.empty());
+	assert(m_drawDataBufferHandles.size() == m_viewBufferHandles.size());
+	assert(m_culledDrawDataBufferHandles.size() == m_viewBufferHandles.size());
 	MaterialDrawParams drawParams = m_drawParams;
 	drawParams.lights = m_lightSystem->GetLightsBufferHandle();
 	drawParams.lightCount = m_lightSystem->GetLightCount();
 	drawParams.materials = m_uniformBufferHandle;
-	drawParams.transforms = m_sceneTree->GetTransformsBufferHandle();
+	drawParams.nodeBounds = m_sceneTree->GetBoundsBufferHandle();
+	drawParams.positions = m_meshAllocator->GetPositionsBufferHandle();
+	drawParams.attributes = m_meshAllocator->GetAttributesBufferHandle();
 	drawParams.shadowTransforms = m_shadowSystem->GetMaterialShadowsBufferHandle();
 
 	for (uint32_t i = 0; i < m_viewBufferHandles.size(); ++i)
 	{
 		drawParams.view = m_viewBufferHandles[i];
+		drawParams.transforms = m_sceneTree->GetTransformsBufferHandle(i);
+		drawParams.drawData = m_drawDataBufferHandles[i];
+		if (!m_textureFeedbackBufferHandles.empty())
+			drawParams.textureFeedback = m_textureFeedbackBufferHandles[i];
 		m_bindlessDrawParams->DefineParams(m_drawParamsHandle, drawParams, i);
+		drawParams.drawData = m_culledDrawDataBufferHandles[i];
+		m_bindlessDrawParams->DefineParams(m_culledDrawParamsHandle, drawParams, i);
 	}
 }
 
-void MaterialSystem::Draw(RenderCommandEncoder& renderCommandEncoder, gsl::span<const MeshDrawInfo> drawCalls) const
+void MaterialSystem::Draw(
+	RenderCommandEncoder& renderCommandEncoder,
+	gsl::span<const MeshDrawInfo> drawCalls,
+	const IndirectDrawBuffer& indirectDrawBuffer,
+	IndirectDrawRange drawRange) const
 {
-	vk::CommandBuffer commandBuffer = renderCommandEncoder.GetCommandBuffer();
+	assert(drawCalls.size() == drawRange.drawCount);
 
 	renderCommandEncoder.BindDrawParams(m_drawParamsHandle);
 
-	for (const auto& drawItem : drawCalls)
+	// Scene node and material indices are fetched from the draw data buffer,
+	// only pipeline and index buffer changes split the draws.
+	vk::CommandBuffer commandBuffer = renderCommandEncoder.GetCommandBuffer();
+	vk::IndexType boundIndexType = vk::IndexType::eUint32; // bound by RenderScene::RenderBasePassMeshes()
+	uint32_t batchStart = 0;
+	for (uint32_t i = 1; i <= drawRange.drawCount; ++i)
+	{
+		const Mesh& batchMesh = drawCalls[batchStart].mesh;
+		const GraphicsPipelineID pipelineID = GetGraphicsPipelineID(batchMesh.materialHandle);
+		if (i < drawRange.drawCount &&
+			GetGraphicsPipelineID(drawCalls[i].mesh.materialHandle) == pipelineID &&
+			drawCalls[i].mesh.indexType == batchMesh.indexType)
+			continue;
+
+		if (batchMesh.indexType != boundIndexType)
+		{
+			m_meshAllocator->BindIndices(commandBuffer, batchMesh.indexType);
+			boundIndexType = batchMesh.indexType;
+		}
+		renderCommandEncoder.BindPipeline(pipelineID);
+		renderCommandEncoder.DrawIndexedIndirect(indirectDrawBuffer, drawRange.firstDraw + batchStart, i - batchStart);
+		batchStart = i;
+	}
+	if (boundIndexType != vk::IndexType::eUint32)
+		m_meshAllocator->BindIndices(commandBuffer, vk::IndexType::eUint32);
+}
+
+void MaterialSystem::DrawCulled(
+	RenderCommandEncoder& renderCommandEncoder,
+	const GPUCulling& gpuCulling,
+	gsl::span<const IndirectDrawBatch> batches) const
+{
+	assert(batches.size() == gpuCulling.GetCameraBatchCount());
+
+	renderCommandEncoder.BindDrawParams(m_culledDrawParamsHandle);
+
+	vk::CommandBuffer commandBuffer = renderCommandEncoder.GetCommandBuffer();
+	vk::IndexType boundIndexType = vk::IndexType::eUint32; // bound by RenderScene::RenderBasePassMeshes()
+	for (uint32_t batchIndex = 0; batchIndex < gpuCulling.GetCameraBatchCount(); ++batchIndex)
 	{
-		renderCommandEncoder.BindPipeline(GetGraphicsPipelineID(drawItem.mesh.materialHandle));
-		renderCommandEncoder.BindSceneNode(drawItem.sceneNodeID);
-		renderCommandEncoder.BindMaterial(drawItem.mesh.materialHandle);
-		commandBuffer.drawIndexed(drawItem.mesh.nbIndices, 1, drawItem.mesh.indexOffset, 0, 0);
+		const IndirectDrawBatch& batch = batches[batchIndex];
+		if (batch.indexType != boundIndexType)
+		{
+			m_meshAllocator->BindIndices(commandBuffer, batch.indexType);
+			boundIndexType = batch.indexType;
+		}
+		renderCommandEncoder.BindPipeline(batch.pipelineID);
+		renderCommandEncoder.DrawIndexedIndirectCount(gpuCulling.GetCameraDraw(renderCommandEncoder.GetFrameIndex(), batchIndex));
 	}
+	if (boundIndexType != vk::IndexType::eUint32)
+		m_meshAllocator->BindIndices(commandBuffer, vk::IndexType::eUint32);
 }
 
 void MaterialSystem::CreatePendingInstances()
@@ -125,7 +208,7 @@ GraphicsPipelineID MaterialSystem::LoadGraphicsPipeline(const MaterialInstanceIn
 	ShaderID vertexShaderID = shaderCache.CreateShader(kVertexShader.GetPathOnDisk());
 	ShaderID fragmentShaderID = shaderCache.CreateShader(kFragmentShader.GetPathOnDisk());
 
-	ShaderInstanceID vertexInstanceID = shaderCache.CreateShaderInstance(vertexShaderID);
+	ShaderInstanceID vertexInstanceID = m_meshAllocator->CreateVertexShaderInstance(shaderCache, vertexShaderID);
 	ShaderInstanceID fragmentInstanceID = shaderCache.CreateShaderInstance(fragmentShaderID);
 
 	uint32_t pipelineIndex = m_graphicsPipelineIDs.size();
@@ -23,6 +23,10 @@ class BindlessDescriptors;
 class SceneTree;
 class ShadowSystem;
 class RenderCommandEncoder;
+class IndirectDrawBuffer;
+struct IndirectDrawRange;
+struct IndirectDrawBatch;
+class GPUCulling;
 class LightSystem;
 class Swapchain;
 
@@ -84,6 +88,7 @@ public:
 		GraphicsPipelineCache& graphicsPipelineCache,
 		BindlessDescriptors& bindlessDescriptors,
 		BindlessDrawParams& bindlessDrawParams,
+		const MeshAllocator& meshAllocator,
 		SceneTree& sceneTree,
 		LightSystem& lightSystem,
 		ShadowSystem& shadowSystem
@@ -93,10 +98,32 @@ public:
 
 	void Reset(const Swapchain& swapchain);
 	
-	void Draw(RenderCommandEncoder& renderCommandEncoder, gsl::span<const MeshDrawInfo> drawCalls) const;
+	// drawCalls must have been written to indirectDrawBuffer at drawRange for the current frame.
+	// Issues one indirect draw per run of draws sharing a graphics pipeline and an index buffer.
+	void Draw(
+		RenderCommandEncoder& renderCommandEncoder,
+		gsl::span<const MeshDrawInfo> drawCalls,
+		const IndirectDrawBuffer& indirectDrawBuffer,
+		IndirectDrawRange drawRange) const;
+
+	// Draws the camera batches culled on the GPU, batches are in the order of the GPU culling camera batches
+	void DrawCulled(
+		RenderCommandEncoder& renderCommandEncoder,
+		const GPUCulling& gpuCulling,
+		gsl::span<const IndirectDrawBatch> batches) const;
 
 	void SetViewBufferHandles(gsl::span<const BufferHandle> viewBufferHandles);
 
+	// One per frame in flight
+	void SetDrawDataBufferHandles(gsl::span<const BufferHandle> drawDataBufferHandles);
+	void SetCulledDrawDataBufferHandles(gsl::span<const BufferHandle> drawDataBufferHandles);
+
+	// Page table and feedback buffers (one per frame in flight) of virtual textures, see TextureCache::EnableVirtualTexturing()
+	void SetVirtualTextureBufferHandles(BufferHandle virtualTextureBufferHandle, gsl::span<const BufferHandle> textureFeedbackBufferHandles);
+
+	// Descriptor slot of each texture handle, see TextureCache::GetTextureSlotsBufferHandle()
+	void SetTextureSlotsBufferHandle(BufferHandle textureSlotsBufferHandle) { m_drawParams.textureSlots = textureSlotsBufferHandle; }
+
 	// Reserve a material ID for a given set of material properties
 	// The graphics pipeline and GPU resources will not be created until UploadToGPU is called
 	MaterialHandle CreateMaterialInstance(const MaterialInstanceInfo& materialInfo);
@@ -109,6 +136,8 @@ public:
 
 	size_t GetMaterialInstanceCount() const { return m_properties.size(); }
 
+	const MaterialProperties& GetMaterialProperties(MaterialHandle materialHandle) const { return m_properties[materialHandle.GetIndex()]; }
+
 	const GraphicsPipelineCache& GetGraphicsPipelineSystem() const { return *m_graphicsPipelineCache; }
 
 	const std::vector<GraphicsPipelineID>& GetGraphicsPipelinesIDs() const { return m_graphicsPipelineIDs; }
@@ -130,11 +159,21 @@ private:
 		uint32_t lightCount = 0;
 		BufferHandle materials = BufferHandle::Invalid;
 		BufferHandle shadowTransforms = BufferHandle::Invalid;
-		uint32_t padding[2] = { 0, 0 };
+		BufferHandle drawData = BufferHandle::Invalid;
+		BufferHandle nodeBounds = BufferHandle::Invalid;
+		BufferHandle positions = BufferHandle::Invalid;
+		BufferHandle attributes = BufferHandle::Invalid;
+		BufferHandle virtualTextures = BufferHandle::Invalid;
+		BufferHandle textureFeedback = BufferHandle::Invalid;
+		BufferHandle textureSlots = BufferHandle::Invalid;
 	};
 	MaterialDrawParams m_drawParams;
 	BindlessDrawParamsHandle m_drawParamsHandle;
+	BindlessDrawParamsHandle m_culledDrawParamsHandle; // same params with GPU culling draw data
 	std::vector<BufferHandle> m_viewBufferHandles;
+	std::vector<BufferHandle> m_drawDataBufferHandles;
+	std::vector<BufferHandle> m_culledDrawDataBufferHandles;
+	std::vector<BufferHandle> m_textureFeedbackBufferHandles;
 
 	GraphicsPipelineID LoadGraphicsPipeline(const MaterialInstanceInfo& materialInfo);
 
@@ -143,6 +182,7 @@ private:
 
 	gsl::not_null<const Swapchain*> m_swapchain;
 	gsl::not_null<GraphicsPipelineCache*> m_graphicsPipelineCache;
+	gsl::not_null<const MeshAllocator*> m_meshAllocator;
 	gsl::not_null<SceneTree*> m_sceneTree;
 	gsl::not_null<LightSystem*> m_lightSystem;
 	gsl::not_null<ShadowSystem*> m_shadowSystem;
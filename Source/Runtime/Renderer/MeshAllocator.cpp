@@ -1,43 +1,222 @@
 #include <Renderer/MeshAllocator.h>
 
+#include <Renderer/Bindless.h>
 #include <RHI/CommandRingBuffer.h>
 
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	// Maps a unit vector to the [-1, 1] square (octahedron unfolded on the z = 0 plane)
+	glm::vec2 EncodeOctahedral(glm::vec3 normal)
+	{
+		normal /= (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+		glm::vec2 encoded(normal.x, normal.y);
+		if (normal.z < 0.0f)
+		{
+			encoded = (1.0f - glm::abs(glm::vec2(normal.y, normal.x))) *
+				glm::vec2(normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return encoded;
+	}
+
+	int16_t PackSnorm16(float value)
+	{
+		return static_cast<int16_t>(glm::packSnorm1x16(value));
+	}
+
+	template <class T>
+	gsl::span<T> WriteElements(GeometryHeap& heap, uint32_t stream, uint32_t offset, size_t count)
+	{
+		assert(heap.GetElementSize(stream) == sizeof(T));
+		gsl::span<std::byte> bytes = heap.Write(stream, offset, static_cast<uint32_t>(count));
+		return gsl::span<T>(reinterpret_cast<T*>(bytes.data()), count);
+	}
+}
+
+LodSelection LodSelection::FromCamera(const glm::vec3& cameraPosition, float fieldOfViewDegrees)
+{
+	return LodSelection{ cameraPosition, kScreenSize * std::tan(glm::radians(fieldOfViewDegrees) * 0.5f) };
+}
+
+uint32_t LodSelection::SelectLevel(const glm::vec3& center, float radius, uint32_t lodCount) const
+{
+	const float distance = glm::distance(center, cameraPosition);
+	if (distance <= radius)
+		return 0;
+
+	const float level = std::floor(std::log2(distance * distanceScale / radius));
+	return static_cast<uint32_t>(std::clamp(level, 0.0f, static_cast<float>(lodCount)));
+}
+
+MeshAllocator::MeshAllocator(BindlessDescriptors& bindlessDescriptors)
+	: m_vertexHeap(CreateVertexHeap(VertexFormat::eFloat))
+	, m_indexHeap(vk::BufferUsageFlagBits::eIndexBuffer, { sizeof(uint32_t) }, kIndexReserveSize)
+	, m_indexHeap16(vk::BufferUsageFlagBits::eIndexBuffer, { sizeof(uint16_t) }, kIndexReserveSize / 2)
+	, m_bindlessDescriptors(&bindlessDescriptors)
+{
+}
+
+GeometryHeap MeshAllocator::CreateVertexHeap(VertexFormat vertexFormat)
+{
+	// Matches the streams read by vertex_format.glsl, as arrays of uint
+	static_assert(sizeof(glm::vec3) == 3 * sizeof(uint32_t) && sizeof(VertexAttributes) == 5 * sizeof(uint32_t));
+	static_assert(sizeof(QuantizedPosition) == 2 * sizeof(uint32_t) && sizeof(QuantizedAttributes) == 2 * sizeof(uint32_t));
+	std::vector<uint32_t> streamElementSizes = vertexFormat == VertexFormat::eQuantized ?
+		std::vector<uint32_t>{ sizeof(QuantizedPosition), sizeof(QuantizedAttributes) } :
+		std::vector<uint32_t>{ sizeof(glm::vec3), sizeof(VertexAttributes) };
+	return GeometryHeap(vk::BufferUsageFlagBits::eStorageBuffer, std::move(streamElementSizes), kVertexReserveSize);
+}
+
+void MeshAllocator::SetVertexFormat(VertexFormat vertexFormat)
+{
+	assert(m_vertexHeap.GetStats().usedSize == 0);
+	m_vertexFormat = vertexFormat;
+	m_vertexHeap = CreateVertexHeap(vertexFormat);
+}
+
+ShaderInstanceID MeshAllocator::CreateVertexShaderInstance(ShaderCache& shaderCache, ShaderID vertexShaderID) const
+{
+	SmallVector<vk::SpecializationMapEntry> entries = {
+		vk::SpecializationMapEntry(0, 0, sizeof(VertexFormat)) // constant_id, offset, size
+	};
+	return shaderCache.CreateShaderInstance(vertexShaderID, &m_vertexFormat, entries);
+}
+
 void MeshAllocator::GroupMeshes(SceneNodeHandle sceneNodeHandle, const std::vector<Mesh>& meshes)
 {
 	m_meshEntries.push_back(std::make_pair(sceneNodeHandle, Entry::AppendToOutput(meshes, m_meshes)));
 }
 
-void MeshAllocator::UploadToGPU(CommandRingBuffer& commandRingBuffer)
+uint32_t MeshAllocator::AddVertices(gsl::span<const Vertex> vertices)
+{
+	assert(m_vertexFormat == VertexFormat::eFloat);
+	const uint32_t firstVertex = m_vertexHeap.Allocate(static_cast<uint32_t>(vertices.size()));
+	gsl::span<glm::vec3> positions = ::WriteElements<glm::vec3>(m_vertexHeap, kPositionStream, firstVertex, vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		positions[i] = vertices[i].pos;
+	}
+
+	gsl::span<VertexAttributes> attributes = ::WriteElements<VertexAttributes>(m_vertexHeap, kAttributeStream, firstVertex, vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		attributes[i] = VertexAttributes{ vertices[i].normal, vertices[i].uv };
+	}
+	return firstVertex;
+}
+
+uint32_t MeshAllocator::AddQuantizedVertices(gsl::span<const Vertex> vertices, const BoundingBox& localBoundingBox)
+{
+	assert(m_vertexFormat == VertexFormat::eQuantized);
+	const uint32_t firstVertex = m_vertexHeap.Allocate(static_cast<uint32_t>(vertices.size()));
+
+	// Dequantized in the vertex shader with the center and extent of the same box
+	const glm::vec3 center = 0.5f * (localBoundingBox.min + localBoundingBox.max);
+	const glm::vec3 extent = 0.5f * (localBoundingBox.max - localBoundingBox.min);
+	const glm::vec3 invExtent(
+		extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+		extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+		extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+	gsl::span<QuantizedPosition> positions = ::WriteElements<QuantizedPosition>(m_vertexHeap, kPositionStream, firstVertex, vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		const glm::vec3 pos = (vertices[i].pos - center) * invExtent;
+		positions[i].pos[0] = ::PackSnorm16(pos.x);
+		positions[i].pos[1] = ::PackSnorm16(pos.y);
+		positions[i].pos[2] = ::PackSnorm16(pos.z);
+		positions[i].pos[3] = 0;
+	}
+
+	gsl::span<QuantizedAttributes> attributes = ::WriteElements<QuantizedAttributes>(m_vertexHeap, kAttributeStream, firstVertex, vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		const glm::vec2 normal = ::EncodeOctahedral(vertices[i].normal);
+		const uint32_t uv = glm::packHalf2x16(vertices[i].uv);
+		attributes[i].normal[0] = ::PackSnorm16(normal.x);
+		attributes[i].normal[1] = ::PackSnorm16(normal.y);
+		attributes[i].uv[0] = static_cast<uint16_t>(uv & 0xFFFF);
+		attributes[i].uv[1] = static_cast<uint16_t>(uv >> 16);
+	}
+	return firstVertex;
+}
+
+void MeshAllocator::FreeVertices(uint32_t firstVertex)
+{
+	m_vertexHeap.Free(firstVertex);
+}
+
+uint32_t MeshAllocator::AddMeshlets(gsl::span<const Meshlet> meshlets, int64_t indexOffset)
 {
-	vk::CommandBuffer commandBuffer = commandRingBuffer.GetCommandBuffer();
+	const uint32_t firstMeshlet = static_cast<uint32_t>(m_meshlets.size());
+	m_meshlets.reserve(m_meshlets.size() + meshlets.size());
+	for (Meshlet meshlet : meshlets)
+	{
+		meshlet.firstIndex = static_cast<uint32_t>(meshlet.firstIndex + indexOffset);
+		m_meshlets.push_back(meshlet);
+	}
+	return firstMeshlet;
+}
 
-	// Upload Geometry
+vk::DeviceSize MeshAllocator::AddIndices(gsl::span<const uint32_t> indices, uint32_t vertexOffset, vk::IndexType indexType)
+{
+	GeometryHeap& heap = GetIndexHeap(indexType);
+	const uint32_t indexOffset = heap.Allocate(static_cast<uint32_t>(indices.size()));
+	if (indexType == vk::IndexType::eUint16)
 	{
-		vk::DeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
-		m_vertexBuffer = std::make_unique<UniqueBufferWithStaging>(bufferSize, vk::BufferUsageFlagBits::eVertexBuffer);
-		memcpy(m_vertexBuffer->GetStagingMappedData(), reinterpret_cast<const void*>(m_vertices.data()), bufferSize);
-		m_vertexBuffer->CopyStagingToGPU(commandBuffer);
+		gsl::span<uint16_t> dst = ::WriteElements<uint16_t>(heap, 0, indexOffset, indices.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			assert(indices[i] + vertexOffset <= (std::numeric_limits<uint16_t>::max)());
+			dst[i] = static_cast<uint16_t>(indices[i] + vertexOffset);
+		}
+		return indexOffset;
+	}
 
-		// We won't need the staging buffer after the initial upload
-		commandRingBuffer.DestroyAfterSubmit(m_vertexBuffer->ReleaseStagingBuffer());
-		m_vertices.clear();
+	assert(indexType == vk::IndexType::eUint32);
+	gsl::span<uint32_t> dst = ::WriteElements<uint32_t>(heap, 0, indexOffset, indices.size());
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		dst[i] = indices[i] + vertexOffset;
 	}
+	return indexOffset;
+}
+
+void MeshAllocator::FreeIndices(vk::DeviceSize indexOffset, vk::IndexType indexType)
+{
+	GetIndexHeap(indexType).Free(static_cast<uint32_t>(indexOffset));
+}
+
+void MeshAllocator::FreeMeshIndices(const Mesh& mesh)
+{
+	for (uint32_t level = 0; level <= mesh.lodCount; ++level)
 	{
-		vk::DeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
-		m_indexBuffer = std::make_unique<UniqueBufferWithStaging>(bufferSize, vk::BufferUsageFlagBits::eIndexBuffer);
-		memcpy(m_indexBuffer->GetStagingMappedData(), reinterpret_cast<const void*>(m_indices.data()), bufferSize);
-		m_indexBuffer->CopyStagingToGPU(commandBuffer);
+		const MeshLod lod = mesh.GetLod(level);
+		if (lod.nbIndices > 0)
+			FreeIndices(lod.indexOffset, mesh.indexType);
+	}
+}
 
-		// We won't need the staging buffer after the initial upload
-		commandRingBuffer.DestroyAfterSubmit(m_indexBuffer->ReleaseStagingBuffer());
-		m_indices.clear();
+void MeshAllocator::UploadToGPU(CommandRingBuffer& commandRingBuffer)
+{
+	m_vertexHeap.Upload(commandRingBuffer);
+	m_indexHeap.Upload(commandRingBuffer);
+	m_indexHeap16.Upload(commandRingBuffer);
+
+	// The buffers are created by the first upload and then keep the same size
+	if (m_positionsBufferHandle == BufferHandle::Invalid)
+	{
+		m_positionsBufferHandle = m_bindlessDescriptors->StoreBuffer(m_vertexHeap.Get(kPositionStream), vk::BufferUsageFlagBits::eStorageBuffer);
+		m_attributesBufferHandle = m_bindlessDescriptors->StoreBuffer(m_vertexHeap.Get(kAttributeStream), vk::BufferUsageFlagBits::eStorageBuffer);
 	}
 }
 
-void MeshAllocator::BindGeometry(const vk::CommandBuffer& commandBuffer) const
+void MeshAllocator::BindIndices(const vk::CommandBuffer& commandBuffer, vk::IndexType indexType) const
 {
-	vk::DeviceSize offsets[] = { 0 };
-	vk::Buffer vertexBuffers[] = { m_vertexBuffer->Get() };
-	commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
-	commandBuffer.bindIndexBuffer(m_indexBuffer->Get(), 0, vk::IndexType::eUint32);
+	commandBuffer.bindIndexBuffer(GetIndexHeap(indexType).Get(), 0, indexType);
 }
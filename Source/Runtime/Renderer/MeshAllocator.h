@@ -1,6 +1,8 @@
 #pragma once
 
 #include <Renderer/SceneTree.h> // todo (hbedard) only for the ID, that's a shame
+#include <Renderer/BindlessDefines.h>
+#include <Renderer/GeometryHeap.h>
 #include <Renderer/MaterialDefines.h>
 #include <RHI/Buffers.h>
 #include <RHI/Device.h>
@@ -9,8 +11,14 @@
 
 #include <glm_includes.h>
 #include <vulkan/vulkan.hpp>
+#include <gsl/pointers>
+#include <gsl/span>
+#include <array>
+#include <cstdint>
 #include <memory>
 
+class BindlessDescriptors;
+
 struct Vertex
 {
 	glm::vec3 pos;
@@ -23,11 +31,89 @@ struct Vertex
 	}
 };
 
-struct Mesh
+// Vertices are stored on the GPU in two streams so that depth-only passes only read positions
+struct VertexAttributes
+{
+	glm::vec3 normal;
+	glm::vec2 uv;
+};
+
+// Compressed streams, 16 bytes per vertex instead of 32
+struct QuantizedPosition
+{
+	int16_t pos[4]; // snorm, relative to the local bounding box of the scene node, w unused
+};
+
+struct QuantizedAttributes
+{
+	int16_t normal[2]; // snorm, octahedral encoding
+	uint16_t uv[2]; // half float
+};
+
+enum class VertexFormat : uint32_t
+{
+	eFloat, // glm::vec3 positions, VertexAttributes
+	eQuantized, // QuantizedPosition, QuantizedAttributes
+};
+
+// Cluster of a mesh, a contiguous range of its indices.
+// Bounds are in the local space of the mesh.
+struct Meshlet
+{
+	static constexpr uint32_t kMaxVertices = 64;
+	static constexpr uint32_t kMaxTriangles = 124;
+
+	glm::vec3 center;
+	float radius = 0.0f;
+	glm::vec3 coneAxis; // average normal
+	float coneCutoff = 1.0f; // sine of the normal cone half-angle, 1 if the cluster can't be back-facing as a whole
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	uint32_t padding[2] = { 0, 0 };
+};
+
+// Index range of a simplified version of a mesh, using the vertices of the mesh
+struct MeshLod
 {
 	vk::DeviceSize indexOffset = 0;
 	vk::DeviceSize nbIndices = 0;
+};
+
+// Levels of detail of a mesh, including the mesh itself
+inline constexpr uint32_t kMaxMeshLodCount = 4;
+
+// Levels of detail and meshlets of a mesh are in the same index buffer as the mesh
+struct Mesh
+{
+	vk::DeviceSize indexOffset = 0; // into the index buffer of indexType
+	vk::DeviceSize nbIndices = 0;
+	vk::IndexType indexType = vk::IndexType::eUint32;
+	int32_t vertexOffset = 0; // first vertex of the mesh for 16-bit indices, 32-bit indices already include it
 	MaterialHandle materialHandle = MaterialHandle::Invalid();
+	uint32_t firstMeshlet = 0; // into MeshAllocator::GetMeshlets(), level 0 only
+	uint32_t meshletCount = 0;
+	uint32_t lodCount = 0; // coarser levels, lods[i] is level i + 1
+	std::array<MeshLod, kMaxMeshLodCount - 1> lods = {};
+	float uvDensity = 0.0f; // texture coordinate units per unit of length in the space of the mesh, for texture streaming
+
+	MeshLod GetLod(uint32_t level) const { return level == 0 ? MeshLod{ indexOffset, nbIndices } : lods[level - 1]; }
+};
+
+// Picks the level of detail of a bounding sphere from its size on screen, each
+// level being used twice as far as the previous one. Matches SelectLod() in visibility_culling.comp.
+struct LodSelection
+{
+	// Level n is used once the radius of a sphere relative to half the screen height
+	// is at most kScreenSize / 2^n, so level 1 starts at 0.125
+	static constexpr float kScreenSize = 0.25f;
+
+	glm::vec3 cameraPosition = glm::vec3(0.0f);
+	float distanceScale = 0.0f; // kScreenSize * tan(fovY / 2)
+
+	static LodSelection FromCamera(const glm::vec3& cameraPosition, float fieldOfViewDegrees);
+
+	// Returns a level in [0, lodCount], lodCount being the number of coarser levels
+	uint32_t SelectLevel(const glm::vec3& center, float radius, uint32_t lodCount) const;
 };
 
 using ModelID = uint32_t;
@@ -41,24 +127,55 @@ struct MeshDrawInfo
 class MeshAllocator
 {
 public:
+	MeshAllocator(BindlessDescriptors& bindlessDescriptors);
+
+	// Must be set before adding vertices
+	void SetVertexFormat(VertexFormat vertexFormat);
+	VertexFormat GetVertexFormat() const { return m_vertexFormat; }
+
+	// For vertex shaders reading the geometry, see vertex_format.glsl. Vertices are not
+	// bound as vertex buffers, shaders read them from the position and attribute streams.
+	ShaderInstanceID CreateVertexShaderInstance(ShaderCache& shaderCache, ShaderID vertexShaderID) const;
+	BufferHandle GetPositionsBufferHandle() const { return m_positionsBufferHandle; }
+	BufferHandle GetAttributesBufferHandle() const { return m_attributesBufferHandle; }
+
 	// todo (hbedard): store meshes associated to a scene node in the scene instead of here
 	void GroupMeshes(SceneNodeHandle sceneNodeID, const std::vector<Mesh>& meshes);
 
 	// todo (hbedard): implement a "RenderResource" interface
+	// Can be called again to upload the geometry added since the last call
 	void UploadToGPU(CommandRingBuffer& commandRingBuffer);
 
-	// Vertices, Indices
-	void BindGeometry(const vk::CommandBuffer& commandBuffer) const;
+	void BindIndices(const vk::CommandBuffer& commandBuffer, vk::IndexType indexType = vk::IndexType::eUint32) const;
 
 	// --- Vertices, meshes and indices --- //
 
-	// Reserves additional space for "count" items
-	void ReserveVertices(size_t count) { m_vertices.reserve(m_vertices.size() + count); }
-	void ReserveIndices(size_t count) { m_indices.reserve(m_indices.size() + count); }
-	void AddVertex(Vertex vertex) { m_vertices.push_back(std::move(vertex)); }
-	void AddIndex(uint32_t index) { m_indices.push_back(index); }
-	size_t GetVertexCount() const { return m_vertices.size(); }
-	size_t GetIndexCount() const { return m_indices.size(); }
+	// Vertices and indices are sub-allocated in GPU buffers of a fixed size once uploaded, freed ranges are reused
+	// by the geometry added next. Ranges can only be freed once the GPU is done with them. Added ranges must not be empty.
+
+	// Return the first added vertex
+	uint32_t AddVertices(gsl::span<const Vertex> vertices);
+	uint32_t AddQuantizedVertices(gsl::span<const Vertex> vertices, const BoundingBox& localBoundingBox); // box of the scene node using them
+	void FreeVertices(uint32_t firstVertex);
+
+	// Meshes with few enough vertices use 16-bit indices relative to their first vertex
+	static vk::IndexType GetIndexType(size_t meshVertexCount) { return meshVertexCount <= (1 << 16) ? vk::IndexType::eUint16 : vk::IndexType::eUint32; }
+
+	// Indices are relative to vertexOffset and must fit in indexType once offset.
+	// Returns the offset of the first added index in the index buffer of indexType.
+	vk::DeviceSize AddIndices(gsl::span<const uint32_t> indices, uint32_t vertexOffset, vk::IndexType indexType = vk::IndexType::eUint32);
+	void FreeIndices(vk::DeviceSize indexOffset, vk::IndexType indexType);
+
+	// Frees the indices of a mesh and of its levels of detail, vertices can be shared by several meshes
+	void FreeMeshIndices(const Mesh& mesh);
+
+	// For memory usage and fragmentation stats
+	const GeometryHeap& GetVertexHeap() const { return m_vertexHeap; }
+	const GeometryHeap& GetIndexHeap(vk::IndexType indexType) const { return indexType == vk::IndexType::eUint16 ? m_indexHeap16 : m_indexHeap; }
+
+	// indexOffset is added to the first index of each meshlet, returns the index of the first added meshlet
+	uint32_t AddMeshlets(gsl::span<const Meshlet> meshlets, int64_t indexOffset);
+	gsl::span<const Meshlet> GetMeshlets() const { return m_meshlets; }
 
 	template <class Func>
 	void ForEachMesh(Func f)
@@ -75,12 +192,30 @@ public:
 private:
 	std::vector<std::pair<SceneNodeHandle, Entry>> m_meshEntries;
 
+	GeometryHeap& GetIndexHeap(vk::IndexType indexType) { return indexType == vk::IndexType::eUint16 ? m_indexHeap16 : m_indexHeap; }
+
+	static GeometryHeap CreateVertexHeap(VertexFormat vertexFormat);
+
+	// Streams of m_vertexHeap
+	static constexpr uint32_t kPositionStream = 0;
+	static constexpr uint32_t kAttributeStream = 1;
+
+	// Free space kept in the GPU buffers for the geometry added after the first upload
+	static constexpr vk::DeviceSize kVertexReserveSize = 64 << 20;
+	static constexpr vk::DeviceSize kIndexReserveSize = 32 << 20;
+
 	// Contains all geometry (vertices and indices)
-	std::vector<Vertex> m_vertices;
-	std::vector<uint32_t> m_indices;
-	std::unique_ptr<UniqueBufferWithStaging> m_vertexBuffer{ nullptr };
-	std::unique_ptr<UniqueBufferWithStaging> m_indexBuffer{ nullptr };
+	VertexFormat m_vertexFormat = VertexFormat::eFloat;
+	GeometryHeap m_vertexHeap;
+	GeometryHeap m_indexHeap;
+	GeometryHeap m_indexHeap16;
+	gsl::not_null<BindlessDescriptors*> m_bindlessDescriptors;
+	BufferHandle m_positionsBufferHandle = BufferHandle::Invalid;
+	BufferHandle m_attributesBufferHandle = BufferHandle::Invalid;
 
 	// Contains all meshes, referenced by meshOffsets
 	std::vector<Mesh> m_meshes;
+
+	// Kept on the CPU for GPU culling, never freed
+	std::vector<Meshlet> m_meshlets;
 };
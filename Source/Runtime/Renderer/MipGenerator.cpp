@@ -0,0 +1,219 @@
+#include <Renderer/MipGenerator.h>
+
+#include <RHI/CommandRingBuffer.h>
+#include <RHI/Device.h>
+#include <RHI/PhysicalDevice.h>
+#include <RHI/ShaderCache.h>
+#include <RHI/Texture.h>
+
+#include <algorithm>
+#include <cassert>
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace MipGenerator_Private
+{
+	constexpr uint32_t kSourceBinding = 0;
+	constexpr uint32_t kMipsBinding = 1;
+	constexpr uint32_t kScratchBinding = 2;
+
+	constexpr uint32_t kTileSize = 64; // texels of mip 0 per group, along x and y
+	constexpr vk::DeviceSize kScratchAlignment = 256; // largest minStorageBufferOffsetAlignment allowed
+
+	struct MipGenerationParams
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipCount;
+		uint32_t isSrgb;
+	};
+
+	// Resources of a batch of textures, destroyed once its commands complete
+	struct MipGenerationBatch : public DeferredDestructible
+	{
+		std::vector<vk::UniqueImageView> imageViews;
+		vk::UniqueDescriptorPool descriptorPool;
+		std::unique_ptr<UniqueBuffer> scratchBuffer;
+	};
+
+	vk::Extent2D GetGroupCount(const Texture& texture)
+	{
+		const vk::Extent3D& extent = texture.GetExtent();
+		return vk::Extent2D((extent.width + kTileSize - 1) / kTileSize, (extent.height + kTileSize - 1) / kTileSize);
+	}
+
+	// Groups done per layer, then a texel of mip 6 per group and layer
+	vk::DeviceSize GetScratchSize(const Texture& texture)
+	{
+		const vk::Extent2D groupCount = GetGroupCount(texture);
+		return MipGenerator::kMaxLayerCount * sizeof(uint32_t) +
+			vk::DeviceSize{ groupCount.width } * groupCount.height * texture.GetLayerCount() * 4 * sizeof(float);
+	}
+}
+
+const AssetPath MipGenerator::kShader("/Engine/Generated/Shaders/mip_generation_comp.spv");
+
+MipGenerator::MipGenerator(ShaderCache& shaderCache)
+{
+	using namespace MipGenerator_Private;
+
+	// Bilinear samples in the middle of 2x2 texels of mip 0 average them
+	m_sampler = g_device->Get().createSamplerUnique(vk::SamplerCreateInfo(
+		{}, // flags
+		vk::Filter::eLinear, // magFilter
+		vk::Filter::eLinear, // minFilter
+		vk::SamplerMipmapMode::eNearest,
+		vk::SamplerAddressMode::eClampToEdge, // addressModeU
+		vk::SamplerAddressMode::eClampToEdge, // addressModeV
+		vk::SamplerAddressMode::eClampToEdge, // addressModeW
+		{}, // mipLodBias
+		false, // anisotropyEnable
+		1, // maxAnisotropy
+		false, // compareEnable
+		vk::CompareOp::eAlways, // compareOp
+		0.0f, // minLod
+		0.0f, // maxLod
+		vk::BorderColor::eIntOpaqueBlack, // borderColor
+		false // unnormalizedCoordinates
+	));
+
+	const std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {
+		vk::DescriptorSetLayoutBinding(kSourceBinding, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute, &m_sampler.get()),
+		vk::DescriptorSetLayoutBinding(kMipsBinding, vk::DescriptorType::eStorageImage, kMaxMipCount - 1, vk::ShaderStageFlagBits::eCompute),
+		vk::DescriptorSetLayoutBinding(kScratchBinding, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+	};
+	m_descriptorSetLayout = g_device->Get().createDescriptorSetLayoutUnique(vk::DescriptorSetLayoutCreateInfo({}, bindings));
+
+	const vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(MipGenerationParams));
+	m_pipelineLayout = g_device->Get().createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo({}, m_descriptorSetLayout.get(), pushConstantRange));
+
+	ShaderID shaderID = shaderCache.CreateShader(kShader.GetPathOnDisk());
+	ShaderInstanceID instanceID = shaderCache.CreateShaderInstance(shaderID);
+	vk::SpecializationInfo specializationInfo;
+	vk::ComputePipelineCreateInfo createInfo(
+		{}, // flags
+		shaderCache.GetShaderStageInfo(instanceID, specializationInfo),
+		m_pipelineLayout.get()
+	);
+	m_pipeline = g_device->Get().createComputePipelineUnique({}, createInfo).value;
+}
+
+bool MipGenerator::IsSupported(vk::Format format, uint32_t width, uint32_t height, uint32_t layerCount)
+{
+	// The last group downsamples at most 32x32 texels of mip 7, up to 4096x4096 for mip 0
+	if ((std::max)(width, height) > (1u << (kMaxMipCount - 1)) || layerCount > kMaxLayerCount)
+		return false;
+
+	const vk::FormatFeatureFlags sourceFeatures = g_physicalDevice->Get().getFormatProperties(format).optimalTilingFeatures;
+	const vk::FormatFeatureFlags storageFeatures = g_physicalDevice->Get().getFormatProperties(Image::GetStorageFormat(format)).optimalTilingFeatures;
+	return (sourceFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear) &&
+		(storageFeatures & vk::FormatFeatureFlagBits::eStorageImage);
+}
+
+void MipGenerator::GenerateMips(CommandRingBuffer& commandRingBuffer, gsl::span<Texture* const> textures)
+{
+	using namespace MipGenerator_Private;
+
+	if (textures.empty())
+		return;
+
+	vk::CommandBuffer commandBuffer = commandRingBuffer.GetCommandBuffer();
+	auto batch = std::make_unique<MipGenerationBatch>();
+	const uint32_t textureCount = static_cast<uint32_t>(textures.size());
+
+	// A single scratch buffer for the batch, cleared at once
+	std::vector<vk::DeviceSize> scratchOffsets(textureCount);
+	vk::DeviceSize scratchSize = 0;
+	for (uint32_t i = 0; i < textureCount; ++i)
+	{
+		scratchOffsets[i] = scratchSize;
+		scratchSize += (GetScratchSize(*textures[i]) + kScratchAlignment - 1) / kScratchAlignment * kScratchAlignment;
+	}
+	batch->scratchBuffer = std::make_unique<UniqueBuffer>(
+		vk::BufferCreateInfo({}, scratchSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst),
+		VmaAllocationCreateInfo{ {}, VMA_MEMORY_USAGE_GPU_ONLY }
+	);
+
+	// One descriptor set per texture
+	const std::array<vk::DescriptorPoolSize, 3> poolSizes = {
+		vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, textureCount),
+		vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, textureCount * (kMaxMipCount - 1)),
+		vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, textureCount),
+	};
+	batch->descriptorPool = g_device->Get().createDescriptorPoolUnique(vk::DescriptorPoolCreateInfo({}, textureCount, poolSizes));
+	const std::vector<vk::DescriptorSetLayout> setLayouts(textureCount, m_descriptorSetLayout.get());
+	const std::vector<vk::DescriptorSet> descriptorSets = g_device->Get().allocateDescriptorSets(
+		vk::DescriptorSetAllocateInfo(batch->descriptorPool.get(), setLayouts));
+
+	for (uint32_t i = 0; i < textureCount; ++i)
+	{
+		const Texture& texture = *textures[i];
+		assert(texture.GetMipLevels() > 1 && texture.GetMipLevels() <= kMaxMipCount);
+
+		batch->imageViews.push_back(texture.CreateLayerArrayView(0, vk::ImageUsageFlagBits::eSampled));
+		const vk::DescriptorImageInfo sourceInfo({}, batch->imageViews.back().get(), vk::ImageLayout::eGeneral);
+
+		// Descriptors past the last level repeat it, they are never written
+		std::array<vk::DescriptorImageInfo, kMaxMipCount - 1> mipInfos;
+		for (uint32_t level = 1; level < kMaxMipCount; ++level)
+		{
+			if (level < texture.GetMipLevels())
+				batch->imageViews.push_back(texture.CreateLayerArrayView(level, vk::ImageUsageFlagBits::eStorage));
+			mipInfos[level - 1] = vk::DescriptorImageInfo({}, batch->imageViews.back().get(), vk::ImageLayout::eGeneral);
+		}
+
+		const vk::DescriptorBufferInfo scratchInfo(batch->scratchBuffer->Get(), scratchOffsets[i], GetScratchSize(texture));
+
+		const std::array<vk::WriteDescriptorSet, 3> writes = {
+			vk::WriteDescriptorSet(descriptorSets[i], kSourceBinding, 0, vk::DescriptorType::eCombinedImageSampler, sourceInfo),
+			vk::WriteDescriptorSet(descriptorSets[i], kMipsBinding, 0, vk::DescriptorType::eStorageImage, mipInfos),
+			vk::WriteDescriptorSet(descriptorSets[i], kScratchBinding, 0, vk::DescriptorType::eStorageBuffer, {}, scratchInfo),
+		};
+		g_device->Get().updateDescriptorSets(writes, {});
+	}
+
+	// Mip 0 is sampled while the other levels are written, the whole image is in the general layout
+	commandBuffer.fillBuffer(batch->scratchBuffer->Get(), 0, VK_WHOLE_SIZE, 0);
+	std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+	imageBarriers.reserve(textureCount);
+	for (Texture* texture : textures)
+	{
+		imageBarriers.push_back(texture->MakeLayoutBarrier(vk::ImageLayout::eGeneral,
+			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead | vk::AccessFlagBits2::eShaderStorageWrite));
+	}
+	const vk::MemoryBarrier2 scratchBarrier(
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, scratchBarrier, {}, imageBarriers));
+
+	// Textures don't depend on each other, dispatches can overlap
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.get());
+	for (uint32_t i = 0; i < textureCount; ++i)
+	{
+		const Texture& texture = *textures[i];
+		const vk::Extent2D groupCount = GetGroupCount(texture);
+		const MipGenerationParams params = {
+			texture.GetExtent().width,
+			texture.GetExtent().height,
+			texture.GetMipLevels(),
+			Image::GetStorageFormat(texture.GetFormat()) != texture.GetFormat(),
+		};
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout.get(), 0, descriptorSets[i], {});
+		commandBuffer.pushConstants(m_pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(params), &params);
+		commandBuffer.dispatch(groupCount.width, groupCount.height, texture.GetLayerCount());
+	}
+
+	imageBarriers.clear();
+	for (Texture* texture : textures)
+	{
+		imageBarriers.push_back(texture->MakeLayoutBarrier(vk::ImageLayout::eShaderReadOnlyOptimal,
+			vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+			vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader,
+			vk::AccessFlagBits2::eShaderSampledRead));
+	}
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, {}, {}, imageBarriers));
+
+	commandRingBuffer.DestroyAfterSubmit(batch.release());
+}
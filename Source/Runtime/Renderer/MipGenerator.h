@@ -0,0 +1,39 @@
+#pragma once
+
+#include <AssetPath.h>
+#include <vulkan/vulkan.hpp>
+
+#include <gsl/span>
+#include <cstdint>
+
+class CommandRingBuffer;
+class ShaderCache;
+class Texture;
+
+// Generates the mip levels of textures with a compute shader, all levels and layers of a texture in a single dispatch.
+// Each group of the dispatch downsamples a tile of mip 0 to mip 6 in shared memory, the last group to finish
+// continues with the smallest levels. Barriers of a batch of textures are recorded together.
+class MipGenerator
+{
+public:
+	static constexpr uint32_t kMaxMipCount = 13; // up to 4096x4096
+	static constexpr uint32_t kMaxLayerCount = 8;
+
+	explicit MipGenerator(ShaderCache& shaderCache);
+
+	// Textures need the storage usage, they can be written as long as their format (or its UNORM
+	// equivalent for sRGB formats) supports it. Otherwise mip levels are blitted, see Texture::GenerateMipmaps().
+	static bool IsSupported(vk::Format format, uint32_t width, uint32_t height, uint32_t layerCount);
+
+	// Mip level 0 of the textures is read from the transfer destination layout,
+	// all levels are in the shader read-only layout once the commands complete
+	void GenerateMips(CommandRingBuffer& commandRingBuffer, gsl::span<Texture* const> textures);
+
+private:
+	static const AssetPath kShader;
+
+	vk::UniqueSampler m_sampler;
+	vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+	vk::UniquePipelineLayout m_pipelineLayout;
+	vk::UniquePipeline m_pipeline;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <Renderer/GPUCulling.h>
+#include <Renderer/IndirectDrawBuffer.h>
 #include <Renderer/MaterialSystem.h>
 #include <Renderer/MeshAllocator.h>
 #include <RHI/GraphicsPipelineCache.h>
@@ -84,44 +86,6 @@ public:
 		}
 	}
 
-	void BindSceneNode(SceneNodeHandle newSceneNodeID)
-	{
-		if (newSceneNodeID != m_sceneNodeID)
-		{
-			vk::PipelineLayout pipelineLayout = m_graphicsPipelineCache->GetPipelineLayout(m_pipelineID, 0);
-
-			uint32_t sceneNodeIndex = static_cast<uint32_t>(newSceneNodeID);
-
-			// Set scene node index push constant
-			m_commandBuffer->pushConstants(
-				pipelineLayout,
-				vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-				0, sizeof(uint32_t), &sceneNodeIndex
-			);
-
-			m_sceneNodeID = newSceneNodeID;
-		}
-	}
-
-	void BindMaterial(MaterialHandle newMaterial)
-	{
-		if (newMaterial != m_material)
-		{
-			vk::PipelineLayout pipelineLayout = m_graphicsPipelineCache->GetPipelineLayout(m_pipelineID, 0);
-
-			uint32_t materialIndex = newMaterial.GetIndex();
-
-			// Set material index push constant
-			m_commandBuffer->pushConstants(
-				pipelineLayout,
-				vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-				4, sizeof(uint32_t), &materialIndex
-			);
-
-			m_material = newMaterial;
-		}
-	}
-
 	void BindPushConstant(uint32_t index, uint32_t value)
 	{
 		vk::PipelineLayout pipelineLayout = m_graphicsPipelineCache->GetPipelineLayout(m_pipelineID, 0);
@@ -134,13 +98,39 @@ public:
 		);
 	}
 
+	// Draws commands [firstDraw, firstDraw + drawCount) of the current frame
+	void DrawIndexedIndirect(const IndirectDrawBuffer& indirectDrawBuffer, uint32_t firstDraw, uint32_t drawCount)
+	{
+		if (drawCount == 0)
+			return;
+
+		m_commandBuffer->drawIndexedIndirect(
+			indirectDrawBuffer.GetIndirectBuffer(m_frameIndex),
+			firstDraw * IndirectDrawBuffer::kCommandStride,
+			drawCount,
+			IndirectDrawBuffer::kCommandStride
+		);
+	}
+
+	// Draw count is read from the GPU, up to draw.maxDrawCount
+	void DrawIndexedIndirectCount(const IndirectCountDraw& draw)
+	{
+		if (draw.maxDrawCount == 0)
+			return;
+
+		m_commandBuffer->drawIndexedIndirectCount(
+			draw.commandBuffer, draw.commandOffset,
+			draw.countBuffer, draw.countOffset,
+			draw.maxDrawCount,
+			IndirectDrawBuffer::kCommandStride
+		);
+	}
+
 private:
 	gsl::not_null<GraphicsPipelineCache*> m_graphicsPipelineCache;
 	gsl::not_null<const BindlessDrawParams*> m_bindlessDrawParams;
 
 	uint32_t m_frameIndex = 0;
 	vk::CommandBuffer* m_commandBuffer = nullptr;
-	SceneNodeHandle m_sceneNodeID = SceneNodeHandle::Invalid;
 	GraphicsPipelineID m_pipelineID = ~0U;
-	MaterialHandle m_material = MaterialHandle::Invalid();
 };
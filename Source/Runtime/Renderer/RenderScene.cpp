@@ -2,6 +2,9 @@
 
 #include <Renderer/CameraViewSystem.h>
 #include <Renderer/Bindless.h>
+#include <Renderer/ComputeCommandEncoder.h>
+#include <Renderer/FrustumCulling.h>
+#include <Renderer/GPUCulling.h>
 #include <Renderer/Grid.h>
 #include <Renderer/ImageBasedLightSystem.h>
 #include <Renderer/LightSystem.h>
@@ -12,15 +15,19 @@
 #include <Renderer/Skybox.h>
 #include <Renderer/ShadowSystem.h>
 #include <Renderer/RenderCommandEncoder.h>
+#include <Renderer/TextureCache.h>
 #include <RHI/GraphicsPipelineCache.h>
 #include <vulkan/vulkan.hpp>
 #include <glm_includes.h>
 
+#include <algorithm>
+#include <cmath>
+
 // todo (hbedard): just pass the scene to these so they can bind to what they want
 // or perhaps a struct with all buffer handles
 RenderScene::RenderScene(Renderer& renderer)
 	: m_renderer(&renderer)
-	, m_meshAllocator(std::make_unique<MeshAllocator>())
+	, m_meshAllocator(std::make_unique<MeshAllocator>(*m_renderer->GetBindlessDescriptors()))
 	, m_sceneTree(std::make_unique<SceneTree>(*m_renderer->GetBindlessDescriptors()))
 	, m_lightSystem(std::make_unique<LightSystem>(*m_renderer->GetBindlessDescriptors()))
 	, m_shadowSystem(std::make_unique<ShadowSystem>(vk::Extent2D(4096, 4096), *m_renderer))
@@ -31,6 +38,7 @@ RenderScene::RenderScene(Renderer& renderer)
 		*m_renderer->GetGraphicsPipelineCache(),
 		*m_renderer->GetBindlessDescriptors(),
 		*m_renderer->GetBindlessDrawParams(),
+		*m_meshAllocator,
 		*m_sceneTree,
 		*m_lightSystem,
 		*m_shadowSystem))
@@ -45,8 +53,10 @@ RenderScene::RenderScene(Renderer& renderer)
 		*m_renderer->GetBindlessDrawParams(),
 		*m_renderer->GetTextureCache()))
 	, m_iblSystem(std::make_unique<ImageBasedLightSystem>(*m_renderer))
+	, m_frustumCulling(std::make_unique<FrustumCulling>())
 	, m_areShadowsDirty(true)
 	, m_areEnvironmentMapsDirty(true)
+	, m_isGPUCullingValidationEnabled(false)
 {
 }
 
@@ -59,14 +69,66 @@ void RenderScene::Init()
 	m_materialSystem->SetViewBufferHandles(m_cameraViewSystem->GetViewBufferHandles());
 	m_grid->SetViewBufferHandles(m_cameraViewSystem->GetViewBufferHandles());
 	m_skybox->SetViewBufferHandles(m_cameraViewSystem->GetViewBufferHandles());
+	m_materialSystem->SetVirtualTextureBufferHandles(
+		m_renderer->GetTextureCache()->GetVirtualTextureBufferHandle(),
+		m_renderer->GetTextureCache()->GetTextureFeedbackBufferHandles());
+	m_materialSystem->SetTextureSlotsBufferHandle(m_renderer->GetTextureCache()->GetTextureSlotsBufferHandle());
 	
 	m_iblSystem->Init();
 
 	PopulateMeshDrawCalls();
 	SortOpaqueMeshes();
+	CreateIndirectDrawBuffers();
 	UploadToGPU();
 }
 
+void RenderScene::CreateIndirectDrawBuffers()
+{
+	// Opaque meshes are culled on the GPU for the camera and all meshes for shadows.
+	// Translucent meshes are culled and sorted on the CPU since their order matters.
+	gsl::not_null<BindlessDescriptors*> bindlessDescriptors = m_renderer->GetBindlessDescriptors();
+	const uint32_t opaqueCount = static_cast<uint32_t>(m_opaqueMeshes.size());
+	const uint32_t translucentCount = static_cast<uint32_t>(m_translucentMeshes.size());
+	const uint32_t shadowCount = static_cast<uint32_t>(m_shadowSystem->GetShadowCount());
+	m_translucentIndirectDraws = std::make_unique<IndirectDrawBuffer>(*bindlessDescriptors, translucentCount);
+	m_gpuCulling = std::make_unique<GPUCulling>(*m_renderer, opaqueCount + translucentCount, opaqueCount, shadowCount);
+	if (m_isGPUCullingValidationEnabled)
+		m_gpuCulling->EnableReadBack();
+
+	m_materialSystem->SetDrawDataBufferHandles(m_translucentIndirectDraws->GetDrawDataBufferHandles());
+	m_materialSystem->SetCulledDrawDataBufferHandles(m_gpuCulling->GetDrawDataBufferHandles());
+	m_shadowSystem->SetDrawDataBufferHandles(m_gpuCulling->GetDrawDataBufferHandles());
+}
+
+void RenderScene::UploadGPUCulling(CommandRingBuffer& commandRingBuffer)
+{
+	// Opaque meshes are sorted by material then index type, split them in runs sharing a graphics pipeline and an index buffer
+	std::vector<uint32_t> batchIndices;
+	batchIndices.reserve(m_opaqueMeshes.size());
+	m_opaqueBatches.clear();
+	for (const MeshDrawInfo& drawCall : m_opaqueMeshes)
+	{
+		const GraphicsPipelineID pipelineID = m_materialSystem->GetGraphicsPipelineID(drawCall.mesh.materialHandle);
+		if (m_opaqueBatches.empty() || m_opaqueBatches.back().pipelineID != pipelineID || m_opaqueBatches.back().indexType != drawCall.mesh.indexType)
+			m_opaqueBatches.push_back({ pipelineID, drawCall.mesh.indexType });
+		batchIndices.push_back(static_cast<uint32_t>(m_opaqueBatches.size() - 1));
+	}
+
+	std::vector<MeshDrawInfo> drawCalls;
+	drawCalls.reserve(m_opaqueMeshes.size() + m_translucentMeshes.size());
+	drawCalls.insert(drawCalls.end(), m_opaqueMeshes.begin(), m_opaqueMeshes.end());
+	drawCalls.insert(drawCalls.end(), m_translucentMeshes.begin(), m_translucentMeshes.end());
+
+	m_gpuCulling->UploadToGPU(commandRingBuffer, *m_sceneTree, drawCalls, batchIndices, m_meshAllocator->GetMeshlets());
+
+	m_nodeLodCounts.assign(m_sceneTree->GetNodeCount(), 0);
+	for (const MeshDrawInfo& drawCall : drawCalls)
+	{
+		uint32_t& lodCount = m_nodeLodCounts[static_cast<size_t>(drawCall.sceneNodeID)];
+		lodCount = (std::max)(lodCount, drawCall.mesh.lodCount);
+	}
+}
+
 void RenderScene::Reset()
 {
 	const Swapchain& swapchain = m_renderer->GetSwapchain();
@@ -86,6 +148,7 @@ void RenderScene::UploadToGPU()
 	m_shadowSystem->UploadToGPU(commandRingBuffer);
 	m_cameraViewSystem->UploadToGPU(commandRingBuffer);
 	m_materialSystem->UploadToGPU(commandRingBuffer);
+	UploadGPUCulling(commandRingBuffer); // after materials have their pipelines
 	m_grid->UploadToGPU(commandRingBuffer);
 	m_skybox->UploadToGPU(commandRingBuffer);
 	m_iblSystem->UploadToGPU(commandRingBuffer);
@@ -104,20 +167,26 @@ void RenderScene::PopulateMeshDrawCalls()
 
 void RenderScene::SortOpaqueMeshes()
 {
-	// todo (hbedard): this comment probably needs to be updated
-	// Sort opaque draw calls by material, then materialInstance, then mesh.
-	// This minimizes the number of pipeline bindings (costly),
-	// then descriptor set bindings (a bit less costly).
+	// Sort opaque draw calls by material, then index type, then mesh, then scene node.
+	// Materials first so that each graphics pipeline is bound once per run of draws,
+	// then the index type so that each run binds the 16 or 32-bit index buffer once.
+	// Instances of the same mesh end up contiguous, GPU culling groups them in instanced draws.
 	//
-	// For example (m = material, i = materialInstance, o = object mesh):
+	// For example (m = material, t = index type, o = object mesh, n = scene node):
 	//
-	// | m0, i0, o0 | m0, i0, o1 | m0, i1, o2 | m1, i2, o3 |
+	// | m0, t16, o0, n0 | m0, t16, o0, n3 | m0, t32, o1, n1 | m1, t16, o2, n2 |
 	//
 	std::sort(m_opaqueMeshes.begin(), m_opaqueMeshes.end(),
 		[](const MeshDrawInfo& a, const MeshDrawInfo& b) {
-			// Then material instance
+			// Material first
 			if (a.mesh.materialHandle != b.mesh.materialHandle)
 				return a.mesh.materialHandle < b.mesh.materialHandle;
+			// Then index buffer, to bind each one once per material
+			if (a.mesh.indexType != b.mesh.indexType)
+				return a.mesh.indexType < b.mesh.indexType;
+			// Then mesh, so that instances of the same mesh are contiguous for GPU culling
+			if (a.mesh.indexOffset != b.mesh.indexOffset)
+				return a.mesh.indexOffset < b.mesh.indexOffset;
 			// Then scene node
 			else
 				return a.sceneNodeID < b.sceneNodeID;
@@ -160,14 +229,161 @@ void RenderScene::SortTranslucentMeshes()
 
 void RenderScene::Update()
 {
+	// Propagate transforms of nodes that moved since the last frame
+	if (m_sceneTree->Update(m_renderer->GetFrameIndex()))
+	{
+		m_areShadowsDirty = true;
+	}
+
 	m_cameraViewSystem->Update(m_renderer->GetFrameIndex());
 	GetShadowSystem()->Update(m_cameraViewSystem->GetCamera(), m_sceneTree->GetSceneBoundingBox());
 	SortTranslucentMeshes();
+	CullTranslucentMeshes();
+	RequestTextureMips();
+	UpdateGPUCulling();
+}
+
+void RenderScene::CullTranslucentMeshes()
+{
+	// Copy all boxes when nodes were added, otherwise only those of the nodes that moved
+	const std::vector<BoundingBox>& worldBoundingBoxes = m_sceneTree->GetWorldBoundingBoxes();
+	if (m_frustumCulling->GetBoxCount() != worldBoundingBoxes.size())
+		m_frustumCulling->SetBoundingBoxes(worldBoundingBoxes);
+	else
+		m_frustumCulling->UpdateBoundingBoxes(worldBoundingBoxes, m_sceneTree->GetMovedNodes());
+	m_frustumCulling->ComputeVisibility(m_cameraViewSystem->GetCamera().ComputeFrustum());
+
+	// Culling keeps the draw order so sorting is still valid
+	m_frustumCulling->Cull(m_translucentMeshes, m_visibleTranslucentMeshes);
+
+	// Distant meshes are drawn with a coarser level of detail
+	const Camera& camera = m_cameraViewSystem->GetCamera();
+	const LodSelection lodSelection = LodSelection::FromCamera(camera.GetEye(), camera.GetFieldOfView());
+	for (MeshDrawInfo& drawCall : m_visibleTranslucentMeshes)
+	{
+		if (drawCall.mesh.lodCount == 0)
+			continue;
+
+		const BoundingBox& box = worldBoundingBoxes[static_cast<size_t>(drawCall.sceneNodeID)];
+		const uint32_t level = lodSelection.SelectLevel(0.5f * (box.min + box.max), 0.5f * glm::distance(box.min, box.max), drawCall.mesh.lodCount);
+		const MeshLod lod = drawCall.mesh.GetLod(level);
+		drawCall.mesh.indexOffset = lod.indexOffset;
+		drawCall.mesh.nbIndices = lod.nbIndices;
+	}
+
+	m_translucentIndirectDraws->Reset(m_renderer->GetFrameIndex());
+	m_translucentDrawRange = m_translucentIndirectDraws->AddDraws(m_visibleTranslucentMeshes);
+}
+
+void RenderScene::RequestTextureMips()
+{
+	// Footprint of the closest point of each visible draw, using the visibility computed by CullTranslucentMeshes()
+	const Camera& camera = m_cameraViewSystem->GetCamera();
+	const glm::vec3 eye = camera.GetEye();
+	const float worldUnitsPerPixelScale = 2.0f * std::tan(glm::radians(camera.GetFieldOfView()) * 0.5f) / static_cast<float>(m_renderer->GetImageExtent().height);
+	const std::vector<BoundingBox>& worldBoundingBoxes = m_sceneTree->GetWorldBoundingBoxes();
+	gsl::not_null<TextureCache*> textureCache = m_renderer->GetTextureCache();
+	for (const std::vector<MeshDrawInfo>* drawCalls : { &m_opaqueMeshes, &m_translucentMeshes })
+	{
+		for (const MeshDrawInfo& drawCall : *drawCalls)
+		{
+			const size_t nodeIndex = static_cast<size_t>(drawCall.sceneNodeID);
+			if (drawCall.mesh.uvDensity <= 0.0f || !m_frustumCulling->IsVisible(nodeIndex))
+				continue;
+
+			// Scale of the node along its largest axis, texels are stretched the most along it
+			const glm::mat4& transform = m_sceneTree->GetTransform(drawCall.sceneNodeID);
+			const float scale = (std::max)({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+			if (scale <= 0.0f)
+				continue;
+
+			const BoundingBox& box = worldBoundingBoxes[nodeIndex];
+			const float distance = glm::distance(eye, glm::clamp(eye, box.min, box.max));
+			const float uvPerPixel = drawCall.mesh.uvDensity / scale * distance * worldUnitsPerPixelScale;
+
+			const MaterialProperties& properties = m_materialSystem->GetMaterialProperties(drawCall.mesh.materialHandle);
+			for (TextureHandle textureHandle : properties.textures)
+				textureCache->RequestMipLevel(textureHandle, uvPerPixel);
+		}
+	}
+}
+
+void RenderScene::UpdateGPUCulling()
+{
+	std::vector<Frustum> shadowFrustums;
+	shadowFrustums.reserve(m_shadowSystem->GetShadowCount());
+	for (ShadowID id = 0; id < m_shadowSystem->GetShadowCount(); ++id)
+	{
+		shadowFrustums.push_back(Frustum::FromMatrix(m_shadowSystem->GetLightTransform(id)));
+	}
+
+	const Camera& camera = m_cameraViewSystem->GetCamera();
+	const LodSelection lodSelection = LodSelection::FromCamera(camera.GetEye(), camera.GetFieldOfView());
+	m_gpuCulling->Update(
+		m_renderer->GetFrameIndex(),
+		camera.ComputeFrustum(),
+		lodSelection,
+		shadowFrustums,
+		m_shadowSystem->GetLodBias());
+
+	if (HaveShadowLodLevelsChanged(shadowFrustums, lodSelection))
+	{
+		m_areShadowsDirty = true;
+	}
+}
+
+bool RenderScene::ValidateGPUCulling(uint32_t frameIndex) const
+{
+	// Visibility of scene nodes in the same views as the last UpdateGPUCulling()
+	const std::vector<BoundingBox>& worldBoundingBoxes = m_sceneTree->GetWorldBoundingBoxes();
+	std::vector<FrustumCulling> views(1 + m_shadowSystem->GetShadowCount());
+	views[0].SetBoundingBoxes(worldBoundingBoxes);
+	views[0].ComputeVisibility(m_cameraViewSystem->GetCamera().ComputeFrustum());
+	for (ShadowID id = 0; id < m_shadowSystem->GetShadowCount(); ++id)
+	{
+		views[1 + id].SetBoundingBoxes(worldBoundingBoxes);
+		views[1 + id].ComputeVisibility(Frustum::FromMatrix(m_shadowSystem->GetLightTransform(id)));
+	}
+
+	return m_gpuCulling->ValidateReadBack(frameIndex, views);
+}
+
+bool RenderScene::HaveShadowLodLevelsChanged(gsl::span<const Frustum> shadowFrustums, const LodSelection& lodSelection)
+{
+	// Shadow views pick levels of detail from the distance to the camera like the GPU culling pass,
+	// levels of the nodes seen by a shadow view can change without anything moving
+	std::vector<uint32_t> nodeIndices;
+	for (const Frustum& frustum : shadowFrustums)
+	{
+		m_sceneTree->GetBoundingVolumeHierarchy().QueryFrustum(frustum, nodeIndices);
+	}
+
+	const std::vector<BoundingBox>& worldBoundingBoxes = m_sceneTree->GetWorldBoundingBoxes();
+	const uint32_t lodBias = m_shadowSystem->GetLodBias();
+	std::vector<uint32_t> levels(m_nodeLodCounts.size(), 0);
+	for (uint32_t nodeIndex : nodeIndices)
+	{
+		const uint32_t lodCount = m_nodeLodCounts[nodeIndex];
+		if (lodCount == 0)
+			continue;
+
+		const BoundingBox& box = worldBoundingBoxes[nodeIndex];
+		const uint32_t level = lodSelection.SelectLevel(0.5f * (box.min + box.max), 0.5f * glm::distance(box.min, box.max), lodCount);
+		levels[nodeIndex] = (std::min)(level + lodBias, lodCount);
+	}
+
+	if (levels == m_shadowLodLevels)
+		return false;
+
+	m_shadowLodLevels = std::move(levels);
+	return true;
 }
 
 void RenderScene::Render()
 {
-	// Only render shadow depth maps once at the start since everything is static at the moment
+	RenderCullingPass();
+
+	// Only render shadow depth maps when something moved
 	if (m_areShadowsDirty)
 	{
 		RenderShadowDepthPass();
@@ -188,6 +404,19 @@ void RenderScene::RenderEnvironmentMaps() const
 	m_iblSystem->Render(); // todo (hbedard): this needs another pass
 }
 
+void RenderScene::RenderCullingPass() const
+{
+	// Writes the visible draws of the camera and shadow views for this frame
+	vk::CommandBuffer commandBuffer = m_renderer->GetCommandRingBuffer().GetCommandBuffer();
+	ComputeCommandEncoder computeCommandEncoder(
+		*m_renderer->GetComputePipelineCache(),
+		*m_renderer->GetBindlessDescriptors(),
+		*m_renderer->GetBindlessDrawParams());
+	computeCommandEncoder.BeginCompute(commandBuffer, m_renderer->GetFrameIndex());
+	m_gpuCulling->Dispatch(computeCommandEncoder);
+	computeCommandEncoder.EndCompute();
+}
+
 void RenderScene::RenderShadowDepthPass() const
 {
 	// todo (hbedard): I have a feeling this is supposed to be in another pass?
@@ -196,15 +425,8 @@ void RenderScene::RenderShadowDepthPass() const
 		return;
 	}
 
-	// Prepare draw commands
-	vk::CommandBuffer commandBuffer = m_renderer->GetCommandRingBuffer().GetCommandBuffer();
-	std::vector<MeshDrawInfo> drawCalls;
-	drawCalls.resize(m_opaqueMeshes.size() + m_translucentMeshes.size());
-	std::copy(m_opaqueMeshes.begin(), m_opaqueMeshes.end(), drawCalls.begin());
-	std::copy(m_translucentMeshes.begin(), m_translucentMeshes.end(), drawCalls.begin() + m_opaqueMeshes.size());
-
 	// Render into shadow depth maps
-	m_shadowSystem->Render(drawCalls);
+	m_shadowSystem->Render(*m_gpuCulling);
 }
 
 void RenderScene::RenderBasePass() const
@@ -223,20 +445,29 @@ void RenderScene::RenderBasePass() const
 		RenderCommandEncoder renderCommandEncoder(*graphicsPipelineCache, *bindlessDrawParams);
 		renderCommandEncoder.BeginRender(commandBuffer, m_renderer->GetFrameIndex());
 		renderCommandEncoder.BindBindlessDescriptorSet(bindlessDescriptors->GetPipelineLayout(), bindlessDescriptors->GetDescriptorSet());
-		RenderBasePassMeshes(renderCommandEncoder, m_opaqueMeshes);
-		RenderBasePassMeshes(renderCommandEncoder, m_translucentMeshes);
+		RenderBasePassMeshes(renderCommandEncoder);
 		m_skybox->Render(renderCommandEncoder);
 		renderCommandEncoder.EndRender();
 	}
 	commandBuffer.endRendering();
 }
 
-void RenderScene::RenderBasePassMeshes(RenderCommandEncoder& renderCommandEncoder, const std::vector<MeshDrawInfo>& drawCalls) const
+void RenderScene::RenderBasePassMeshes(RenderCommandEncoder& renderCommandEncoder) const
 {
-	if (!drawCalls.empty())
+	if (m_opaqueMeshes.empty() && m_translucentMeshes.empty())
+		return;
+
+	vk::CommandBuffer commandBuffer = renderCommandEncoder.GetCommandBuffer();
+	m_meshAllocator->BindIndices(commandBuffer);
+
+	m_materialSystem->DrawCulled(renderCommandEncoder, *m_gpuCulling, m_opaqueBatches);
+
+	if (!m_visibleTranslucentMeshes.empty())
 	{
-		vk::CommandBuffer commandBuffer = renderCommandEncoder.GetCommandBuffer();
-		m_meshAllocator->BindGeometry(commandBuffer);
-		m_materialSystem->Draw(renderCommandEncoder, gsl::span(drawCalls.data(), drawCalls.size()));
+		m_materialSystem->Draw(
+			renderCommandEncoder,
+			gsl::span(m_visibleTranslucentMeshes.data(), m_visibleTranslucentMeshes.size()),
+			*m_translucentIndirectDraws,
+			m_translucentDrawRange);
 	}
 }
@@ -1,13 +1,22 @@
 #pragma once
 
+#include <Renderer/IndirectDrawBuffer.h>
+#include <RHI/GraphicsPipelineCache.h>
+
 #include <vulkan/vulkan.hpp>
 #include <gsl/pointers>
+#include <gsl/span>
 
 #include <memory>
 
 class CameraViewSystem;
+class CommandRingBuffer;
+struct Frustum;
+class FrustumCulling;
+class GPUCulling;
 class Grid;
 class LightSystem;
+struct LodSelection;
 class MeshAllocator;
 struct MeshDrawInfo;
 class Renderer;
@@ -29,6 +38,13 @@ public:
 	void UploadToGPU();
 	void Update();
 	void Render();
+
+	// Must be called before Init(), reads back the counts of GPU culling to compare them with CPU culling
+	void EnableGPUCullingValidation() { m_isGPUCullingValidationEnabled = true; }
+
+	// The scene, the camera and the lights must not have changed since this frame index was rendered
+	// and the frame must be complete. Mismatches are written to std::cerr.
+	bool ValidateGPUCulling(uint32_t frameIndex) const;
 	
 	gsl::not_null<Renderer*> GetRenderer() const { return m_renderer.get(); }
 	gsl::not_null<MeshAllocator*> GetMeshAllocator() const { return m_meshAllocator.get(); }
@@ -52,18 +68,34 @@ private:
 	std::unique_ptr<Grid> m_grid;
 	std::unique_ptr<Skybox> m_skybox;
 	std::unique_ptr<ImageBasedLightSystem> m_iblSystem;
+	std::unique_ptr<FrustumCulling> m_frustumCulling;
+	std::unique_ptr<IndirectDrawBuffer> m_translucentIndirectDraws;
+	std::unique_ptr<GPUCulling> m_gpuCulling;
 
 	std::vector<MeshDrawInfo> m_opaqueMeshes;
 	std::vector<MeshDrawInfo> m_translucentMeshes;
+	std::vector<MeshDrawInfo> m_visibleTranslucentMeshes;
+	IndirectDrawRange m_translucentDrawRange;
+	std::vector<IndirectDrawBatch> m_opaqueBatches; // GPU culling camera batch -> pipeline and index type
+	std::vector<uint32_t> m_nodeLodCounts; // coarser levels of the meshes of each scene node
+	std::vector<uint32_t> m_shadowLodLevels; // of each scene node when shadow maps were last rendered
 	bool m_areShadowsDirty : 1;
 	bool m_areEnvironmentMapsDirty : 1;
+	bool m_isGPUCullingValidationEnabled : 1;
 
 	void PopulateMeshDrawCalls();
 	void SortOpaqueMeshes();
 	void SortTranslucentMeshes();
+	void CullTranslucentMeshes();
+	void RequestTextureMips();
+	void UpdateGPUCulling();
+	bool HaveShadowLodLevelsChanged(gsl::span<const Frustum> shadowFrustums, const LodSelection& lodSelection);
+	void CreateIndirectDrawBuffers();
+	void UploadGPUCulling(CommandRingBuffer& commandRingBuffer);
 
 	void RenderEnvironmentMaps() const;
+	void RenderCullingPass() const;
 	void RenderShadowDepthPass() const;
 	void RenderBasePass() const;
-	void RenderBasePassMeshes(RenderCommandEncoder& renderCommandEncoder, const std::vector<MeshDrawInfo>& drawCalls) const;
+	void RenderBasePassMeshes(RenderCommandEncoder& renderCommandEncoder) const;
 };
@@ -5,6 +5,7 @@
 #include <Renderer/RenderCommandEncoder.h>
 #include <Renderer/TextureCache.h>
 #include <RHI/Framebuffer.h>
+#include <RHI/ComputePipelineCache.h>
 #include <RHI/GraphicsPipelineCache.h>
 #include <RHI/PhysicalDevice.h>
 #include <RHI/RenderPass.h>
@@ -40,10 +41,11 @@ Renderer::Renderer(vk::Instance instance, vk::SurfaceKHR surface, vk::Extent2D e
 	, m_instance(instance)
 	, m_shaderCache(std::make_unique<ShaderCache>())
 	, m_graphicsPipelineCache(std::make_unique<GraphicsPipelineCache>(*m_shaderCache))
+	, m_computePipelineCache(std::make_unique<ComputePipelineCache>(*m_shaderCache))
 	, m_bindlessDescriptors(std::make_unique<BindlessDescriptors>())
 	, m_bindlessDrawParams(std::make_unique<BindlessDrawParams>(g_physicalDevice->GetMinUniformBufferOffsetAlignment(), m_bindlessDescriptors->GetDescriptorSetLayout()))
-	, m_bindlessFactory(std::make_unique<BindlessFactory>(*m_bindlessDescriptors, *m_bindlessDrawParams, *m_graphicsPipelineCache))
-	, m_textureCache(std::make_unique<TextureCache>(*m_bindlessDescriptors))
+	, m_bindlessFactory(std::make_unique<BindlessFactory>(*m_bindlessDescriptors, *m_bindlessDrawParams, *m_graphicsPipelineCache, *m_computePipelineCache))
+	, m_textureCache(std::make_unique<TextureCache>(*m_bindlessDescriptors, *m_shaderCache))
 	, m_renderScene(std::make_unique<RenderScene>(*this))
 {
 }
@@ -106,7 +108,10 @@ void Renderer::Update()
 
 void Renderer::Render(vk::CommandBuffer commandBuffer, uint32_t imageIndex)
 {
+	// Streamed mip levels and virtual texture pages are uploaded before the scene samples them
+	m_textureCache->UpdateStreaming(m_commandRingBuffer, GetFrameIndex());
 	m_renderScene->Render();
+	m_textureCache->FinishFrame(m_commandRingBuffer);
 	m_imGui->Render(commandBuffer, imageIndex, *m_swapchain);
 }
 
@@ -151,6 +156,11 @@ gsl::not_null<GraphicsPipelineCache*> Renderer::GetGraphicsPipelineCache() const
 	return m_graphicsPipelineCache.get();
 }
 
+gsl::not_null<ComputePipelineCache*> Renderer::GetComputePipelineCache() const
+{
+	return m_computePipelineCache.get();
+}
+
 gsl::not_null<BindlessDescriptors*> Renderer::GetBindlessDescriptors() const
 {
 	return m_bindlessDescriptors.get();
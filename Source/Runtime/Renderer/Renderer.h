@@ -10,6 +10,7 @@
 
 class BindlessDescriptors;
 class BindlessDrawParams;
+class ComputePipelineCache;
 class ImGuiVulkan;
 class Framebuffer;
 class GraphicsPipelineCache;
@@ -48,6 +49,7 @@ public:
 		std::optional<vk::ClearDepthStencilValue> clearDepthValue = std::nullopt) const;
 
 	gsl::not_null<GraphicsPipelineCache*> GetGraphicsPipelineCache() const;
+	gsl::not_null<ComputePipelineCache*> GetComputePipelineCache() const;
 	gsl::not_null<BindlessDescriptors*> GetBindlessDescriptors() const;
 	gsl::not_null<BindlessDrawParams*> GetBindlessDrawParams() const;
 	gsl::not_null<TextureCache*> GetTextureCache() const;
@@ -57,6 +59,7 @@ protected:
 	vk::Instance m_instance;
 	std::unique_ptr<ShaderCache> m_shaderCache;
 	std::unique_ptr<GraphicsPipelineCache> m_graphicsPipelineCache;
+	std::unique_ptr<ComputePipelineCache> m_computePipelineCache;
 	std::unique_ptr<BindlessDescriptors> m_bindlessDescriptors;
 	std::unique_ptr<BindlessDrawParams> m_bindlessDrawParams;
 	std::unique_ptr<BindlessFactory> m_bindlessFactory; // todo (hbedard): remove that
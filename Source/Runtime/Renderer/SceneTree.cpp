@@ -3,29 +3,180 @@
 #include <Renderer/Bindless.h>
 #include <RHI/CommandRingBuffer.h>
 
-SceneNodeHandle SceneTree::CreateNode(glm::mat4 transform, BoundingBox boundingBox, SceneNodeHandle parent)
+#include <algorithm>
+#include <limits>
+
+namespace
 {
-	SceneNodeHandle id = id_cast<SceneNodeHandle>(m_transforms.size());
-	m_transforms.push_back(std::move(transform));
+	// Distance along the ray where it enters the box, the ray must hit it
+	float ComputeEntryDistance(const BoundingBox& box, glm::vec3 origin, glm::vec3 direction)
+	{
+		const glm::vec3 t0 = (box.min - origin) / direction;
+		const glm::vec3 t1 = (box.max - origin) / direction;
+		const glm::vec3 tMin = (glm::min)(t0, t1);
+		return (std::max)((std::max)(tMin.x, tMin.y), (std::max)(tMin.z, 0.0f));
+	}
+}
+
+SceneNodeHandle SceneTree::CreateNode(glm::mat4 localTransform, BoundingBox boundingBox, SceneNodeHandle parent)
+{
+	SceneNodeHandle id = id_cast<SceneNodeHandle>(m_localTransforms.size());
+
+	// Parents are always laid out before their children
+	assert(parent == SceneNodeHandle::Invalid || parent < id);
+
+	glm::mat4 worldTransform = parent != SceneNodeHandle::Invalid
+		? m_worldTransforms[static_cast<size_t>(parent)] * localTransform
+		: localTransform;
+
+	m_worldBoundingBoxes.push_back(boundingBox.TransformAffine(worldTransform));
+	m_localTransforms.push_back(std::move(localTransform));
+	m_worldTransforms.push_back(std::move(worldTransform));
 	m_boundingBoxes.push_back(std::move(boundingBox));
 	m_parents.push_back(parent);
-    return id;
+	m_isDirty.push_back(false);
+	return id;
+}
+
+void SceneTree::SetLocalTransform(SceneNodeHandle id, glm::mat4 localTransform)
+{
+	size_t index = static_cast<size_t>(id);
+	m_localTransforms[index] = std::move(localTransform);
+	m_isDirty[index] = true;
+	m_firstDirtyIndex = (std::min)(m_firstDirtyIndex, index);
+}
+
+bool SceneTree::Update(uint32_t frameIndex)
+{
+	const bool hasMoved = PropagateTransforms();
+	UploadTransforms(frameIndex);
+	return hasMoved;
+}
+
+bool SceneTree::PropagateTransforms()
+{
+	// Rebuild the hierarchy when nodes were added, otherwise only refit it to what moved
+	if (m_boundingVolumeHierarchy.GetPrimitiveCount() != m_worldBoundingBoxes.size())
+	{
+		m_boundingVolumeHierarchy.Build(m_worldBoundingBoxes);
+		m_sceneBoundingBox = ComputeWorldBoundingBox();
+	}
+
+	m_movedNodes.clear();
+	if (m_firstDirtyIndex >= m_localTransforms.size())
+	{
+		return false; // nothing moved
+	}
+
+	// Children are after their parents so dirty flags propagate
+	// down the hierarchy in a single pass, starting from the first dirty node.
+	const size_t firstIndex = m_firstDirtyIndex;
+	size_t lastIndex = firstIndex;
+	for (size_t i = firstIndex; i < m_localTransforms.size(); ++i)
+	{
+		const SceneNodeHandle parent = m_parents[i];
+		const bool hasParent = parent != SceneNodeHandle::Invalid;
+		const bool isParentDirty = hasParent && m_isDirty[static_cast<size_t>(parent)];
+		if (!m_isDirty[i] && !isParentDirty)
+			continue;
+
+		m_isDirty[i] = true; // so that children are updated too
+		m_worldTransforms[i] = hasParent
+			? m_worldTransforms[static_cast<size_t>(parent)] * m_localTransforms[i]
+			: m_localTransforms[i];
+		m_worldBoundingBoxes[i] = m_boundingBoxes[i].TransformAffine(m_worldTransforms[i]);
+		m_boundingVolumeHierarchy.SetPrimitiveBox(static_cast<uint32_t>(i), m_worldBoundingBoxes[i]);
+		m_movedNodes.push_back(static_cast<uint32_t>(i));
+		lastIndex = i;
+	}
+	std::fill(m_isDirty.begin() + firstIndex, m_isDirty.begin() + lastIndex + 1, false);
+	m_firstDirtyIndex = (std::numeric_limits<size_t>::max)();
+
+	// Buffers of the other frames may still be read by the GPU, they are written when their frame comes
+	for (TransformRange& range : m_pendingTransforms)
+	{
+		range.first = (std::min)(range.first, firstIndex);
+		range.last = (std::max)(range.last, lastIndex);
+	}
+
+	m_boundingVolumeHierarchy.Refit();
+	m_sceneBoundingBox = ComputeWorldBoundingBox();
+
+	return true;
+}
+
+SceneNodeHandle SceneTree::PickNode(glm::vec3 origin, glm::vec3 direction) const
+{
+	std::vector<uint32_t> nodeIndices;
+	m_boundingVolumeHierarchy.QueryRay(origin, direction, (std::numeric_limits<float>::max)(), nodeIndices);
+
+	SceneNodeHandle closestNode = SceneNodeHandle::Invalid;
+	float closestDistance = (std::numeric_limits<float>::max)();
+	for (uint32_t nodeIndex : nodeIndices)
+	{
+		const float distance = ComputeEntryDistance(m_worldBoundingBoxes[nodeIndex], origin, direction);
+		if (distance < closestDistance)
+		{
+			closestDistance = distance;
+			closestNode = id_cast<SceneNodeHandle>(nodeIndex);
+		}
+	}
+	return closestNode;
 }
 
 void SceneTree::UploadToGPU(CommandRingBuffer& commandRingBuffer)
 {
 	// todo (hbedard): not necessarily related to GPU, there could be a prepare function or something
-	m_sceneBoundingBox = ComputeWorldBoundingBox();
+	PropagateTransforms();
 
-	const void* data = reinterpret_cast<const void*>(m_transforms.data());
-	size_t size = m_transforms.size() * sizeof(m_transforms[0]);
+	size_t size = m_worldTransforms.size() * sizeof(m_worldTransforms[0]);
 	vk::BufferCreateInfo bufferInfo({}, size, vk::BufferUsageFlagBits::eStorageBuffer);
 	VmaAllocationCreateInfo allocInfo{ VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU };
-	m_transformsBuffer = std::make_unique<UniqueBuffer>(bufferInfo, allocInfo);
+	for (uint32_t i = 0; i < RHIConstants::kMaxFramesInFlight; ++i)
+	{
+		m_transformsBuffers[i] = std::make_unique<UniqueBuffer>(bufferInfo, allocInfo);
+		m_pendingTransforms[i] = { 0, m_worldTransforms.size() - 1 };
+		UploadTransforms(i);
+
+		m_transformsBufferHandles[i] = m_bindlessDescriptors->StoreBuffer(m_transformsBuffers[i]->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+	}
 
-	size_t writeSize = m_transforms.size() * sizeof(m_transforms[0]);
-	memcpy((char*)m_transformsBuffer->GetMappedData(), m_transforms.data(), writeSize);
-	m_transformsBuffer->Flush(0, writeSize);
+	UploadBounds(commandRingBuffer);
+}
+
+void SceneTree::UploadBounds(CommandRingBuffer& commandRingBuffer)
+{
+	// Local bounds don't change, nodes without geometry get an empty box
+	std::vector<glm::vec4> bounds(2 * (std::max)(m_boundingBoxes.size(), size_t{ 1 }), glm::vec4(0.0f));
+	for (size_t i = 0; i < m_boundingBoxes.size(); ++i)
+	{
+		const BoundingBox& box = m_boundingBoxes[i];
+		if (!box.IsValid())
+			continue;
+
+		bounds[2 * i] = glm::vec4(0.5f * (box.min + box.max), 1.0f); // center
+		bounds[2 * i + 1] = glm::vec4(0.5f * (box.max - box.min), 0.0f); // extent
+	}
+
+	const size_t size = bounds.size() * sizeof(bounds[0]);
+	m_boundsBuffer = std::make_unique<UniqueBufferWithStaging>(size, vk::BufferUsageFlagBits::eStorageBuffer);
+	memcpy(m_boundsBuffer->GetStagingMappedData(), bounds.data(), size);
+	m_boundsBuffer->CopyStagingToGPU(commandRingBuffer.GetCommandBuffer());
+	commandRingBuffer.DestroyAfterSubmit(m_boundsBuffer->ReleaseStagingBuffer());
+
+	m_boundsBufferHandle = m_bindlessDescriptors->StoreBuffer(m_boundsBuffer->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+}
+
+void SceneTree::UploadTransforms(uint32_t frameIndex)
+{
+	TransformRange& range = m_pendingTransforms[frameIndex];
+	if (m_transformsBuffers[frameIndex] == nullptr || m_worldTransforms.empty() || range.first > range.last)
+		return;
 
-	m_transformsBufferHandle = m_bindlessDescriptors->StoreBuffer(m_transformsBuffer->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+	// Only write the range of transforms that changed
+	const size_t writeOffset = range.first * sizeof(m_worldTransforms[0]);
+	const size_t writeSize = (range.last - range.first + 1) * sizeof(m_worldTransforms[0]);
+	memcpy((char*)m_transformsBuffers[frameIndex]->GetMappedData() + writeOffset, &m_worldTransforms[range.first], writeSize);
+	m_transformsBuffers[frameIndex]->Flush(writeOffset, writeSize);
+	range = {};
 }
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <BoundingBox.h>
+#include <BoundingVolumeHierarchy.h>
 #include <Renderer/Bindless.h>
 #include <RHI/Buffers.h>
+#include <RHI/constants.h>
 
 #include <glm_includes.h>
 #include <gsl/pointers>
+#include <array>
 #include <cstdint>
 #include <limits>
 #include <memory>
@@ -21,57 +24,101 @@ EnumType id_cast(NumberType number)
 	return static_cast<EnumType>(number);
 }
 
+// Nodes are stored in creation order and a parent must be created before its children,
+// so a single linear pass over the arrays is enough to propagate transforms.
 class SceneTree
 {
 public:
 	SceneTree(BindlessDescriptors& bindlessDescriptors)
 		: m_bindlessDescriptors(&bindlessDescriptors)
 	{
+		m_transformsBufferHandles.fill(BufferHandle::Invalid);
 	}
 
-	SceneNodeHandle CreateNode(glm::mat4 transform, BoundingBox boundingBox, SceneNodeHandle parent = SceneNodeHandle::Invalid);
+	// transform is relative to the parent node (or to the world if there is no parent)
+	SceneNodeHandle CreateNode(glm::mat4 localTransform, BoundingBox boundingBox, SceneNodeHandle parent = SceneNodeHandle::Invalid);
 
-	size_t GetNodeCount() const { return m_transforms.size(); }
+	size_t GetNodeCount() const { return m_worldTransforms.size(); }
 
 	void UploadToGPU(CommandRingBuffer& commandRingBuffer);
 
-	BufferHandle GetTransformsBufferHandle() const { return m_transformsBufferHandle; }
+	// Recomputes world transforms of dirty nodes and their children and writes the
+	// range modified since the last use of frameIndex to the GPU buffer of that frame.
+	// Returns true if any world transform changed.
+	bool Update(uint32_t frameIndex);
+
+	// One per frame in flight, the buffer of a frame isn't written while the GPU reads another one
+	BufferHandle GetTransformsBufferHandle(uint32_t frameIndex) const { return m_transformsBufferHandles[frameIndex]; }
+
+	// Center and extent of local bounding boxes (NodeBounds in shaders), used for culling and to dequantize vertices
+	BufferHandle GetBoundsBufferHandle() const { return m_boundsBufferHandle; }
 
 	// --- Bounding Box --- //
 
-	BoundingBox ComputeWorldBoundingBox() const
-	{
-		BoundingBox worldBox;
+	// Valid after Update()
+	BoundingBox ComputeWorldBoundingBox() const { return m_boundingVolumeHierarchy.GetBoundingBox(); }
 
-		for (int i = 0; i < m_transforms.size(); ++i)
-		{
-			BoundingBox box = m_boundingBoxes[i];
-			box = box.Transform(m_transforms[i]);
-			worldBox = worldBox.Union(box);
-		}
+	// Built over world bounding boxes, primitive indices are scene node indices.
+	// Valid after Update()
+	const BoundingVolumeHierarchy& GetBoundingVolumeHierarchy() const { return m_boundingVolumeHierarchy; }
 
-		return worldBox;
-	}
+	// Closest node whose world bounding box is hit by the ray, Invalid if none.
+	// Valid after Update()
+	SceneNodeHandle PickNode(glm::vec3 origin, glm::vec3 direction) const;
 
 	// --- Transforms --- //
 
-	glm::mat4 GetTransform(SceneNodeHandle id) const { return m_transforms[static_cast<size_t>(id)]; }
+	void SetLocalTransform(SceneNodeHandle id, glm::mat4 localTransform);
+
+	glm::mat4 GetLocalTransform(SceneNodeHandle id) const { return m_localTransforms[static_cast<size_t>(id)]; }
+
+	// World transform, valid after Update()
+	glm::mat4 GetTransform(SceneNodeHandle id) const { return m_worldTransforms[static_cast<size_t>(id)]; }
 
-	const std::vector<glm::mat4>& GetTransforms() const { return m_transforms; }
+	SceneNodeHandle GetParent(SceneNodeHandle id) const { return m_parents[static_cast<size_t>(id)]; }
+
+	const std::vector<glm::mat4>& GetTransforms() const { return m_worldTransforms; }
 
 	const std::vector<BoundingBox>& GetBoundingBoxes() const { return m_boundingBoxes; }
 
+	// Axis-aligned in world space, valid after Update()
+	const std::vector<BoundingBox>& GetWorldBoundingBoxes() const { return m_worldBoundingBoxes; }
+
+	// Indices of the nodes whose world transform changed during the last Update(), in increasing order
+	const std::vector<uint32_t>& GetMovedNodes() const { return m_movedNodes; }
+
 	const BoundingBox& GetSceneBoundingBox() const { return m_sceneBoundingBox; }
 
 private:
+	// Returns true if any world transform changed
+	bool PropagateTransforms();
+	void UploadTransforms(uint32_t frameIndex);
+	void UploadBounds(CommandRingBuffer& commandRingBuffer);
+
 	// SceneNodeID -> Array Index
-	std::vector<BoundingBox> m_boundingBoxes;
-	std::vector<glm::mat4> m_transforms;
+	std::vector<BoundingBox> m_boundingBoxes; // local
+	std::vector<BoundingBox> m_worldBoundingBoxes;
+	BoundingVolumeHierarchy m_boundingVolumeHierarchy;
+	std::vector<glm::mat4> m_localTransforms;
+	std::vector<glm::mat4> m_worldTransforms;
 	std::vector<SceneNodeHandle> m_parents;
+	std::vector<uint8_t> m_isDirty; // local transform changed since last update
+	std::vector<uint32_t> m_movedNodes;
+	size_t m_firstDirtyIndex = (std::numeric_limits<size_t>::max)();
 	BoundingBox m_sceneBoundingBox;
 
+	// Range of world transforms changed since the buffer of each frame was written
+	struct TransformRange
+	{
+		size_t first = (std::numeric_limits<size_t>::max)();
+		size_t last = 0;
+	};
+	std::array<TransformRange, RHIConstants::kMaxFramesInFlight> m_pendingTransforms;
+
 	// GPU resources
-	std::unique_ptr<UniqueBuffer> m_transformsBuffer{ nullptr }; // buffer of transforms
-	BufferHandle m_transformsBufferHandle = BufferHandle::Invalid;
+	std::array<std::unique_ptr<UniqueBuffer>, RHIConstants::kMaxFramesInFlight> m_transformsBuffers; // buffers of world transforms
+	std::array<BufferHandle, RHIConstants::kMaxFramesInFlight> m_transformsBufferHandles;
+	std::unique_ptr<UniqueBufferWithStaging> m_boundsBuffer{ nullptr };
+	BufferHandle m_boundsBufferHandle = BufferHandle::Invalid;
 	gsl::not_null<BindlessDescriptors*> m_bindlessDescriptors;
 };
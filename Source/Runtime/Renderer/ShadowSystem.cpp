@@ -1,9 +1,12 @@
 #include <Renderer/ShadowSystem.h>
 
 #include <Renderer/ViewProperties.h>
+#include <Renderer/GPUCulling.h>
+#include <Renderer/MeshAllocator.h>
 #include <Renderer/RenderCommandEncoder.h>
 #include <Renderer/Renderer.h>
 #include <Renderer/RenderScene.h>
+#include <Renderer/SceneTree.h>
 
 #include <utility>
 
@@ -12,7 +15,6 @@ namespace
 	struct PushConstants
 	{
 		uint32_t shadowIndex = 0;
-		uint32_t sceneNodeIndex = 0;
 	};
 
 	[[nodiscard]] vk::UniqueSampler CreateSampler(vk::SamplerAddressMode addressMode)
@@ -149,8 +151,7 @@ namespace
 		const Light& light,
 		const Camera& camera,
 		BoundingBox sceneBox,
-		const std::vector<BoundingBox>& boxes,
-		const std::vector<glm::mat4>& transforms)
+		const SceneTree& sceneTree)
 	{
 		// Compute camera frustrum corners
 		std::vector<glm::vec3> camFrustrumPts = camera.ComputeFrustrumCorners();
@@ -174,15 +175,14 @@ namespace
 		camBox_world = camBox_view.Transform(shadowViewInverse);
 
 		// Compute bounding box all objects in the extended camera frustrum
+		std::vector<uint32_t> nodeIndices;
+		sceneTree.GetBoundingVolumeHierarchy().QueryBox(camBox_world, nodeIndices);
+
+		const std::vector<BoundingBox>& worldBoxes = sceneTree.GetWorldBoundingBoxes();
 		BoundingBox lightBox_world;
-		for (int i = 0; i < (int)boxes.size(); ++i)
+		for (uint32_t nodeIndex : nodeIndices)
 		{
-			const BoundingBox& box_local = boxes[i];
-			BoundingBox box_world = box_local.Transform(transforms[i]);
-			if (box_world.Intersects(camBox_world))
-			{
-				lightBox_world = lightBox_world.Union(box_world);
-			}
+			lightBox_world = lightBox_world.Union(worldBoxes[nodeIndex]);
 		}
 
 		// Transform again to the light's local view space
@@ -254,9 +254,23 @@ void ShadowSystem::UploadToGPU(CommandRingBuffer& commandRingBuffer)
 	m_materialShadowsBufferHandle = bindlessDescriptors->StoreBuffer(m_materialShadowsBuffer->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
 
 	gsl::not_null<RenderScene*> renderScene = m_renderer->GetRenderScene();
-	m_drawParams.meshTransforms = renderScene->GetSceneTree()->GetTransformsBufferHandle();
+	m_drawParams.nodeBounds = renderScene->GetSceneTree()->GetBoundsBufferHandle();
+	m_drawParams.positions = renderScene->GetMeshAllocator()->GetPositionsBufferHandle();
 	m_drawParams.shadowViews = bindlessDescriptors->StoreBuffer(m_shadowViewsBuffer->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
-	bindlessDrawParams->DefineParams(m_drawParamsHandle, m_drawParams);
+
+	assert(m_drawDataBufferHandles.size() == RHIConstants::kMaxFramesInFlight);
+	for (uint32_t i = 0; i < RHIConstants::kMaxFramesInFlight; ++i)
+	{
+		ShadowMapDrawParams drawParams = m_drawParams;
+		drawParams.meshTransforms = renderScene->GetSceneTree()->GetTransformsBufferHandle(i);
+		drawParams.drawData = m_drawDataBufferHandles[i];
+		bindlessDrawParams->DefineParams(m_drawParamsHandle, drawParams, i);
+	}
+}
+
+void ShadowSystem::SetDrawDataBufferHandles(gsl::span<const BufferHandle> drawDataBufferHandles)
+{
+	m_drawDataBufferHandles.assign(drawDataBufferHandles.begin(), drawDataBufferHandles.end());
 }
 
 void ShadowSystem::CreateGraphicsPipeline()
@@ -265,7 +279,8 @@ void ShadowSystem::CreateGraphicsPipeline()
 	ShaderCache& shaderCache = graphicsPipelineCache->GetShaderCache();
 	ShaderID vertexShaderID = shaderCache.CreateShader(kVertexShaderFile.GetPathOnDisk());
 	ShaderID fragmentShaderID = shaderCache.CreateShader(kFragmentShaderFile.GetPathOnDisk());
-	ShaderInstanceID vertexShaderInstanceID = shaderCache.CreateShaderInstance(vertexShaderID);
+	const MeshAllocator& meshAllocator = *m_renderer->GetRenderScene()->GetMeshAllocator();
+	ShaderInstanceID vertexShaderInstanceID = meshAllocator.CreateVertexShaderInstance(shaderCache, vertexShaderID);
 	ShaderInstanceID fragmentShaderInstanceID = shaderCache.CreateShaderInstance(fragmentShaderID);
 	m_graphicsPipelineID = graphicsPipelineCache->CreateGraphicsPipeline(
 		vertexShaderInstanceID,
@@ -285,7 +300,6 @@ void ShadowSystem::Update(const Camera& camera, BoundingBox sceneBoundingBox)
 	gsl::not_null<SceneTree*> sceneTree = renderScene->GetSceneTree();
 	gsl::not_null<LightSystem*> lightSystem = renderScene->GetLightSystem();
 
-	m_drawParams.meshTransforms = sceneTree->GetTransformsBufferHandle();
 	BoundingBox sceneBox = sceneTree->ComputeWorldBoundingBox();
 
 	for (ShadowID id = 0; id < m_lights.size(); ++id)
@@ -296,8 +310,7 @@ void ShadowSystem::Update(const Camera& camera, BoundingBox sceneBoundingBox)
 			lightSystem->GetLight(id),
 			camera,
 			sceneBox,
-			sceneTree->GetBoundingBoxes(),
-			sceneTree->GetTransforms()
+			*sceneTree
 		);
 
 		m_materialShadows[id].transform = m_shadowViews[id].proj * m_shadowViews[id].view;
@@ -316,7 +329,7 @@ void ShadowSystem::Update(const Camera& camera, BoundingBox sceneBoundingBox)
 	}
 }
 
-void ShadowSystem::Render(const std::vector<MeshDrawInfo> drawCommands) const
+void ShadowSystem::Render(const GPUCulling& gpuCulling) const
 {
 	if (GetShadowCount() == 0)
 	{
@@ -336,9 +349,6 @@ void ShadowSystem::Render(const std::vector<MeshDrawInfo> drawCommands) const
 	renderCommandEncoder.BindBindlessDescriptorSet(bindlessDescriptors->GetPipelineLayout(), bindlessDescriptors->GetDescriptorSet());
 	renderCommandEncoder.BindDrawParams(m_drawParamsHandle);
 
-	// Bind the one big vertex + index buffers
-	meshAllocator->BindGeometry(commandBuffer);
-
 	for (ShadowID id = 0; id < (ShadowID)m_depthImages.size(); ++id)
 	{
 		RenderingInfo renderingInfo = GetRenderingInfo(m_depthImages[id]->GetImageView(), m_shadowMapExtent);
@@ -355,18 +365,11 @@ void ShadowSystem::Render(const std::vector<MeshDrawInfo> drawCommands) const
 				offsetof(PushConstants, shadowIndex), sizeof(PushConstants::shadowIndex), &shadowIndex
 			);
 
-			for (const auto& drawItem : drawCommands)
+			// Scene node indices are fetched from the draw data buffer, one batch per index buffer
+			for (vk::IndexType indexType : { vk::IndexType::eUint32, vk::IndexType::eUint16 })
 			{
-				uint32_t sceneNodeIndex = static_cast<uint32_t>(drawItem.sceneNodeID);
-
-				// Set model index push constant
-				commandBuffer.pushConstants(
-					pipelineLayout,
-					vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-					offsetof(PushConstants, sceneNodeIndex), sizeof(PushConstants::sceneNodeIndex), &sceneNodeIndex
-				);
-
-				commandBuffer.drawIndexed(drawItem.mesh.nbIndices, 1, drawItem.mesh.indexOffset, 0, 0);
+				meshAllocator->BindIndices(commandBuffer, indexType);
+				renderCommandEncoder.DrawIndexedIndirectCount(gpuCulling.GetShadowDraw(m_renderer->GetFrameIndex(), id, indexType));
 			}
 		}
 		commandBuffer.endRendering();
@@ -18,6 +18,7 @@
 #include <glm_includes.h>
 #include <vulkan/vulkan.hpp>
 #include <gsl/pointers>
+#include <gsl/span>
 
 #include <limits>
 
@@ -27,6 +28,7 @@ struct CombinedImageSampler;
 class CommandRingBuffer;
 class RenderCommandEncoder;
 class Renderer;
+class GPUCulling;
 
 struct ShadowData
 {
@@ -51,7 +53,15 @@ public:
 	
 	void Update(const Camera& camera, BoundingBox sceneBoundingBox);
 
-	void Render(const std::vector<MeshDrawInfo> drawCommands) const;
+	// Draws visible from each shadow view, gpuCulling must have been dispatched for the current frame
+	void Render(const GPUCulling& gpuCulling) const;
+
+	// One per frame in flight
+	void SetDrawDataBufferHandles(gsl::span<const BufferHandle> drawDataBufferHandles);
+
+	// Shadow views draw meshes this many levels of detail coarser than the camera
+	void SetLodBias(uint32_t lodBias) { m_lodBias = lodBias; }
+	uint32_t GetLodBias() const { return m_lodBias; }
 
 	size_t GetShadowCount() const { return m_lights.size(); }
 
@@ -81,9 +91,13 @@ private:
 	{
 		BufferHandle meshTransforms = BufferHandle::Invalid;
 		BufferHandle shadowViews = BufferHandle::Invalid;
-		uint32_t padding[2] = { 0 , 0 };
+		BufferHandle drawData = BufferHandle::Invalid;
+		BufferHandle nodeBounds = BufferHandle::Invalid;
+		BufferHandle positions = BufferHandle::Invalid;
+		uint32_t padding[3] = { 0, 0, 0 };
 	};
 	ShadowMapDrawParams m_drawParams = {};
+	std::vector<BufferHandle> m_drawDataBufferHandles;
 	BindlessDrawParamsHandle m_drawParamsHandle = BindlessDrawParamsHandle::Invalid;
 
 	static const AssetPath kVertexShaderFile;
@@ -91,6 +105,7 @@ private:
 
 	vk::Format m_depthFormat;
 	vk::Extent2D m_shadowMapExtent;
+	uint32_t m_lodBias = 1;
 	gsl::not_null<Renderer*> m_renderer;
 
 	// ShadowID -> Array index
@@ -1,57 +1,306 @@
 #include <Renderer/TextureCache.h>
 
+#include <Renderer/Ktx2File.h>
 #include <RHI/Texture.h>
 #include <RHI/CommandRingBuffer.h>
+#include <RHI/Device.h>
+#include <RHI/PhysicalDevice.h>
+#include <RHI/constants.h>
+#include <TextureCompression.h>
+#include <file_utils.h>
 #include <hash.h>
 #include <stb_image.h>
 
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <format>
 #include <iostream>
+#include <numeric>
 #include <tinyexr.h>
+#include <glm/gtc/packing.hpp>
 
 namespace TextureCache_Private
 {
-	struct TinyExrData
+	// Parsed header of an EXR file, freed on destruction
+	struct ExrHeader
 	{
-		TinyExrData(const std::filesystem::path& filePath)
+		ExrHeader(const std::string& filePath)
 		{
-			std::string filePathStr = filePath.string();
-			result = LoadEXR(&data, &width, &height, filePathStr.c_str(), &errorMessage);
-			if (result != TINYEXR_SUCCESS)
+			InitEXRHeader(&header);
+			EXRVersion version = {};
+			const char* errorMessage = nullptr;
+			isValid = ParseEXRVersionFromFile(&version, filePath.c_str()) == TINYEXR_SUCCESS &&
+				ParseEXRHeaderFromFile(&header, &version, filePath.c_str(), &errorMessage) == TINYEXR_SUCCESS;
+			if (!isValid)
 			{
-				data = nullptr;
-				std::cerr << "could not load '" << filePathStr << "'" << std::endl;
+				std::cerr << "could not load '" << filePath << "'" << (errorMessage != nullptr ? ": " : "") << (errorMessage != nullptr ? errorMessage : "") << std::endl;
+				FreeEXRErrorMessage(errorMessage);
 			}
 		}
 
-		~TinyExrData()
+		~ExrHeader() { FreeEXRHeader(&header); }
+
+		ExrHeader(const ExrHeader&) = delete;
+		ExrHeader& operator=(const ExrHeader&) = delete;
+
+		int GetWidth() const { return header.data_window.max_x - header.data_window.min_x + 1; }
+		int GetHeight() const { return header.data_window.max_y - header.data_window.min_y + 1; }
+
+		EXRHeader header;
+		bool isValid = false;
+	};
+
+	// Decodes the RGBA channels of an EXR file to half floats in dst, width * height * RGBA. Missing channels are 0,
+	// or 1 for alpha. Scanline blocks or tiles are decoded in parallel by tinyexr (TINYEXR_USE_THREAD).
+	bool DecodeExrToHalf(const std::string& filePath, int width, int height, uint16_t* dst)
+	{
+		ExrHeader exr(filePath);
+		if (!exr.isValid)
+			return false;
+
+		// Half channels are kept as is, float channels are converted when copied
+		EXRHeader& header = exr.header;
+		for (int i = 0; i < header.num_channels; ++i)
+		{
+			if (header.pixel_types[i] == TINYEXR_PIXELTYPE_HALF)
+				header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_HALF;
+		}
+
+		EXRImage image;
+		InitEXRImage(&image);
+		const char* errorMessage = nullptr;
+		if (LoadEXRImageFromFile(&image, &header, filePath.c_str(), &errorMessage) != TINYEXR_SUCCESS)
+		{
+			std::cerr << "could not decode '" << filePath << "': " << (errorMessage != nullptr ? errorMessage : "") << std::endl;
+			FreeEXRErrorMessage(errorMessage);
+			return false;
+		}
+
+		const bool isValid = image.width == width && image.height == height;
+		if (isValid)
 		{
-			if (data != nullptr)
+			constexpr const char* kChannelNames[4] = { "R", "G", "B", "A" };
+			int channelIndices[4] = { -1, -1, -1, -1 };
+			for (int i = 0; i < header.num_channels; ++i)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					if (strcmp(header.channels[i].name, kChannelNames[c]) == 0)
+						channelIndices[c] = i;
+				}
+			}
+
+			// Copies a block of pixels stored per channel, blockX and blockY are in pixels
+			auto copyBlock = [&](unsigned char** channels, int blockX, int blockY, int blockWidth, int blockHeight) {
+				for (int y = 0; y < blockHeight && blockY + y < height; ++y)
+				{
+					uint16_t* dstRow = dst + (size_t(blockY + y) * width + blockX) * 4;
+					for (int x = 0; x < blockWidth && blockX + x < width; ++x)
+					{
+						const size_t srcIndex = size_t(y) * blockWidth + x;
+						for (int c = 0; c < 4; ++c)
+						{
+							const int channel = channelIndices[c];
+							uint16_t value = c == 3 ? glm::packHalf1x16(1.0f) : 0;
+							if (channel >= 0 && header.requested_pixel_types[channel] == TINYEXR_PIXELTYPE_HALF)
+								value = reinterpret_cast<const uint16_t*>(channels[channel])[srcIndex];
+							else if (channel >= 0 && header.requested_pixel_types[channel] == TINYEXR_PIXELTYPE_FLOAT)
+								value = glm::packHalf1x16(reinterpret_cast<const float*>(channels[channel])[srcIndex]);
+							dstRow[x * 4 + c] = value;
+						}
+					}
+				}
+			};
+
+			if (header.tiled)
 			{
-				free(data);
-				data = nullptr;
+				for (int i = 0; i < image.num_tiles; ++i)
+				{
+					const EXRTile& tile = image.tiles[i];
+					copyBlock(tile.images, tile.offset_x * header.tile_size_x, tile.offset_y * header.tile_size_y, header.tile_size_x, header.tile_size_y);
+				}
 			}
+			else
+			{
+				copyBlock(image.images, 0, 0, width, height);
+			}
+		}
+		else
+		{
+			std::cerr << "could not decode '" << filePath << "': the size changed" << std::endl;
 		}
 
-		const char* errorMessage = nullptr;
-		float* data = nullptr; // width * height * RGBA
-		int32_t width = 0;
-		int32_t height = 0;
-		int32_t result = 0;
+		FreeEXRImage(&image);
+		return isValid;
+	}
+
+	struct TextureFormat
+	{
+		vk::Format format;
+		uint32_t channelCount;
+		bool is16Bit;
 	};
+
+	vk::Format GetSrgbFormat(vk::Format format)
+	{
+		switch (format)
+		{
+		case vk::Format::eBc1RgbUnormBlock: return vk::Format::eBc1RgbSrgbBlock;
+		case vk::Format::eBc1RgbaUnormBlock: return vk::Format::eBc1RgbaSrgbBlock;
+		case vk::Format::eBc3UnormBlock: return vk::Format::eBc3SrgbBlock;
+		case vk::Format::eBc7UnormBlock: return vk::Format::eBc7SrgbBlock;
+		default: return format;
+		}
+	}
+
+	// Color is kept in 8 bits even for 16-bit files, there is no 16-bit sRGB format and 8-bit sRGB is enough for colors
+	TextureFormat GetUsageTextureFormat(TextureUsage usage, bool isFile16Bit)
+	{
+		switch (usage)
+		{
+		case TextureUsage::eColor:
+			return { vk::Format::eR8G8B8A8Srgb, 4, false };
+		case TextureUsage::eNormals:
+			return isFile16Bit ? TextureFormat{ vk::Format::eR16G16Unorm, 2, true } : TextureFormat{ vk::Format::eR8G8Unorm, 2, false };
+		case TextureUsage::eMask:
+			return isFile16Bit ? TextureFormat{ vk::Format::eR16Unorm, 1, true } : TextureFormat{ vk::Format::eR8Unorm, 1, false };
+		case TextureUsage::eData:
+		default:
+			return isFile16Bit ? TextureFormat{ vk::Format::eR16G16B16A16Unorm, 4, true } : TextureFormat{ vk::Format::eR8G8B8A8Unorm, 4, false };
+		}
+	}
+
+	// Mip levels are generated by a compute shader writing to the texture, or blitted from one level to the next
+	vk::ImageUsageFlags GetMipGenerationUsage(vk::Format format, uint32_t width, uint32_t height, uint32_t layerCount = 1)
+	{
+		return MipGenerator::IsSupported(format, width, height, layerCount) ?
+			vk::ImageUsageFlagBits::eStorage :
+			vk::ImageUsageFlagBits::eTransferSrc;
+	}
+
+	BlockFormat GetUsageBlockFormat(TextureUsage usage, TextureCompression compression, bool hasAlpha)
+	{
+		switch (usage)
+		{
+		case TextureUsage::eColor:
+			return compression == TextureCompression::eHighQuality ? BlockFormat::eBC7 : hasAlpha ? BlockFormat::eBC3 : BlockFormat::eBC1;
+		case TextureUsage::eNormals:
+			return BlockFormat::eBC5;
+		case TextureUsage::eMask:
+			return BlockFormat::eBC4;
+		case TextureUsage::eData:
+		default:
+			return compression == TextureCompression::eHighQuality ? BlockFormat::eBC7 : BlockFormat::eBC1;
+		}
+	}
+
+	// Streamed textures start with their levels of at most kStartupMipSize texels
+	constexpr uint32_t kStartupMipSize = 64;
+
+	// Streamed textures no longer requested keep their levels for a while, e.g. when turning the camera back and forth
+	constexpr uint64_t kMipEvictionDelay = 120; // frames
+
+	// Limits the staging memory of streamed levels
+	constexpr size_t kMaxStreamingJobCount = 16;
+
+	uint32_t GetStartupLevel(const Ktx2File& file)
+	{
+		uint32_t level = 0;
+		while (level + 1 < file.GetLevelCount() && (std::max)(file.GetWidth() >> level, file.GetHeight() >> level) > kStartupMipSize)
+			++level;
+		return level;
+	}
+
+	// Size of mip levels [firstLevel, end) in video memory, block-compressed levels are not padded
+	vk::DeviceSize GetLevelsSize(const Ktx2File& file, uint32_t firstLevel)
+	{
+		vk::DeviceSize size = 0;
+		for (uint32_t level = firstLevel; level < file.GetLevelCount(); ++level)
+			size += file.GetLevelSize(level);
+		return size;
+	}
+
+	// Replaced by a streamed texture, frames in flight may still sample it
+	struct RetiredTexture : public DeferredDestructible
+	{
+		explicit RetiredTexture(std::unique_ptr<Texture> texture) : texture(std::move(texture)) {}
+
+		std::unique_ptr<Texture> texture;
+	};
+
+	vk::Format GetBlockVkFormat(BlockFormat format, bool isSrgb)
+	{
+		switch (format)
+		{
+		case BlockFormat::eBC1: return isSrgb ? vk::Format::eBc1RgbSrgbBlock : vk::Format::eBc1RgbUnormBlock;
+		case BlockFormat::eBC3: return isSrgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+		case BlockFormat::eBC4: return vk::Format::eBc4UnormBlock;
+		case BlockFormat::eBC5: return vk::Format::eBc5UnormBlock;
+		case BlockFormat::eBC7:
+		default:
+			return isSrgb ? vk::Format::eBc7SrgbBlock : vk::Format::eBc7UnormBlock;
+		}
+	}
 }
 
-TextureHandle TextureCache::LoadTexture(const AssetPath& assetPath)
+TextureCache::TextureCache(BindlessDescriptors& bindlessDescriptors, ShaderCache& shaderCache)
+	: m_bindlessDescriptors(&bindlessDescriptors)
+	, m_shaderCache(&shaderCache)
+	, m_textureSlots(BindlessDescriptors::kMaxDescriptorCount)
 {
-	return CreateAndUploadTextureImage(assetPath);
+	// Textures are sampled through the slot of their handle until they are streamed
+	std::iota(m_textureSlots.begin(), m_textureSlots.end(), 0u);
+	m_textureSlotsBuffer = std::make_unique<UniqueBuffer>(
+		vk::BufferCreateInfo({}, m_textureSlots.size() * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst),
+		VmaAllocationCreateInfo{ {}, VMA_MEMORY_USAGE_GPU_ONLY }
+	);
+	m_textureSlotsBufferHandle = m_bindlessDescriptors->StoreBuffer(m_textureSlotsBuffer->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
 }
 
-// todo (hbedard): consider using the KTX format for textures
-TextureHandle TextureCache::CreateAndUploadTextureImage(const AssetPath& assetPath)
+void TextureCache::SetCompression(TextureCompression compression, std::filesystem::path cacheDirectory)
 {
-	// Check if we already loaded this texture
+	// BC formats are supported together (textureCompressionBC)
+	const vk::FormatProperties formatProperties = g_physicalDevice->Get().getFormatProperties(vk::Format::eBc7SrgbBlock);
+	if (compression != TextureCompression::eNone && !(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage))
+	{
+		std::cerr << "block-compressed formats are not supported by the device, textures are not compressed" << std::endl;
+		compression = TextureCompression::eNone;
+	}
+
+	m_compression = compression;
+	m_compressionCacheDirectory = std::move(cacheDirectory);
+}
+
+void TextureCache::EnableVirtualTexturing()
+{
+	if (m_virtualTextureCache == nullptr)
+		m_virtualTextureCache = std::make_unique<VirtualTextureCache>(*m_bindlessDescriptors);
+}
+
+BufferHandle TextureCache::GetVirtualTextureBufferHandle() const
+{
+	return m_virtualTextureCache != nullptr ? m_virtualTextureCache->GetPageTableBufferHandle() : BufferHandle::Invalid;
+}
+
+gsl::span<const BufferHandle> TextureCache::GetTextureFeedbackBufferHandles() const
+{
+	if (m_virtualTextureCache == nullptr)
+		return {};
+	return m_virtualTextureCache->GetFeedbackBufferHandles();
+}
+
+TextureHandle TextureCache::LoadTexture(const AssetPath& assetPath, TextureUsage usage)
+{
+	return CreateAndUploadTextureImage(assetPath, usage);
+}
+
+TextureHandle TextureCache::CreateAndUploadTextureImage(const AssetPath& assetPath, TextureUsage usage)
+{
+	// Check if we already loaded this texture, a file can be loaded once per usage since the format differs
 	std::string filePathStr = assetPath.GetPathOnDisk().string();
-	uint64_t fileHash = fnv_hash_data(reinterpret_cast<uint8_t*>(filePathStr.data()), filePathStr.size());
+	uint64_t fileHash = fnv_hash(usage, fnv_hash_data(reinterpret_cast<uint8_t*>(filePathStr.data()), filePathStr.size()));
 	auto cachedTexture = m_fileHashToTextureHandle.find(fileHash);
 	if (cachedTexture != m_fileHashToTextureHandle.end()) {
 		assert(m_fileHashToFileName.at(fileHash) == filePathStr);
@@ -62,32 +311,17 @@ TextureHandle TextureCache::CreateAndUploadTextureImage(const AssetPath& assetPa
 	assert(!m_fileHashToFileName.contains(fileHash));
 	m_fileHashToFileName[fileHash] = filePathStr;
 
-	// Read image from file (16 bits if possible, otherwise upsample)
-	int texWidth = 0, texHeight = 0, texChannels = 0;
-	stbi_us* pixels = stbi_load_16(filePathStr.data(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	if (pixels == nullptr || texWidth == 0 || texHeight == 0 || texChannels == 0) {
-		throw std::runtime_error("failed to load texture image!");
-	}
-
-	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2((std::max)(texWidth, texHeight)))) + 1;
+	// Only the header is read here, the texture is filled by worker threads until UploadTextures()
+	std::optional<Ktx2File> streamedFile;
+	std::unique_ptr<Texture> newTexture = assetPath.GetPathOnDisk().extension() == ".ktx2" ?
+		CreateKtx2Texture(filePathStr, usage, streamedFile) :
+		CreateDecodedTexture(filePathStr, usage, streamedFile);
 
 	// Texture image
 	size_t imageViewTypeIndex = (size_t)ImageViewType::e2D;
 
 	uint32_t textureIndex = m_textures[imageViewTypeIndex].size();
-	m_textures[imageViewTypeIndex].push_back(
-		std::make_unique<Texture>(
-			texWidth, texHeight, static_cast<uint32_t>(4UL * sizeof(stbi_us)),
-			GetTextureFormat(),
-			vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eTransferSrc |
-			vk::ImageUsageFlagBits::eTransferDst | // src and dst for mipmaps blit
-			vk::ImageUsageFlagBits::eSampled,
-			vk::ImageAspectFlagBits::eColor,
-			vk::ImageViewType::e2D,
-			mipLevels
-		)
-	);
+	m_textures[imageViewTypeIndex].push_back(std::move(newTexture));
 	TextureKey key = { ImageViewType::e2D, textureIndex };
 	auto& texture = m_textures[imageViewTypeIndex][textureIndex];
 	m_texturesToUpload.push_back(key);
@@ -95,16 +329,236 @@ TextureHandle TextureCache::CreateAndUploadTextureImage(const AssetPath& assetPa
 	m_names[imageViewTypeIndex].push_back(filePathStr.data());
 	m_imageTypeCount[(size_t)ImageViewType::e2D]++;
 
-	memcpy(texture->GetStagingMappedData(), reinterpret_cast<const void*>(pixels), (size_t)texWidth* texHeight * 4 * sizeof(stbi_us));
-	stbi_image_free(pixels);
-
 	vk::Sampler sampler = CreateSampler(texture->GetMipLevels());
 	TextureHandle textureHandle = m_bindlessDescriptors->StoreTexture(texture->GetImageView(), std::move(sampler));
 	m_textureHandleToKey.emplace(textureHandle, key);
 	m_fileHashToTextureHandle.emplace(fileHash, textureHandle);
+
+	if (streamedFile.has_value())
+	{
+		const bool isVirtual = m_virtualTextureCache != nullptr && VirtualTextureCache::GetVirtualLevelCount(*streamedFile) > 0;
+		if (isVirtual && m_virtualTextureCache->AddTexture(textureHandle, *streamedFile, texture->GetFormat()))
+			return textureHandle;
+
+		const uint32_t coarsestLevel = streamedFile->GetLevelCount() - texture->GetMipLevels();
+		m_streamedTextures.emplace(textureHandle, StreamedTexture{
+			.file = std::move(*streamedFile),
+			.textureIndex = textureIndex,
+			.coarsestLevel = coarsestLevel,
+			.residentLevel = coarsestLevel,
+		});
+	}
 	return textureHandle;
 }
 
+std::unique_ptr<Texture> TextureCache::CreateDecodedTexture(const std::string& filePath, TextureUsage usage, std::optional<Ktx2File>& streamedFile)
+{
+	using namespace TextureCache_Private;
+
+	if (m_compression != TextureCompression::eNone)
+		return CreateCompressedTexture(filePath, usage, streamedFile);
+
+	int texWidth = 0, texHeight = 0, texChannels = 0;
+	if (!stbi_info(filePath.data(), &texWidth, &texHeight, &texChannels) || texWidth == 0 || texHeight == 0 || texChannels == 0) {
+		throw std::runtime_error("failed to load texture image!");
+	}
+	const TextureFormat textureFormat = GetUsageTextureFormat(usage, stbi_is_16_bit(filePath.data()) != 0);
+	const uint32_t bytesPerChannel = textureFormat.is16Bit ? sizeof(stbi_us) : sizeof(stbi_uc);
+
+	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2((std::max)(texWidth, texHeight)))) + 1;
+
+	auto texture = std::make_unique<Texture>(
+		texWidth, texHeight, textureFormat.channelCount * bytesPerChannel,
+		textureFormat.format,
+		vk::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eTransferDst |
+		vk::ImageUsageFlagBits::eSampled |
+		GetMipGenerationUsage(textureFormat.format, texWidth, texHeight),
+		vk::ImageAspectFlagBits::eColor,
+		vk::ImageViewType::e2D,
+		mipLevels
+	);
+
+	DecodeTextureAsync(filePath, texture->GetStagingMappedData(), texWidth, texHeight, textureFormat.channelCount, textureFormat.is16Bit);
+	return texture;
+}
+
+std::unique_ptr<Texture> TextureCache::CreateKtx2Texture(const std::string& filePath, TextureUsage usage, std::optional<Ktx2File>& streamedFile)
+{
+	using namespace TextureCache_Private;
+
+	Ktx2File file(filePath);
+
+	// Color textures are sampled as linear values
+	const vk::Format format = usage == TextureUsage::eColor ? GetSrgbFormat(file.GetFormat()) : file.GetFormat();
+	if (!(g_physicalDevice->Get().getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage))
+		throw std::runtime_error("block-compressed format of '" + filePath + "' is not supported by the device");
+
+	// Virtual textures keep the levels smaller than a page, their pages are loaded on demand
+	const uint32_t virtualLevelCount = m_virtualTextureCache != nullptr ? VirtualTextureCache::GetVirtualLevelCount(file) : 0;
+	const uint32_t startupLevel = virtualLevelCount > 0 ? virtualLevelCount : GetStartupLevel(file);
+	std::unique_ptr<Texture> texture = CreateKtx2TextureLevels(file, format, startupLevel);
+	if (startupLevel > 0)
+		streamedFile = std::move(file);
+	return texture;
+}
+
+std::unique_ptr<Texture> TextureCache::CreateKtx2TextureLevels(const Ktx2File& file, vk::Format format, uint32_t firstLevel, std::atomic<bool>* isLoaded)
+{
+	// Mip levels are packed in the staging buffer, their sizes are multiples of the block size which keeps copies aligned
+	std::vector<vk::DeviceSize> mipOffsets(file.GetLevelCount() - firstLevel);
+	vk::DeviceSize stagingSize = 0;
+	for (uint32_t level = firstLevel; level < file.GetLevelCount(); ++level)
+	{
+		mipOffsets[level - firstLevel] = stagingSize;
+		stagingSize += file.GetLevelSize(level);
+	}
+
+	auto texture = std::make_unique<Texture>(
+		(std::max)(file.GetWidth() >> firstLevel, 1u), (std::max)(file.GetHeight() >> firstLevel, 1u),
+		format,
+		vk::ImageUsageFlagBits::eSampled,
+		mipOffsets,
+		stagingSize
+	);
+
+	if (m_decodeWorkers == nullptr)
+		m_decodeWorkers = std::make_unique<WorkerPool>();
+
+	m_decodeWorkers->Submit([file, mipOffsets = std::move(mipOffsets), stagingData = texture->GetStagingMappedData(), stagingSize, firstLevel, isLoaded]() {
+		if (!file.ReadLevels(stagingData, mipOffsets, firstLevel))
+			memset(stagingData, 0, stagingSize); // upload a black texture on error
+		if (isLoaded != nullptr)
+			isLoaded->store(true, std::memory_order_release);
+	});
+	return texture;
+}
+
+std::unique_ptr<Texture> TextureCache::CreateCompressedTexture(const std::string& filePath, TextureUsage usage, std::optional<Ktx2File>& streamedFile)
+{
+	using namespace TextureCache_Private;
+
+	// Cached files are named after the content of the source and everything that changes the encoded data
+	std::vector<char> source = file_utils::ReadFile(filePath);
+	uint64_t sourceHash = fnv_hash_data(reinterpret_cast<const uint8_t*>(source.data()), source.size());
+	sourceHash = fnv_hash(usage, sourceHash);
+	sourceHash = fnv_hash(m_compression, sourceHash);
+	sourceHash = fnv_hash(kTextureEncoderVersion, sourceHash);
+	std::filesystem::path cachePath = m_compressionCacheDirectory / std::format("{:016x}.ktx2", sourceHash);
+	if (std::filesystem::exists(cachePath))
+	{
+		try
+		{
+			return CreateKtx2Texture(cachePath.string(), usage, streamedFile);
+		}
+		catch (const std::runtime_error& error)
+		{
+			std::cerr << "encoding '" << filePath << "' again: " << error.what() << std::endl;
+		}
+	}
+
+	int texWidth = 0, texHeight = 0, texChannels = 0;
+	const auto* sourceData = reinterpret_cast<const stbi_uc*>(source.data());
+	if (!stbi_info_from_memory(sourceData, static_cast<int>(source.size()), &texWidth, &texHeight, &texChannels) || texWidth == 0 || texHeight == 0 || texChannels == 0) {
+		throw std::runtime_error("failed to load texture image!");
+	}
+
+	const bool isSrgb = usage == TextureUsage::eColor;
+	const bool hasAlpha = texChannels == STBI_grey_alpha || texChannels == STBI_rgb_alpha;
+	const BlockFormat blockFormat = GetUsageBlockFormat(usage, m_compression, hasAlpha);
+	const vk::Format format = GetBlockVkFormat(blockFormat, isSrgb);
+
+	const uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2((std::max)(texWidth, texHeight)))) + 1;
+	std::vector<vk::DeviceSize> mipOffsets(mipLevels);
+	vk::DeviceSize stagingSize = 0;
+	for (uint32_t level = 0; level < mipLevels; ++level)
+	{
+		mipOffsets[level] = stagingSize;
+		stagingSize += GetEncodedImageSize(blockFormat, (std::max)(texWidth >> level, 1), (std::max)(texHeight >> level, 1));
+	}
+
+	auto texture = std::make_unique<Texture>(texWidth, texHeight, format, vk::ImageUsageFlagBits::eSampled, mipOffsets, stagingSize);
+
+	if (m_decodeWorkers == nullptr)
+		m_decodeWorkers = std::make_unique<WorkerPool>();
+
+	m_decodeWorkers->Submit([=, source = std::move(source), cachePath = std::move(cachePath), stagingData = texture->GetStagingMappedData()]() {
+		int width = 0, height = 0, channels = 0;
+		stbi_uc* pixels = stbi_load_from_memory(
+			reinterpret_cast<const stbi_uc*>(source.data()), static_cast<int>(source.size()), &width, &height, &channels, STBI_rgb_alpha);
+		if (pixels == nullptr || width != texWidth || height != texHeight)
+		{
+			std::cerr << "could not decode '" << filePath << "'" << std::endl;
+			memset(stagingData, 0, stagingSize); // upload a black texture on error
+			stbi_image_free(pixels);
+			return;
+		}
+		std::vector<uint8_t> image(pixels, pixels + size_t{ static_cast<uint32_t>(width) } * height * STBI_rgb_alpha);
+		stbi_image_free(pixels);
+
+		// Encoded in memory first, the staging buffer can be slow to read back from
+		std::vector<std::byte> encoded(stagingSize);
+		uint32_t levelWidth = width, levelHeight = height;
+		for (uint32_t level = 0; level < mipLevels; ++level)
+		{
+			if (level > 0)
+			{
+				image = DownsampleImage(image, levelWidth, levelHeight, isSrgb);
+				levelWidth = (std::max)(levelWidth / 2, 1u);
+				levelHeight = (std::max)(levelHeight / 2, 1u);
+			}
+			const size_t levelSize = GetEncodedImageSize(blockFormat, levelWidth, levelHeight);
+			EncodeBlocks(blockFormat, image, levelWidth, levelHeight, gsl::span(encoded).subspan(mipOffsets[level], levelSize));
+		}
+		memcpy(stagingData, encoded.data(), encoded.size());
+
+		std::error_code error;
+		std::filesystem::create_directories(cachePath.parent_path(), error);
+		if (!Ktx2File::Write(cachePath, format, width, height, encoded, mipOffsets))
+			std::cerr << "could not write '" << cachePath.string() << "'" << std::endl;
+	});
+	return texture;
+}
+
+void TextureCache::DecodeTextureAsync(std::string filePath, void* stagingData, int width, int height, uint32_t channelCount, bool is16Bit)
+{
+	if (m_decodeWorkers == nullptr)
+		m_decodeWorkers = std::make_unique<WorkerPool>();
+
+	m_decodeWorkers->Submit([filePath = std::move(filePath), stagingData, width, height, channelCount, is16Bit]() {
+		// Read image from file as RGBA, fewer channels requested from stb would be converted to luminance
+		int texWidth = 0, texHeight = 0, texChannels = 0;
+		void* pixels = is16Bit ?
+			static_cast<void*>(stbi_load_16(filePath.data(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha)) :
+			static_cast<void*>(stbi_load(filePath.data(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha));
+		const size_t pixelCount = (size_t)width * height;
+		const size_t bytesPerChannel = is16Bit ? sizeof(stbi_us) : sizeof(stbi_uc);
+		const size_t dstPixelSize = channelCount * bytesPerChannel;
+		if (pixels != nullptr && texWidth == width && texHeight == height)
+		{
+			if (channelCount == STBI_rgb_alpha)
+			{
+				memcpy(stagingData, pixels, pixelCount * dstPixelSize);
+			}
+			else
+			{
+				// Keep the first channels of each pixel
+				const size_t srcPixelSize = STBI_rgb_alpha * bytesPerChannel;
+				const auto* src = static_cast<const std::byte*>(pixels);
+				auto* dst = static_cast<std::byte*>(stagingData);
+				for (size_t i = 0; i < pixelCount; ++i)
+					memcpy(dst + i * dstPixelSize, src + i * srcPixelSize, dstPixelSize);
+			}
+		}
+		else
+		{
+			std::cerr << "could not decode '" << filePath << "'" << std::endl;
+			memset(stagingData, 0, pixelCount * dstPixelSize); // upload a black texture on error
+		}
+		stbi_image_free(pixels);
+	});
+}
+
 // todo (hbedard): there's a lot of copy paste with a standard 2D texture (it's just that it's a float that changes something
 TextureHandle TextureCache::LoadHdri(const AssetPath& exrPath)
 {
@@ -123,13 +577,18 @@ TextureHandle TextureCache::LoadHdri(const AssetPath& exrPath)
 	assert(!m_fileHashToFileName.contains(fileHash));
 	m_fileHashToFileName[fileHash] = filePathStr;
 
-	TinyExrData exr(filePathStr);
-	if (exr.result != TINYEXR_SUCCESS)
+	// Only the header is read here, pixels are decoded by worker threads until UploadTextures()
+	int width = 0, height = 0;
 	{
-		return TextureHandle::Invalid;
+		ExrHeader exr(filePathStr);
+		if (!exr.isValid)
+			return TextureHandle::Invalid;
+
+		width = exr.GetWidth();
+		height = exr.GetHeight();
 	}
 
-	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2((std::max)(exr.width, exr.height)))) + 1;
+	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2((std::max)(width, height)))) + 1;
 
 	// Texture image
 	size_t imageViewTypeIndex = (size_t)ImageViewType::e2D;
@@ -137,12 +596,12 @@ TextureHandle TextureCache::LoadHdri(const AssetPath& exrPath)
 	uint32_t textureIndex = m_textures[imageViewTypeIndex].size();
 	m_textures[imageViewTypeIndex].push_back(
 		std::make_unique<Texture>(
-			exr.width, exr.height, static_cast<uint32_t>(4UL * sizeof(float)),
+			width, height, static_cast<uint32_t>(4UL * sizeof(uint16_t)),
 			GetHdriFormat(),
 			vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eTransferSrc |
-			vk::ImageUsageFlagBits::eTransferDst | // src and dst for mipmaps blit
-			vk::ImageUsageFlagBits::eSampled,
+			vk::ImageUsageFlagBits::eTransferDst |
+			vk::ImageUsageFlagBits::eSampled |
+			GetMipGenerationUsage(GetHdriFormat(), width, height),
 			vk::ImageAspectFlagBits::eColor,
 			vk::ImageViewType::e2D,
 			mipLevels
@@ -155,7 +614,13 @@ TextureHandle TextureCache::LoadHdri(const AssetPath& exrPath)
 	m_names[imageViewTypeIndex].push_back(filePathStr.data());
 	m_imageTypeCount[(size_t)ImageViewType::e2D]++;
 
-	memcpy(texture->GetStagingMappedData(), reinterpret_cast<const void*>(exr.data), (size_t)exr.width * exr.height * 4 * sizeof(float));
+	if (m_decodeWorkers == nullptr)
+		m_decodeWorkers = std::make_unique<WorkerPool>();
+
+	m_decodeWorkers->Submit([filePathStr, width, height, stagingData = static_cast<uint16_t*>(texture->GetStagingMappedData())]() {
+		if (!DecodeExrToHalf(filePathStr, width, height, stagingData))
+			memset(stagingData, 0, size_t(width) * height * 4 * sizeof(uint16_t)); // upload a black texture on error
+	});
 
 	vk::Sampler sampler = CreateSampler(texture->GetMipLevels());
 	TextureHandle textureHandle = m_bindlessDescriptors->StoreTexture(texture->GetImageView(), std::move(sampler));
@@ -248,8 +713,9 @@ TextureHandle TextureCache::LoadCubeMapFaces(gsl::span<AssetPath> filePaths)
 		channels = texChannels;
 	}
 
-	// Create cubemap
+	// Create cubemap, all faces are downsampled together
 	size_t samplerTypeIndex = (size_t)ImageViewType::eCube;
+	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2((std::max)((std::max)(width, height), 1)))) + 1;
 
 	uint32_t textureIndex = m_textures[samplerTypeIndex].size();
 	m_textures[samplerTypeIndex].push_back(
@@ -257,10 +723,12 @@ TextureHandle TextureCache::LoadCubeMapFaces(gsl::span<AssetPath> filePaths)
 			width, height, static_cast<uint32_t>(4UL * sizeof(stbi_us)),
 			GetTextureFormat(),
 			vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+			vk::ImageUsageFlagBits::eTransferDst |
+			vk::ImageUsageFlagBits::eSampled |
+			GetMipGenerationUsage(GetTextureFormat(), width, height, 6),
 			vk::ImageAspectFlagBits::eColor,
 			vk::ImageViewType::eCube,
-			1, // mipLevels (todo: support mip-maps)
+			mipLevels,
 			6 // layerCount (6 for cube)
 		)
 	);
@@ -292,18 +760,282 @@ TextureHandle TextureCache::LoadCubeMapFaces(gsl::span<AssetPath> filePaths)
 
 void TextureCache::UploadTextures(CommandRingBuffer& commandRingBuffer)
 {
+	// Staging buffers are written by the decoding threads
+	if (m_decodeWorkers != nullptr)
+		m_decodeWorkers->Wait();
+
+	if (m_texturesToUpload.empty())
+		return;
+
+	if (m_mipGenerator == nullptr)
+		m_mipGenerator = std::make_unique<MipGenerator>(*m_shaderCache);
+
 	vk::CommandBuffer commandBuffer = commandRingBuffer.GetCommandBuffer();
+	std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+	imageBarriers.reserve(m_texturesToUpload.size());
+	auto recordImageBarriers = [&]() {
+		if (!imageBarriers.empty())
+			commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, {}, {}, imageBarriers));
+		imageBarriers.clear();
+	};
+
+	for (const TextureKey& key : m_texturesToUpload)
+	{
+		const auto& texture = m_textures[static_cast<size_t>(key.type)][key.index];
+		imageBarriers.push_back(texture->MakeLayoutBarrier(vk::ImageLayout::eTransferDstOptimal,
+			vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite));
+	}
+	recordImageBarriers();
 
+	std::vector<Texture*> texturesToDownsample;
 	for (const TextureKey& key : m_texturesToUpload)
 	{
 		const auto& texture = m_textures[static_cast<size_t>(key.type)][key.index];
-		texture->UploadStagingToGPU(commandBuffer, vk::ImageLayout::eShaderReadOnlyOptimal);
+		texture->CopyStagingToImage(commandBuffer);
 		UniqueBuffer* stagingBuffer = texture->ReleaseStagingBuffer();
 		commandRingBuffer.DestroyAfterSubmit(stagingBuffer);
+
+		const vk::Extent3D& extent = texture->GetExtent();
+		if (!texture->HasMipsToGenerate())
+		{
+			imageBarriers.push_back(texture->MakeLayoutBarrier(vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+				vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader,
+				vk::AccessFlagBits2::eShaderSampledRead));
+		}
+		else if (MipGenerator::IsSupported(texture->GetFormat(), extent.width, extent.height, texture->GetLayerCount()))
+		{
+			texturesToDownsample.push_back(texture.get());
+		}
+		else
+		{
+			texture->GenerateMipmaps(commandBuffer, vk::ImageLayout::eShaderReadOnlyOptimal);
+		}
 	}
+	recordImageBarriers();
+
+	m_mipGenerator->GenerateMips(commandRingBuffer, texturesToDownsample);
 	m_texturesToUpload.clear();
 }
 
+void TextureCache::RequestMipLevel(TextureHandle textureHandle, float uvPerPixel)
+{
+	auto it = m_streamedTextures.find(textureHandle);
+	if (it == m_streamedTextures.end())
+		return;
+
+	// Level at which a texel covers about a pixel, sampling it from a finer level would alias anyway
+	StreamedTexture& streamedTexture = it->second;
+	const float texelsPerPixel = uvPerPixel * static_cast<float>((std::max)(streamedTexture.file.GetWidth(), streamedTexture.file.GetHeight()));
+	const uint32_t level = texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::log2(texelsPerPixel)) : 0;
+	streamedTexture.requestedLevel = (std::min)({ streamedTexture.requestedLevel, level, streamedTexture.coarsestLevel });
+	streamedTexture.lastRequestFrame = m_streamingFrame;
+}
+
+void TextureCache::UpdateStreaming(CommandRingBuffer& commandRingBuffer, uint32_t frameIndex)
+{
+	using namespace TextureCache_Private;
+
+	if (m_virtualTextureCache != nullptr)
+		m_virtualTextureCache->Update(commandRingBuffer, frameIndex);
+
+	if (m_streamedTextures.empty())
+	{
+		UploadTextureSlots(commandRingBuffer);
+		return;
+	}
+
+	// Frames recorded before a swap sample the previous slot of the texture, they have completed once
+	// the swap frame is the oldest one in flight
+	std::erase_if(m_retiredTextureSlots, [this](const RetiredTextureSlot& retiredSlot) {
+		if (m_streamingFrame + 1 < retiredSlot.frame + RHIConstants::kMaxFramesInFlight)
+			return false;
+
+		m_bindlessDescriptors->ReleaseTexture(retiredSlot.slot);
+		return true;
+	});
+
+	// Loaded levels are uploaded and swapped in right away, the passes of this frame sample them through their new slot
+	std::vector<TextureHandle> loadedTextureHandles;
+	std::vector<Texture*> loadedTextures;
+	size_t jobCount = 0;
+	for (auto& [textureHandle, streamedTexture] : m_streamedTextures)
+	{
+		MipStreamingJob* job = streamedTexture.job.get();
+		if (job == nullptr)
+			continue;
+
+		if (job->isLoaded.load(std::memory_order_acquire))
+		{
+			loadedTextureHandles.push_back(textureHandle);
+			loadedTextures.push_back(job->texture.get());
+		}
+		else
+		{
+			++jobCount;
+		}
+	}
+
+	if (!loadedTextures.empty())
+	{
+		vk::CommandBuffer commandBuffer = commandRingBuffer.GetCommandBuffer();
+		std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+		imageBarriers.reserve(loadedTextures.size());
+		for (Texture* texture : loadedTextures)
+		{
+			imageBarriers.push_back(texture->MakeLayoutBarrier(vk::ImageLayout::eTransferDstOptimal,
+				vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+				vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite));
+		}
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, {}, {}, imageBarriers));
+
+		imageBarriers.clear();
+		for (Texture* texture : loadedTextures)
+		{
+			texture->CopyStagingToImage(commandBuffer);
+			commandRingBuffer.DestroyAfterSubmit(texture->ReleaseStagingBuffer());
+			imageBarriers.push_back(texture->MakeLayoutBarrier(vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+				vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader,
+				vk::AccessFlagBits2::eShaderSampledRead));
+		}
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, {}, {}, imageBarriers));
+
+		for (TextureHandle textureHandle : loadedTextureHandles)
+			SwapStreamedTexture(commandRingBuffer, textureHandle, m_streamedTextures.at(textureHandle));
+	}
+	UploadTextureSlots(commandRingBuffer);
+
+	// Levels wanted by each texture, recently requested textures keep their levels
+	struct StreamingTarget
+	{
+		StreamedTexture* streamedTexture;
+		uint32_t level;
+	};
+	std::vector<StreamingTarget> targets;
+	targets.reserve(m_streamedTextures.size());
+	vk::DeviceSize targetSize = 0;
+	for (auto& [textureHandle, streamedTexture] : m_streamedTextures)
+	{
+		uint32_t level = streamedTexture.coarsestLevel;
+		if (streamedTexture.requestedLevel <= streamedTexture.coarsestLevel)
+			level = streamedTexture.requestedLevel;
+		else if (m_streamingFrame - streamedTexture.lastRequestFrame < kMipEvictionDelay)
+			level = streamedTexture.residentLevel;
+
+		targets.push_back({ &streamedTexture, level });
+		targetSize += GetLevelsSize(streamedTexture.file, level);
+		streamedTexture.requestedLevel = ~0U;
+	}
+
+	// Over budget, drop the largest levels first. The coarsest levels always stay resident.
+	auto hasSmallerLevel = [&](size_t lhs, size_t rhs) {
+		return targets[lhs].streamedTexture->file.GetLevelSize(targets[lhs].level) < targets[rhs].streamedTexture->file.GetLevelSize(targets[rhs].level);
+	};
+	std::vector<size_t> targetsToDrop;
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		if (targets[i].level < targets[i].streamedTexture->coarsestLevel)
+			targetsToDrop.push_back(i);
+	}
+	std::make_heap(targetsToDrop.begin(), targetsToDrop.end(), hasSmallerLevel);
+	while (targetSize > m_streamingBudget && !targetsToDrop.empty())
+	{
+		std::pop_heap(targetsToDrop.begin(), targetsToDrop.end(), hasSmallerLevel);
+		StreamingTarget& target = targets[targetsToDrop.back()];
+		targetSize -= target.streamedTexture->file.GetLevelSize(target.level);
+		++target.level;
+		if (target.level < target.streamedTexture->coarsestLevel)
+			std::push_heap(targetsToDrop.begin(), targetsToDrop.end(), hasSmallerLevel);
+		else
+			targetsToDrop.pop_back();
+	}
+
+	// Levels are dropped first to free memory, a texture changes once its pending job is done
+	for (bool isDroppingLevels : { true, false })
+	{
+		for (const StreamingTarget& target : targets)
+		{
+			StreamedTexture& streamedTexture = *target.streamedTexture;
+			const bool isChanging = isDroppingLevels ? target.level > streamedTexture.residentLevel : target.level < streamedTexture.residentLevel;
+			if (streamedTexture.job != nullptr || !isChanging || jobCount >= kMaxStreamingJobCount)
+				continue;
+
+			StartStreamingJob(streamedTexture, target.level);
+			++jobCount;
+		}
+	}
+
+	++m_streamingFrame;
+}
+
+void TextureCache::FinishFrame(CommandRingBuffer& commandRingBuffer)
+{
+	if (m_virtualTextureCache != nullptr)
+		m_virtualTextureCache->RecordFeedbackBarrier(commandRingBuffer.GetCommandBuffer());
+}
+
+void TextureCache::StartStreamingJob(StreamedTexture& streamedTexture, uint32_t firstLevel)
+{
+	const Texture& texture = *m_textures[(size_t)ImageViewType::e2D][streamedTexture.textureIndex];
+	streamedTexture.job = std::make_unique<MipStreamingJob>();
+	streamedTexture.job->firstLevel = firstLevel;
+	streamedTexture.job->texture = CreateKtx2TextureLevels(streamedTexture.file, texture.GetFormat(), firstLevel, &streamedTexture.job->isLoaded);
+}
+
+void TextureCache::SwapStreamedTexture(CommandRingBuffer& commandRingBuffer, TextureHandle textureHandle, StreamedTexture& streamedTexture)
+{
+	using namespace TextureCache_Private;
+
+	const size_t imageViewTypeIndex = (size_t)ImageViewType::e2D;
+	std::unique_ptr<Texture>& texture = m_textures[imageViewTypeIndex][streamedTexture.textureIndex];
+	commandRingBuffer.DestroyAfterSubmit(new RetiredTexture(std::move(texture)));
+
+	texture = std::move(streamedTexture.job->texture);
+	m_mipLevels[imageViewTypeIndex][streamedTexture.textureIndex] = texture->GetMipLevels();
+
+	// Commands pending execution may sample the current slot, it is released once they complete
+	uint32_t& slot = m_textureSlots[static_cast<uint32_t>(textureHandle)];
+	if (slot != static_cast<uint32_t>(textureHandle))
+		m_retiredTextureSlots.push_back({ static_cast<TextureHandle>(slot), m_streamingFrame });
+	slot = static_cast<uint32_t>(m_bindlessDescriptors->StoreTexture(texture->GetImageView(), CreateSampler(texture->GetMipLevels())));
+	m_areTextureSlotsDirty = true;
+
+	streamedTexture.residentLevel = streamedTexture.job->firstLevel;
+	streamedTexture.job.reset();
+}
+
+void TextureCache::UploadTextureSlots(CommandRingBuffer& commandRingBuffer)
+{
+	if (!m_areTextureSlotsDirty)
+		return;
+
+	const vk::DeviceSize size = m_textureSlots.size() * sizeof(uint32_t);
+	auto stagingBuffer = std::make_unique<UniqueBuffer>(
+		vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferSrc),
+		VmaAllocationCreateInfo{ VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU });
+	memcpy(stagingBuffer->GetMappedData(), m_textureSlots.data(), size);
+	stagingBuffer->Flush(0, size);
+
+	// Frames in flight read the previous slots until the copy
+	vk::CommandBuffer commandBuffer = commandRingBuffer.GetCommandBuffer();
+	const vk::MemoryBarrier2 readBarrier(
+		vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderStorageRead,
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite);
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, readBarrier, {}, {}));
+
+	commandBuffer.copyBuffer(stagingBuffer->Get(), m_textureSlotsBuffer->Get(), vk::BufferCopy(0, 0, size));
+
+	const vk::MemoryBarrier2 copyBarrier(
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderStorageRead);
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, copyBarrier, {}, {}));
+
+	commandRingBuffer.DestroyAfterSubmit(stagingBuffer.release());
+	m_areTextureSlotsDirty = false;
+}
+
 SmallVector<vk::DescriptorImageInfo> TextureCache::GetDescriptorImageInfos(ImageViewType samplerType) const
 {
 	const size_t samplerTypeIndex = (size_t)samplerType;
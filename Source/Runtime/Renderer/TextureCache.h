@@ -1,21 +1,29 @@
 #pragma once
 
 #include <Renderer/Bindless.h>
+#include <Renderer/Ktx2File.h>
+#include <Renderer/MipGenerator.h>
+#include <Renderer/VirtualTextureCache.h>
 #include <RHI/Texture.h>
 #include <RHI/SmallVector.h>
 #include <AssetPath.h>
+#include <WorkerPool.h>
 #include <vulkan/vulkan.hpp>
 
 #include <gsl/span>
 #include <gsl/pointers>
 #include <array>
+#include <atomic>
+#include <filesystem>
 #include <map>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <memory>
 #include <cstdint>
 
 class CommandRingBuffer;
+class ShaderCache;
 
 struct CombinedImageSampler
 {
@@ -30,6 +38,23 @@ enum class ImageViewType
 	eCount
 };
 
+// How the texels of a 2D texture are interpreted, decides its format with the bit depth of the file
+enum class TextureUsage
+{
+	eColor,   // RGBA8 sRGB, sampled as linear
+	eNormals, // RG8 or RG16, z is reconstructed in the shader
+	eMask,    // R8 or R16, single channel
+	eData,    // RGBA8 or RGBA16 linear values (e.g. occlusion, roughness, metallic)
+};
+
+// CPU block compression of the textures read by stb_image, see TextureCache::SetCompression()
+enum class TextureCompression
+{
+	eNone,
+	eFast,        // BC1 (BC3 with alpha) for colors and BC1 for data
+	eHighQuality, // BC7 for colors and data
+};
+
 struct TextureKey
 {
 	ImageViewType type;
@@ -39,29 +64,64 @@ struct TextureKey
 class TextureCache
 {
 public:
-	TextureCache(BindlessDescriptors& bindlessDescriptors)
-		: m_bindlessDescriptors(&bindlessDescriptors)
-	{}
+	TextureCache(BindlessDescriptors& bindlessDescriptors, ShaderCache& shaderCache);
+
+	// Textures loaded afterwards are block-compressed by worker threads, normal maps to BC5 and masks to BC4.
+	// Encoded textures are written to cacheDirectory as .ktx2 files so that only the first load encodes them.
+	void SetCompression(TextureCompression compression, std::filesystem::path cacheDirectory);
+
+	// Video memory used by the mip levels of streamed textures, see UpdateStreaming()
+	void SetStreamingBudget(vk::DeviceSize budget) { m_streamingBudget = budget; }
+
+	// Large .ktx2 textures loaded afterwards are virtual, only the pages seen on screen are resident, see VirtualTextureCache.
+	// Shaders sample them with SampleTexture2D() from bindless.glsl, and GetTexture2D() keeps sampling their coarsest levels.
+	void EnableVirtualTexturing();
 
-	// todo: support loading as sRGB vs linear for different texture types
+	// Invalid unless virtual texturing is enabled
+	BufferHandle GetVirtualTextureBufferHandle() const;
 
-	// ImageViewType::e2D
-	TextureHandle LoadTexture(const AssetPath& assetPath);
+	// One per frame in flight, empty unless virtual texturing is enabled
+	gsl::span<const BufferHandle> GetTextureFeedbackBufferHandles() const;
+
+	// TextureSlotBuffer in bindless.glsl, descriptor slot of each texture handle. Streamed textures move to a new slot
+	// when their mip levels change, shaders sample them with SampleTexture2D() from bindless.glsl.
+	BufferHandle GetTextureSlotsBufferHandle() const { return m_textureSlotsBufferHandle; }
+
+	// ImageViewType::e2D (.ktx2 or formats read by stb_image), the handle is valid right away
+	// but the image is decoded in the background until UploadTextures(). Only the coarsest mip levels
+	// of .ktx2 textures (including cached compressed textures) are loaded, finer levels are streamed.
+	TextureHandle LoadTexture(const AssetPath& assetPath, TextureUsage usage = TextureUsage::eColor);
 
 	// ImageViewType::eCube (6 separate .jpg or .png)
 	TextureHandle LoadCubeMapFaces(gsl::span<AssetPath> filenames); // todo, this is the same as LoadTexture but with vk::ImageViewType::eCube
 
-	// ImageViewType::eCube (.exr)
+	// ImageViewType::e2D (.exr), decoded in the background like LoadTexture()
 	TextureHandle LoadHdri(const AssetPath& exrPath);
 
-	vk::Format GetHdriFormat() const { return vk::Format::eR32G32B32A32Sfloat; }
+	vk::Format GetHdriFormat() const { return vk::Format::eR16G16B16A16Sfloat; }
 
+	// Cube maps and environment maps
 	vk::Format GetTextureFormat() const { return vk::Format::eR16G16B16A16Unorm; }
 
 	vk::Sampler CreateSampler(uint32_t nbMipLevels);
 
+	// Copies the textures loaded since the last call, their mip levels are generated by a compute shader
+	// when their format allows it. Barriers of all textures are recorded together.
 	void UploadTextures(CommandRingBuffer& commandRingBuffer);
 
+	// Requests the mip level of a streamed texture for texels seen uvPerPixel texture coordinates apart on screen,
+	// the finest level requested during a frame is kept. Textures loaded without streaming ignore requests.
+	void RequestMipLevel(TextureHandle textureHandle, float uvPerPixel);
+
+	// Once per frame, when the commands of the oldest frame in flight have completed. Finer mip levels of the
+	// textures requested during the frame are read by worker threads then uploaded, levels no longer requested
+	// are dropped after a while. The finest levels are dropped first when requests don't fit in the budget.
+	// Pages of virtual textures missed by the last frame using frameIndex are requested as well.
+	void UpdateStreaming(CommandRingBuffer& commandRingBuffer, uint32_t frameIndex);
+
+	// Once the passes of the frame are recorded, for UpdateStreaming() to read the pages they missed
+	void FinishFrame(CommandRingBuffer& commandRingBuffer);
+
 	SmallVector<vk::DescriptorImageInfo> GetDescriptorImageInfos(ImageViewType imageViewType) const;
 
 	vk::DescriptorImageInfo GetDescriptorImageInfo(ImageViewType imageViewType, TextureHandle id) const;
@@ -71,7 +131,56 @@ public:
 	size_t GetTextureCount(ImageViewType imageViewType) const { return m_imageTypeCount[(size_t)imageViewType]; }
 
 private:
-	TextureHandle CreateAndUploadTextureImage(const AssetPath& assetPath);
+	TextureHandle CreateAndUploadTextureImage(const AssetPath& assetPath, TextureUsage usage);
+
+	// Mip levels are generated when uploading, unless the texture is compressed
+	std::unique_ptr<Texture> CreateDecodedTexture(const std::string& filePath, TextureUsage usage, std::optional<Ktx2File>& streamedFile);
+
+	// Block-compressed with its coarsest mip levels, streamedFile is set to read the other levels later
+	std::unique_ptr<Texture> CreateKtx2Texture(const std::string& filePath, TextureUsage usage, std::optional<Ktx2File>& streamedFile);
+
+	// Mip levels [firstLevel, end) of the file, read and decompressed by a worker thread which sets isLoaded when done
+	std::unique_ptr<Texture> CreateKtx2TextureLevels(const Ktx2File& file, vk::Format format, uint32_t firstLevel, std::atomic<bool>* isLoaded = nullptr);
+
+	// Loaded from the cache, or decoded, downsampled and encoded by worker threads then cached
+	std::unique_ptr<Texture> CreateCompressedTexture(const std::string& filePath, TextureUsage usage, std::optional<Ktx2File>& streamedFile);
+
+	// Writes the first channelCount channels of each pixel to stagingData from a worker thread
+	void DecodeTextureAsync(std::string filePath, void* stagingData, int width, int height, uint32_t channelCount, bool is16Bit);
+
+	// Mip levels of a streamed texture read by a worker thread, then uploaded before replacing the texture
+	struct MipStreamingJob
+	{
+		std::unique_ptr<Texture> texture;
+		uint32_t firstLevel = 0;
+		std::atomic<bool> isLoaded = false;
+	};
+
+	// .ktx2 texture whose finest mip levels are loaded on demand
+	struct StreamedTexture
+	{
+		Ktx2File file;
+		uint32_t textureIndex = 0; // into m_textures for ImageViewType::e2D
+		uint32_t coarsestLevel = 0; // first level loaded at startup, always resident
+		uint32_t residentLevel = 0; // first level of the texture
+		uint32_t requestedLevel = ~0U; // finest level requested since the last update
+		uint64_t lastRequestFrame = 0;
+		std::unique_ptr<MipStreamingJob> job;
+	};
+
+	void StartStreamingJob(StreamedTexture& streamedTexture, uint32_t firstLevel);
+
+	// Replaces the texture by the one uploaded by its job, stored in a new descriptor slot
+	void SwapStreamedTexture(CommandRingBuffer& commandRingBuffer, TextureHandle textureHandle, StreamedTexture& streamedTexture);
+
+	// Copies the slots changed since the last call, before the passes of the frame sample them
+	void UploadTextureSlots(CommandRingBuffer& commandRingBuffer);
+
+	// Bumped whenever the encoded data of a texture changes, to ignore cached textures
+	static constexpr uint32_t kTextureEncoderVersion = 1;
+
+	TextureCompression m_compression = TextureCompression::eNone;
+	std::filesystem::path m_compressionCacheDirectory;
 
 	// Internal ID for samplers
 	using SamplerID = uint32_t;
@@ -96,4 +205,33 @@ private:
 
 	// Textures are bound to a single array of textures
 	gsl::not_null<BindlessDescriptors*> m_bindlessDescriptors;
+
+	gsl::not_null<ShaderCache*> m_shaderCache;
+
+	// Created with the first textures to upload
+	std::unique_ptr<MipGenerator> m_mipGenerator;
+
+	std::unordered_map<TextureHandle, StreamedTexture> m_streamedTextures;
+	vk::DeviceSize m_streamingBudget = vk::DeviceSize{ 1024 } << 20;
+	uint64_t m_streamingFrame = 0;
+
+	// Textures too large to stream all their levels, see EnableVirtualTexturing()
+	std::unique_ptr<VirtualTextureCache> m_virtualTextureCache;
+
+	// Descriptor slot of each texture handle, the slot of a handle itself stays reserved for it
+	std::vector<uint32_t> m_textureSlots;
+	std::unique_ptr<UniqueBuffer> m_textureSlotsBuffer;
+	BufferHandle m_textureSlotsBufferHandle = BufferHandle::Invalid;
+	bool m_areTextureSlotsDirty = true;
+
+	// Previous slot of a swapped texture, sampled by the frames recorded before the swap
+	struct RetiredTextureSlot
+	{
+		TextureHandle slot = TextureHandle::Invalid;
+		uint64_t frame = 0;
+	};
+	std::vector<RetiredTextureSlot> m_retiredTextureSlots;
+
+	// Created with the first texture to decode, destroyed before the textures it writes to
+	std::unique_ptr<WorkerPool> m_decodeWorkers;
 };
@@ -0,0 +1,464 @@
+#include <Renderer/VirtualTextureCache.h>
+
+#include <Renderer/Bindless.h>
+#include <RHI/Buffers.h>
+#include <RHI/CommandRingBuffer.h>
+#include <RHI/Device.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+namespace VirtualTextureCache_Private
+{
+	// Match VirtualTexture in bindless.glsl
+	struct VirtualTextureDescription
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		uint32_t firstPage;
+		TextureHandle pageCache;
+		uint32_t padding[3];
+	};
+
+	// Match TextureFeedbackBuffer in bindless.glsl, followed by the requested page IDs
+	struct FeedbackHeader
+	{
+		uint32_t frame; // picks the pixel of each tile writing its requests
+		uint32_t capacity;
+		uint32_t count; // can exceed the capacity, extra requests are dropped
+		uint32_t padding;
+	};
+
+	// Page table entries of resident pages, slotY << 16 | slotX otherwise
+	constexpr uint32_t kResidentBit = 1u << 31;
+
+	constexpr vk::DeviceSize kPageTableOffset = sizeof(VirtualTextureDescription) * BindlessDescriptors::kMaxDescriptorCount;
+
+	// Copies of pages must start on a block
+	constexpr vk::DeviceSize kStagingAlignment = 16;
+
+	// Page reads are small and mostly wait on the disk
+	constexpr size_t kPageLoadThreadCount = 2;
+
+	constexpr uint32_t kBlockExtent = 4;
+
+	bool IsPowerOfTwo(uint32_t value)
+	{
+		return value != 0 && (value & (value - 1)) == 0;
+	}
+
+	vk::Extent2D GetPageCount(const Ktx2File& file, uint32_t level)
+	{
+		return vk::Extent2D((file.GetWidth() >> level) / VirtualTextureCache::kPageSize, (file.GetHeight() >> level) / VirtualTextureCache::kPageSize);
+	}
+
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+VirtualTextureCache::VirtualTextureCache(BindlessDescriptors& bindlessDescriptors)
+	: m_bindlessDescriptors(&bindlessDescriptors)
+	, m_pageLoadWorkers(std::make_unique<WorkerPool>(VirtualTextureCache_Private::kPageLoadThreadCount))
+{
+	using namespace VirtualTextureCache_Private;
+
+	// Borders of the pages cover bilinear filtering, page caches have a single level
+	m_pageCacheSampler = g_device->Get().createSamplerUnique(vk::SamplerCreateInfo(
+		{}, // flags
+		vk::Filter::eLinear, // magFilter
+		vk::Filter::eLinear, // minFilter
+		vk::SamplerMipmapMode::eNearest,
+		vk::SamplerAddressMode::eClampToEdge, // addressModeU
+		vk::SamplerAddressMode::eClampToEdge, // addressModeV
+		vk::SamplerAddressMode::eClampToEdge, // addressModeW
+		{}, // mipLodBias
+		false, // anisotropyEnable
+		1, // maxAnisotropy
+		false, // compareEnable
+		vk::CompareOp::eAlways, // compareOp
+		0.0f, // minLod
+		0.0f, // maxLod
+		vk::BorderColor::eIntOpaqueBlack, // borderColor
+		false // unnormalizedCoordinates
+	));
+
+	m_pageTableBuffer = std::make_unique<UniqueBuffer>(
+		vk::BufferCreateInfo({}, kPageTableOffset + kMaxPageTableSize * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst),
+		VmaAllocationCreateInfo{ {}, VMA_MEMORY_USAGE_GPU_ONLY }
+	);
+	m_pageTableBufferHandle = m_bindlessDescriptors->StoreBuffer(m_pageTableBuffer->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+
+	// Written by shaders and read back by the CPU, the buffers stay small
+	const vk::DeviceSize feedbackSize = sizeof(FeedbackHeader) + kFeedbackCapacity * sizeof(uint32_t);
+	for (uint32_t i = 0; i < RHIConstants::kMaxFramesInFlight; ++i)
+	{
+		m_feedbackBuffers[i] = std::make_unique<UniqueBuffer>(
+			vk::BufferCreateInfo({}, feedbackSize, vk::BufferUsageFlagBits::eStorageBuffer),
+			VmaAllocationCreateInfo{ VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU });
+		m_feedbackBufferHandles[i] = m_bindlessDescriptors->StoreBuffer(m_feedbackBuffers[i]->Get(), vk::BufferUsageFlagBits::eStorageBuffer);
+
+		FeedbackHeader& header = *static_cast<FeedbackHeader*>(m_feedbackBuffers[i]->GetMappedData());
+		header = FeedbackHeader{ 0, kFeedbackCapacity, 0, 0 };
+		m_feedbackBuffers[i]->Flush(0, sizeof(FeedbackHeader));
+	}
+}
+
+VirtualTextureCache::~VirtualTextureCache() = default;
+
+uint32_t VirtualTextureCache::GetVirtualLevelCount(const Ktx2File& file)
+{
+	using namespace VirtualTextureCache_Private;
+
+	const uint32_t width = file.GetWidth();
+	const uint32_t height = file.GetHeight();
+	if (file.IsSupercompressed() || !IsPowerOfTwo(width) || !IsPowerOfTwo(height) || (std::max)(width, height) / kPageSize > kMaxPagesPerAxis)
+		return 0;
+
+	uint32_t levelCount = 0;
+	while (levelCount < file.GetLevelCount() && (std::min)(width >> levelCount, height >> levelCount) >= kPageSize)
+		++levelCount;
+	return levelCount < file.GetLevelCount() ? levelCount : 0;
+}
+
+bool VirtualTextureCache::AddTexture(TextureHandle textureHandle, Ktx2File file, vk::Format format)
+{
+	using namespace VirtualTextureCache_Private;
+
+	const uint32_t levelCount = GetVirtualLevelCount(file);
+	assert(levelCount > 0);
+
+	uint32_t pageCount = 0;
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		const vk::Extent2D levelPageCount = GetPageCount(file, level);
+		pageCount += levelPageCount.width * levelPageCount.height;
+	}
+	if (m_pageTableSize + pageCount > kMaxPageTableSize)
+	{
+		std::cerr << "virtual texture page table is full, only the coarsest levels of a " << file.GetWidth() << "x" << file.GetHeight() << " texture are loaded" << std::endl;
+		return false;
+	}
+
+	// Textures of the same format share a page cache
+	auto pageCache = std::find_if(m_pageCaches.begin(), m_pageCaches.end(), [format](const PageCache& pageCache) { return pageCache.format == format; });
+	if (pageCache == m_pageCaches.end())
+	{
+		PageCache& newPageCache = m_pageCaches.emplace_back();
+		newPageCache.format = format;
+		newPageCache.image = std::make_unique<Image>(
+			kSlotSize * kPageCacheSlotsPerAxis, kSlotSize * kPageCacheSlotsPerAxis,
+			format,
+			vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+			vk::ImageAspectFlagBits::eColor,
+			vk::ImageViewType::e2D
+		);
+		newPageCache.textureHandle = m_bindlessDescriptors->StoreTexture(newPageCache.image->GetImageView(), m_pageCacheSampler.get());
+		newPageCache.slots.resize(kPageCacheSlotsPerAxis * kPageCacheSlotsPerAxis);
+		pageCache = std::prev(m_pageCaches.end());
+	}
+
+	const uint32_t textureIndex = static_cast<uint32_t>(textureHandle);
+	m_textures.emplace(textureIndex, VirtualTexture{
+		.file = std::move(file),
+		.pageCacheIndex = static_cast<uint32_t>(pageCache - m_pageCaches.begin()),
+		.levelCount = levelCount,
+		.firstPage = m_pageTableSize,
+	});
+	m_texturesToDescribe.push_back(textureIndex);
+	m_pageTableSize += pageCount;
+	return true;
+}
+
+void VirtualTextureCache::Update(CommandRingBuffer& commandRingBuffer, uint32_t frameIndex)
+{
+	using namespace VirtualTextureCache_Private;
+
+	// Coarse pages first, finer pages are sampled from them until they are loaded
+	const std::vector<uint32_t> pagesToLoad = ReadFeedback(frameIndex);
+	for (uint32_t pageID : pagesToLoad)
+	{
+		if (m_pageLoads.size() >= kMaxPageLoadCount)
+			break;
+		StartPageLoad(pageID);
+	}
+
+	// Loaded pages replace the least recently used ones
+	struct PageTableWrite
+	{
+		uint32_t index;
+		uint32_t entry;
+	};
+	struct PageUpload
+	{
+		uint32_t pageCacheIndex;
+		uint32_t slotIndex;
+		std::unique_ptr<PageLoad> load;
+	};
+	std::vector<PageTableWrite> pageTableWrites;
+	std::vector<PageUpload> pageUploads;
+	for (auto it = m_pageLoads.begin(); it != m_pageLoads.end() && pageUploads.size() < kMaxPageUploadCount;)
+	{
+		if (!it->second->isLoaded.load(std::memory_order_acquire))
+		{
+			++it;
+			continue;
+		}
+
+		const uint32_t pageID = it->first;
+		VirtualTexture& texture = m_textures.at(GetPageTextureIndex(pageID));
+		PageCache& pageCache = m_pageCaches[texture.pageCacheIndex];
+
+		// Pages without a free slot are dropped, they are requested again once fewer pages are visible
+		const uint32_t slotIndex = it->second->hasFailed ? kNoPage : FindFreeSlot(pageCache);
+		if (it->second->hasFailed)
+		{
+			texture.hasFailed = true;
+		}
+		else if (slotIndex != kNoPage)
+		{
+			Slot& slot = pageCache.slots[slotIndex];
+			if (slot.pageID != kNoPage)
+			{
+				pageTableWrites.push_back({ GetPageTableIndex(slot.pageID), 0 });
+				m_pageToSlot.erase(slot.pageID);
+			}
+			slot = Slot{ pageID, m_frame };
+			m_pageToSlot.emplace(pageID, slotIndex);
+
+			const uint32_t slotX = slotIndex % kPageCacheSlotsPerAxis;
+			const uint32_t slotY = slotIndex / kPageCacheSlotsPerAxis;
+			pageTableWrites.push_back({ GetPageTableIndex(pageID), kResidentBit | (slotY << 16) | slotX });
+			pageUploads.push_back({ texture.pageCacheIndex, slotIndex, std::move(it->second) });
+		}
+		it = m_pageLoads.erase(it);
+	}
+
+	if (m_isPageTableCleared && m_texturesToDescribe.empty() && pageTableWrites.empty())
+	{
+		++m_frame;
+		return;
+	}
+
+	// Pages first to keep their copies aligned, then texture descriptions and page table entries
+	vk::DeviceSize stagingSize = 0;
+	for (const PageUpload& pageUpload : pageUploads)
+		stagingSize += AlignUp(pageUpload.load->data.size(), kStagingAlignment);
+	stagingSize += m_texturesToDescribe.size() * sizeof(VirtualTextureDescription) + pageTableWrites.size() * sizeof(uint32_t);
+
+	auto stagingBuffer = std::make_unique<UniqueBuffer>(
+		vk::BufferCreateInfo({}, (std::max)(stagingSize, vk::DeviceSize{ sizeof(uint32_t) }), vk::BufferUsageFlagBits::eTransferSrc),
+		VmaAllocationCreateInfo{ VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU });
+	char* stagingData = static_cast<char*>(stagingBuffer->GetMappedData());
+	vk::DeviceSize stagingOffset = 0;
+
+	std::vector<std::vector<vk::BufferImageCopy>> pageCopies(m_pageCaches.size());
+	for (const PageUpload& pageUpload : pageUploads)
+	{
+		memcpy(stagingData + stagingOffset, pageUpload.load->data.data(), pageUpload.load->data.size());
+		const vk::Offset3D slotOffset(
+			static_cast<int32_t>(pageUpload.slotIndex % kPageCacheSlotsPerAxis * kSlotSize),
+			static_cast<int32_t>(pageUpload.slotIndex / kPageCacheSlotsPerAxis * kSlotSize),
+			0);
+		pageCopies[pageUpload.pageCacheIndex].emplace_back(
+			stagingOffset, 0, 0, // tightly packed
+			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+			slotOffset, vk::Extent3D(kSlotSize, kSlotSize, 1));
+		stagingOffset += AlignUp(pageUpload.load->data.size(), kStagingAlignment);
+	}
+
+	std::vector<vk::BufferCopy> pageTableCopies;
+	pageTableCopies.reserve(m_texturesToDescribe.size() + pageTableWrites.size());
+	for (uint32_t textureIndex : m_texturesToDescribe)
+	{
+		const VirtualTexture& texture = m_textures.at(textureIndex);
+		const VirtualTextureDescription description = {
+			.width = texture.file.GetWidth(),
+			.height = texture.file.GetHeight(),
+			.levelCount = texture.levelCount,
+			.firstPage = texture.firstPage,
+			.pageCache = m_pageCaches[texture.pageCacheIndex].textureHandle,
+		};
+		memcpy(stagingData + stagingOffset, &description, sizeof(description));
+		pageTableCopies.emplace_back(stagingOffset, textureIndex * sizeof(VirtualTextureDescription), sizeof(description));
+		stagingOffset += sizeof(description);
+	}
+	for (const PageTableWrite& pageTableWrite : pageTableWrites)
+	{
+		memcpy(stagingData + stagingOffset, &pageTableWrite.entry, sizeof(uint32_t));
+		pageTableCopies.emplace_back(stagingOffset, kPageTableOffset + pageTableWrite.index * sizeof(uint32_t), sizeof(uint32_t));
+		stagingOffset += sizeof(uint32_t);
+	}
+	stagingBuffer->Flush(0, stagingSize);
+
+	// Frames in flight sample the previous pages until the copies
+	vk::CommandBuffer commandBuffer = commandRingBuffer.GetCommandBuffer();
+	std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+	for (size_t i = 0; i < m_pageCaches.size(); ++i)
+	{
+		if (!pageCopies[i].empty())
+		{
+			imageBarriers.push_back(m_pageCaches[i].image->MakeLayoutBarrier(vk::ImageLayout::eTransferDstOptimal,
+				vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead,
+				vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite));
+		}
+	}
+	const vk::MemoryBarrier2 pageTableBarrier(
+		vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderStorageRead,
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite);
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, pageTableBarrier, {}, imageBarriers));
+
+	// No page is resident and textures without a description are not virtual
+	if (!m_isPageTableCleared)
+	{
+		commandBuffer.fillBuffer(m_pageTableBuffer->Get(), 0, VK_WHOLE_SIZE, 0);
+		const vk::MemoryBarrier2 clearBarrier(
+			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite);
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, clearBarrier, {}, {}));
+		m_isPageTableCleared = true;
+	}
+
+	if (!pageTableCopies.empty())
+		commandBuffer.copyBuffer(stagingBuffer->Get(), m_pageTableBuffer->Get(), pageTableCopies);
+
+	imageBarriers.clear();
+	for (size_t i = 0; i < m_pageCaches.size(); ++i)
+	{
+		if (pageCopies[i].empty())
+			continue;
+
+		commandBuffer.copyBufferToImage(stagingBuffer->Get(), m_pageCaches[i].image->Get(), vk::ImageLayout::eTransferDstOptimal, pageCopies[i]);
+		imageBarriers.push_back(m_pageCaches[i].image->MakeLayoutBarrier(vk::ImageLayout::eShaderReadOnlyOptimal,
+			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead));
+	}
+	const vk::MemoryBarrier2 uploadBarrier(
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderStorageRead);
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, uploadBarrier, {}, imageBarriers));
+
+	commandRingBuffer.DestroyAfterSubmit(stagingBuffer.release());
+	m_texturesToDescribe.clear();
+	++m_frame;
+}
+
+void VirtualTextureCache::RecordFeedbackBarrier(vk::CommandBuffer commandBuffer) const
+{
+	const vk::MemoryBarrier2 feedbackBarrier(
+		vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderStorageWrite,
+		vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead);
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo({}, feedbackBarrier, {}, {}));
+}
+
+const VirtualTextureCache::VirtualTexture* VirtualTextureCache::FindTexture(uint32_t pageID) const
+{
+	using namespace VirtualTextureCache_Private;
+
+	auto it = m_textures.find(GetPageTextureIndex(pageID));
+	if (it == m_textures.end() || GetPageLevel(pageID) >= it->second.levelCount)
+		return nullptr;
+
+	const vk::Extent2D pageCount = GetPageCount(it->second.file, GetPageLevel(pageID));
+	return GetPageX(pageID) < pageCount.width && GetPageY(pageID) < pageCount.height ? &it->second : nullptr;
+}
+
+uint32_t VirtualTextureCache::GetPageTableIndex(uint32_t pageID) const
+{
+	using namespace VirtualTextureCache_Private;
+
+	// Levels are stored one after the other from the finest
+	const VirtualTexture& texture = m_textures.at(GetPageTextureIndex(pageID));
+	uint32_t index = texture.firstPage;
+	for (uint32_t level = 0; level < GetPageLevel(pageID); ++level)
+	{
+		const vk::Extent2D pageCount = GetPageCount(texture.file, level);
+		index += pageCount.width * pageCount.height;
+	}
+	return index + GetPageY(pageID) * GetPageCount(texture.file, GetPageLevel(pageID)).width + GetPageX(pageID);
+}
+
+std::vector<uint32_t> VirtualTextureCache::ReadFeedback(uint32_t frameIndex)
+{
+	using namespace VirtualTextureCache_Private;
+
+	UniqueBuffer& feedbackBuffer = *m_feedbackBuffers[frameIndex];
+	feedbackBuffer.Invalidate(0, feedbackBuffer.Size());
+	FeedbackHeader& header = *static_cast<FeedbackHeader*>(feedbackBuffer.GetMappedData());
+	const uint32_t* requests = reinterpret_cast<const uint32_t*>(&header + 1);
+
+	// Many pixels request the same pages
+	std::vector<uint32_t> requestedPages(requests, requests + (std::min)(header.count, kFeedbackCapacity));
+	std::sort(requestedPages.begin(), requestedPages.end());
+	requestedPages.erase(std::unique(requestedPages.begin(), requestedPages.end()), requestedPages.end());
+
+	// Coarser pages are sampled while finer ones are missing, they are used as well
+	std::vector<uint32_t> pagesToLoad;
+	for (uint32_t requestedPage : requestedPages)
+	{
+		const VirtualTexture* texture = FindTexture(requestedPage);
+		if (texture == nullptr || texture->hasFailed)
+			continue;
+
+		uint32_t x = GetPageX(requestedPage);
+		uint32_t y = GetPageY(requestedPage);
+		for (uint32_t level = GetPageLevel(requestedPage); level < texture->levelCount; ++level, x /= 2, y /= 2)
+		{
+			const uint32_t pageID = MakePageID(GetPageTextureIndex(requestedPage), level, x, y);
+			auto slot = m_pageToSlot.find(pageID);
+			if (slot != m_pageToSlot.end())
+				m_pageCaches[texture->pageCacheIndex].slots[slot->second].lastUsedFrame = m_frame;
+			else if (!m_pageLoads.contains(pageID))
+				pagesToLoad.push_back(pageID);
+		}
+	}
+	std::sort(pagesToLoad.begin(), pagesToLoad.end(), [](uint32_t lhs, uint32_t rhs) {
+		return GetPageLevel(lhs) != GetPageLevel(rhs) ? GetPageLevel(lhs) > GetPageLevel(rhs) : lhs < rhs;
+	});
+	pagesToLoad.erase(std::unique(pagesToLoad.begin(), pagesToLoad.end()), pagesToLoad.end());
+
+	// Ready for the frame recorded next with this buffer
+	header = FeedbackHeader{ static_cast<uint32_t>(m_frame), kFeedbackCapacity, 0, 0 };
+	feedbackBuffer.Flush(0, sizeof(FeedbackHeader));
+	return pagesToLoad;
+}
+
+void VirtualTextureCache::StartPageLoad(uint32_t pageID)
+{
+	using namespace VirtualTextureCache_Private;
+
+	// The page with a border of a block, the borders of pages on the edges wrap around like the repeat address mode
+	constexpr uint32_t kSlotBlockCount = kSlotSize / kBlockExtent;
+	const VirtualTexture& texture = m_textures.at(GetPageTextureIndex(pageID));
+	auto load = std::make_unique<PageLoad>();
+	load->data.resize(size_t{ kSlotBlockCount } * kSlotBlockCount * Ktx2File::GetBlockSize(texture.file.GetFormat()));
+
+	constexpr int32_t kBorderBlockCount = static_cast<int32_t>(kPageBorder / kBlockExtent);
+	const int32_t blockX = static_cast<int32_t>(GetPageX(pageID) * kPageSize / kBlockExtent) - kBorderBlockCount;
+	const int32_t blockY = static_cast<int32_t>(GetPageY(pageID) * kPageSize / kBlockExtent) - kBorderBlockCount;
+	m_pageLoadWorkers->Submit([file = &texture.file, level = GetPageLevel(pageID), blockX, blockY, load = load.get()]() {
+		load->hasFailed = !file->ReadBlocks(level, blockX, blockY, kSlotBlockCount, kSlotBlockCount, load->data.data());
+		load->isLoaded.store(true, std::memory_order_release);
+	});
+	m_pageLoads.emplace(pageID, std::move(load));
+}
+
+uint32_t VirtualTextureCache::FindFreeSlot(const PageCache& pageCache) const
+{
+	// Slots are few, a linear search is enough
+	uint32_t leastRecentSlot = 0;
+	for (uint32_t i = 0; i < pageCache.slots.size(); ++i)
+	{
+		if (pageCache.slots[i].pageID == kNoPage)
+			return i;
+		if (pageCache.slots[i].lastUsedFrame < pageCache.slots[leastRecentSlot].lastUsedFrame)
+			leastRecentSlot = i;
+	}
+	return pageCache.slots[leastRecentSlot].lastUsedFrame < m_frame ? leastRecentSlot : kNoPage;
+}
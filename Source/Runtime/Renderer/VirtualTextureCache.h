@@ -0,0 +1,148 @@
+#pragma once
+
+#include <Renderer/BindlessDefines.h>
+#include <Renderer/Ktx2File.h>
+#include <RHI/Image.h>
+#include <RHI/constants.h>
+#include <WorkerPool.h>
+#include <vulkan/vulkan.hpp>
+
+#include <gsl/pointers>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class BindlessDescriptors;
+class CommandRingBuffer;
+struct UniqueBuffer;
+
+// Keeps only the pages of large textures seen on screen in video memory, whatever the number of textures.
+// The finest mip levels of a virtual texture are split in pages of kPageSize x kPageSize texels, loaded pages are
+// copied to a page cache texture shared by the textures of the same format. Shaders find pages through a page table
+// and fall back to coarser pages, then to the coarsest levels of the texture, see SampleTexture2D() in bindless.glsl.
+// Shaders also write the pages they miss to a small feedback buffer, read back once their frame completes.
+class VirtualTextureCache
+{
+public:
+	// Match bindless.glsl
+	static constexpr uint32_t kPageSize = 128;
+	static constexpr uint32_t kPageBorder = 4; // texels of the neighboring pages around each page, for filtering
+	static constexpr uint32_t kFeedbackCapacity = 1 << 16;
+
+	static constexpr uint32_t kMaxPagesPerAxis = 512;
+	static constexpr uint32_t kMaxPageTableSize = 1 << 20; // entries for the pages of all textures
+	static constexpr uint32_t kPageCacheSlotsPerAxis = 30; // 4080x4080 texels per format
+
+	explicit VirtualTextureCache(BindlessDescriptors& bindlessDescriptors);
+
+	// Waits for the pages being read
+	~VirtualTextureCache();
+
+	// Levels split in pages, those at least a page wide. 0 if the texture can't be virtual: the file must not be
+	// supercompressed to read pages on their own, its size must be a power of two and it needs levels smaller than a page.
+	static uint32_t GetVirtualLevelCount(const Ktx2File& file);
+
+	// The texture of the handle holds the levels of the file past the virtual ones, pages of virtual levels are then read
+	// from the file. Returns false if the page table is full.
+	bool AddTexture(TextureHandle textureHandle, Ktx2File file, vk::Format format);
+
+	BufferHandle GetPageTableBufferHandle() const { return m_pageTableBufferHandle; }
+
+	// One per frame in flight
+	const std::array<BufferHandle, RHIConstants::kMaxFramesInFlight>& GetFeedbackBufferHandles() const { return m_feedbackBufferHandles; }
+
+	// Once per frame before the passes sampling virtual textures, when the commands of the last frame using frameIndex
+	// have completed. Reads the pages missed by that frame, then copies the pages loaded since the last update.
+	void Update(CommandRingBuffer& commandRingBuffer, uint32_t frameIndex);
+
+	// After the passes sampling virtual textures, so that the CPU can read the feedback once the frame completes
+	void RecordFeedbackBarrier(vk::CommandBuffer commandBuffer) const;
+
+private:
+	static constexpr uint32_t kSlotSize = kPageSize + 2 * kPageBorder;
+	static constexpr uint32_t kNoPage = ~0U;
+
+	// Limit the staging memory of pages, and the time spent uploading them each frame
+	static constexpr size_t kMaxPageLoadCount = 64;
+	static constexpr size_t kMaxPageUploadCount = 32;
+
+	// Page IDs are written by shaders: textureHandle (10 bits), level (4 bits), y (9 bits), x (9 bits)
+	static uint32_t MakePageID(uint32_t textureIndex, uint32_t level, uint32_t x, uint32_t y) { return (textureIndex << 22) | (level << 18) | (y << 9) | x; }
+	static uint32_t GetPageTextureIndex(uint32_t pageID) { return pageID >> 22; }
+	static uint32_t GetPageLevel(uint32_t pageID) { return (pageID >> 18) & 0xf; }
+	static uint32_t GetPageX(uint32_t pageID) { return pageID & 0x1ff; }
+	static uint32_t GetPageY(uint32_t pageID) { return (pageID >> 9) & 0x1ff; }
+
+	struct Slot
+	{
+		uint32_t pageID = kNoPage;
+		uint64_t lastUsedFrame = 0;
+	};
+
+	// Texture of kPageCacheSlotsPerAxis x kPageCacheSlotsPerAxis slots holding a page and its borders
+	struct PageCache
+	{
+		vk::Format format = vk::Format::eUndefined;
+		std::unique_ptr<Image> image;
+		TextureHandle textureHandle = TextureHandle::Invalid;
+		std::vector<Slot> slots;
+		bool isInitialized = false;
+	};
+
+	struct VirtualTexture
+	{
+		Ktx2File file;
+		uint32_t pageCacheIndex = 0;
+		uint32_t levelCount = 0;
+		uint32_t firstPage = 0; // of level 0 in the page table, coarser levels follow
+		bool hasFailed = false; // pages can't be read anymore, no more requests
+	};
+
+	// Blocks of a page and its borders read by a worker thread
+	struct PageLoad
+	{
+		std::vector<std::byte> data;
+		std::atomic<bool> isLoaded = false;
+		bool hasFailed = false;
+	};
+
+	const VirtualTexture* FindTexture(uint32_t pageID) const;
+	uint32_t GetPageTableIndex(uint32_t pageID) const;
+
+	// Marks the resident pages of the feedback as used, returns the pages to load
+	std::vector<uint32_t> ReadFeedback(uint32_t frameIndex);
+
+	void StartPageLoad(uint32_t pageID);
+
+	// Least recently used slot of a page cache, kNoPage if all slots were used by the last frame read back
+	uint32_t FindFreeSlot(const PageCache& pageCache) const;
+
+	gsl::not_null<BindlessDescriptors*> m_bindlessDescriptors;
+
+	vk::UniqueSampler m_pageCacheSampler;
+	std::vector<PageCache> m_pageCaches;
+
+	// Indexed by the handle of their coarsest levels, like the page IDs written by shaders
+	std::unordered_map<uint32_t, VirtualTexture> m_textures;
+	std::vector<uint32_t> m_texturesToDescribe;
+	uint32_t m_pageTableSize = 0;
+
+	// VirtualTextureBuffer in bindless.glsl, descriptions of the textures followed by the page table
+	std::unique_ptr<UniqueBuffer> m_pageTableBuffer;
+	BufferHandle m_pageTableBufferHandle = BufferHandle::Invalid;
+	bool m_isPageTableCleared = false;
+
+	std::array<std::unique_ptr<UniqueBuffer>, RHIConstants::kMaxFramesInFlight> m_feedbackBuffers;
+	std::array<BufferHandle, RHIConstants::kMaxFramesInFlight> m_feedbackBufferHandles;
+
+	std::unordered_map<uint32_t, uint32_t> m_pageToSlot; // resident pages
+	std::unordered_map<uint32_t, std::unique_ptr<PageLoad>> m_pageLoads;
+	uint64_t m_frame = 0;
+
+	// Destroyed first, waits for the pages being read
+	std::unique_ptr<WorkerPool> m_pageLoadWorkers;
+};
@@ -0,0 +1,539 @@
+#include <TextureCompression.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTURE_COMPRESSION_SSE2
+#endif
+
+namespace
+{
+	constexpr uint32_t kBlockPixelCount = 16;
+
+	using Color = std::array<float, 4>;
+
+	constexpr Color kRgbWeights = { 1.0f, 1.0f, 1.0f, 0.0f };
+	constexpr Color kRgbaWeights = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	// Pixels of a 4x4 block, one array per channel to compare 4 pixels at once
+	struct Block
+	{
+		alignas(16) float channels[4][kBlockPixelCount];
+	};
+
+	void LoadBlock(gsl::span<const uint8_t> rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block)
+	{
+		for (uint32_t y = 0; y < 4; ++y)
+		{
+			const uint32_t srcY = (std::min)(blockY * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; ++x)
+			{
+				const uint32_t srcX = (std::min)(blockX * 4 + x, width - 1);
+				const uint8_t* pixel = &rgba[(size_t{ srcY } * width + srcX) * 4];
+				for (uint32_t c = 0; c < 4; ++c)
+					block.channels[c][y * 4 + x] = pixel[c];
+			}
+		}
+	}
+
+	// Picks the closest palette entry of each pixel with distances weighted per channel,
+	// returns the sum of the squared distances
+	float SelectIndices(const Block& block, const Color* palette, uint32_t paletteSize, const Color& weights, uint8_t indices[kBlockPixelCount])
+	{
+		float error = 0.0f;
+#ifdef TEXTURE_COMPRESSION_SSE2
+		for (uint32_t i = 0; i < kBlockPixelCount; i += 4)
+		{
+			__m128 bestDistance = _mm_set1_ps((std::numeric_limits<float>::max)());
+			__m128i bestIndex = _mm_setzero_si128();
+			for (uint32_t p = 0; p < paletteSize; ++p)
+			{
+				__m128 distance = _mm_setzero_ps();
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					__m128 diff = _mm_sub_ps(_mm_load_ps(&block.channels[c][i]), _mm_set1_ps(palette[p][c]));
+					distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(diff, diff), _mm_set1_ps(weights[c])));
+				}
+				__m128i isCloser = _mm_castps_si128(_mm_cmplt_ps(distance, bestDistance));
+				bestDistance = _mm_min_ps(distance, bestDistance);
+				bestIndex = _mm_or_si128(_mm_and_si128(isCloser, _mm_set1_epi32(static_cast<int>(p))), _mm_andnot_si128(isCloser, bestIndex));
+			}
+
+			alignas(16) int32_t laneIndices[4];
+			alignas(16) float laneDistances[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(laneIndices), bestIndex);
+			_mm_store_ps(laneDistances, bestDistance);
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				indices[i + lane] = static_cast<uint8_t>(laneIndices[lane]);
+				error += laneDistances[lane];
+			}
+		}
+#else
+		for (uint32_t i = 0; i < kBlockPixelCount; ++i)
+		{
+			float bestDistance = (std::numeric_limits<float>::max)();
+			for (uint32_t p = 0; p < paletteSize; ++p)
+			{
+				float distance = 0.0f;
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					const float diff = block.channels[c][i] - palette[p][c];
+					distance += diff * diff * weights[c];
+				}
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					indices[i] = static_cast<uint8_t>(p);
+				}
+			}
+			error += bestDistance;
+		}
+#endif
+		return error;
+	}
+
+	// Segment along the main direction of the pixels (power iteration on their covariance),
+	// between the extreme projections of the pixels
+	void FitLine(const Block& block, uint32_t channelCount, Color& start, Color& end)
+	{
+		Color mean = {};
+		Color minColor = { 255.0f, 255.0f, 255.0f, 255.0f };
+		Color maxColor = {};
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			for (uint32_t i = 0; i < kBlockPixelCount; ++i)
+			{
+				mean[c] += block.channels[c][i];
+				minColor[c] = (std::min)(minColor[c], block.channels[c][i]);
+				maxColor[c] = (std::max)(maxColor[c], block.channels[c][i]);
+			}
+			mean[c] /= kBlockPixelCount;
+		}
+
+		float covariance[4][4] = {};
+		for (uint32_t i = 0; i < kBlockPixelCount; ++i)
+		{
+			for (uint32_t a = 0; a < channelCount; ++a)
+			{
+				for (uint32_t b = 0; b < channelCount; ++b)
+					covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+			}
+		}
+
+		// Start from the diagonal of the bounding box
+		Color axis = {};
+		for (uint32_t c = 0; c < channelCount; ++c)
+			axis[c] = maxColor[c] - minColor[c];
+
+		for (uint32_t iteration = 0; iteration < 8; ++iteration)
+		{
+			Color next = {};
+			float maxComponent = 0.0f;
+			for (uint32_t a = 0; a < channelCount; ++a)
+			{
+				for (uint32_t b = 0; b < channelCount; ++b)
+					next[a] += covariance[a][b] * axis[b];
+				maxComponent = (std::max)(maxComponent, std::abs(next[a]));
+			}
+			if (maxComponent == 0.0f)
+				break; // uniform block, or already the main direction of a flat distribution
+			for (uint32_t c = 0; c < channelCount; ++c)
+				axis[c] = next[c] / maxComponent;
+		}
+
+		float length = 0.0f;
+		for (uint32_t c = 0; c < channelCount; ++c)
+			length += axis[c] * axis[c];
+		length = std::sqrt(length);
+
+		float minT = 0.0f, maxT = 0.0f;
+		if (length > 0.0f)
+		{
+			for (uint32_t c = 0; c < channelCount; ++c)
+				axis[c] /= length;
+
+			minT = (std::numeric_limits<float>::max)();
+			maxT = std::numeric_limits<float>::lowest();
+			for (uint32_t i = 0; i < kBlockPixelCount; ++i)
+			{
+				float t = 0.0f;
+				for (uint32_t c = 0; c < channelCount; ++c)
+					t += (block.channels[c][i] - mean[c]) * axis[c];
+				minT = (std::min)(minT, t);
+				maxT = (std::max)(maxT, t);
+			}
+		}
+
+		start = {};
+		end = {};
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			start[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+			end[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+		}
+	}
+
+	// Least squares endpoints for fixed interpolation weights of the pixels, in [0, 1] from start to end.
+	// Returns false when all the pixels use the same weight.
+	bool FitEndpoints(const Block& block, uint32_t channelCount, const float weights[kBlockPixelCount], Color& start, Color& end)
+	{
+		float a = 0.0f, b = 0.0f, c = 0.0f;
+		Color x0 = {}, x1 = {};
+		for (uint32_t i = 0; i < kBlockPixelCount; ++i)
+		{
+			const float t = weights[i];
+			a += (1.0f - t) * (1.0f - t);
+			b += (1.0f - t) * t;
+			c += t * t;
+			for (uint32_t channel = 0; channel < channelCount; ++channel)
+			{
+				x0[channel] += (1.0f - t) * block.channels[channel][i];
+				x1[channel] += t * block.channels[channel][i];
+			}
+		}
+
+		const float determinant = a * c - b * b;
+		if (std::abs(determinant) < 1e-6f)
+			return false;
+
+		for (uint32_t channel = 0; channel < channelCount; ++channel)
+		{
+			start[channel] = std::clamp((c * x0[channel] - b * x1[channel]) / determinant, 0.0f, 255.0f);
+			end[channel] = std::clamp((a * x1[channel] - b * x0[channel]) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	void WriteLittleEndian(uint64_t value, uint32_t byteCount, std::byte* dst)
+	{
+		for (uint32_t i = 0; i < byteCount; ++i)
+			dst[i] = static_cast<std::byte>((value >> (8 * i)) & 0xFF);
+	}
+
+	// --- BC1 --- //
+
+	constexpr std::array<float, 4> kBc1Weights = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	uint16_t ToRgb565(const Color& color)
+	{
+		auto quantize = [](float value, uint32_t maxValue) {
+			return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 255.0f) * maxValue / 255.0f));
+		};
+		return static_cast<uint16_t>((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+	}
+
+	Color FromRgb565(uint16_t value)
+	{
+		const uint32_t r = (value >> 11) & 0x1F;
+		const uint32_t g = (value >> 5) & 0x3F;
+		const uint32_t b = value & 0x1F;
+		return { float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2)), 0.0f };
+	}
+
+	struct Bc1Block
+	{
+		uint16_t color0 = 0;
+		uint16_t color1 = 0;
+		uint8_t indices[kBlockPixelCount] = {};
+		float error = 0.0f;
+	};
+
+	// Always in 4-color mode (color0 > color1), the only mode of the color block of BC3
+	Bc1Block EncodeBc1Colors(const Block& block, const Color& start, const Color& end)
+	{
+		Bc1Block bc1;
+		bc1.color0 = ToRgb565(start);
+		bc1.color1 = ToRgb565(end);
+		if (bc1.color0 < bc1.color1)
+			std::swap(bc1.color0, bc1.color1);
+
+		const Color c0 = FromRgb565(bc1.color0);
+		const Color c1 = FromRgb565(bc1.color1);
+		Color palette[4] = { c0, c1 };
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2.0f * c0[c] + c1[c]) / 3.0f;
+			palette[3][c] = (c0[c] + 2.0f * c1[c]) / 3.0f;
+		}
+
+		// Equal colors only have one usable entry
+		const uint32_t paletteSize = bc1.color0 == bc1.color1 ? 1 : 4;
+		bc1.error = SelectIndices(block, palette, paletteSize, kRgbWeights, bc1.indices);
+		return bc1;
+	}
+
+	void EncodeBc1(const Block& block, std::byte* dst)
+	{
+		Color start, end;
+		FitLine(block, 3, start, end);
+		Bc1Block bc1 = EncodeBc1Colors(block, start, end);
+
+		// Refit the endpoints to the selected indices
+		float weights[kBlockPixelCount];
+		for (uint32_t i = 0; i < kBlockPixelCount; ++i)
+			weights[i] = kBc1Weights[bc1.indices[i]];
+		if (bc1.color0 != bc1.color1 && FitEndpoints(block, 3, weights, start, end))
+		{
+			Bc1Block refined = EncodeBc1Colors(block, start, end);
+			if (refined.error < bc1.error)
+				bc1 = refined;
+		}
+
+		uint32_t indexBits = 0;
+		for (uint32_t i = 0; i < kBlockPixelCount; ++i)
+			indexBits |= uint32_t{ bc1.indices[i] } << (2 * i);
+		WriteLittleEndian(bc1.color0, 2, dst);
+		WriteLittleEndian(bc1.color1, 2, dst + 2);
+		WriteLittleEndian(indexBits, 4, dst + 4);
+	}
+
+	// --- BC4 --- //
+
+	void EncodeBc4(const Block& block, uint32_t channel, std::byte* dst)
+	{
+		const auto [minValue, maxValue] = std::minmax_element(std::begin(block.channels[channel]), std::end(block.channels[channel]));
+		const uint8_t a0 = static_cast<uint8_t>(*maxValue);
+		const uint8_t a1 = static_cast<uint8_t>(*minValue);
+
+		// 8 values when a0 > a1, a0 is used by all pixels otherwise
+		Color palette[8] = {};
+		palette[0][channel] = a0;
+		palette[1][channel] = a1;
+		for (uint32_t i = 2; i < 8; ++i)
+			palette[i][channel] = ((8 - i) * float(a0) + (i - 1) * float(a1)) / 7.0f;
+
+		Color weights = {};
+		weights[channel] = 1.0f;
+		uint8_t indices[kBlockPixelCount] = {};
+		if (a0 > a1)
+			SelectIndices(block, palette, 8, weights, indices);
+
+		uint64_t indexBits = 0;
+		for (uint32_t i = 0; i < kBlockPixelCount; ++i)
+			indexBits |= uint64_t{ indices[i] } << (3 * i);
+		dst[0] = static_cast<std::byte>(a0);
+		dst[1] = static_cast<std::byte>(a1);
+		WriteLittleEndian(indexBits, 6, dst + 2);
+	}
+
+	// --- BC7 mode 6 --- //
+
+	constexpr std::array<uint32_t, 16> kBc7Weights = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// 7 bits per channel and a p-bit shared by the channels, which is the low bit of the 8-bit values
+	struct Bc7Endpoint
+	{
+		uint8_t color[4] = {};
+		uint8_t pBit = 0;
+
+		uint32_t Expand(uint32_t channel) const { return (uint32_t{ color[channel] } << 1) | pBit; }
+	};
+
+	Bc7Endpoint QuantizeBc7Endpoint(const Color& color)
+	{
+		Bc7Endpoint best;
+		float bestError = (std::numeric_limits<float>::max)();
+		for (uint8_t pBit = 0; pBit < 2; ++pBit)
+		{
+			Bc7Endpoint endpoint;
+			endpoint.pBit = pBit;
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				endpoint.color[c] = static_cast<uint8_t>(std::clamp(std::lround((color[c] - pBit) / 2.0f), 0L, 127L));
+				const float diff = float(endpoint.Expand(c)) - color[c];
+				error += diff * diff;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				best = endpoint;
+			}
+		}
+		return best;
+	}
+
+	struct Bc7Block
+	{
+		Bc7Endpoint endpoints[2];
+		uint8_t indices[kBlockPixelCount] = {};
+		float error = 0.0f;
+	};
+
+	Bc7Block EncodeBc7Colors(const Block& block, const Color& start, const Color& end)
+	{
+		Bc7Block bc7;
+		bc7.endpoints[0] = QuantizeBc7Endpoint(start);
+		bc7.endpoints[1] = QuantizeBc7Endpoint(end);
+
+		Color palette[16];
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			for (uint32_t c = 0; c < 4; ++c)
+				palette[i][c] = float(((64 - kBc7Weights[i]) * bc7.endpoints[0].Expand(c) + kBc7Weights[i] * bc7.endpoints[1].Expand(c) + 32) >> 6);
+		}
+		bc7.error = SelectIndices(block, palette, 16, kRgbaWeights, bc7.indices);
+		return bc7;
+	}
+
+	// Writes the low bitCount bits of value after the bits written so far, from the least significant bit of the block
+	struct BitWriter
+	{
+		uint64_t bits[2] = {};
+		uint32_t position = 0;
+
+		void Write(uint32_t value, uint32_t bitCount)
+		{
+			for (uint32_t i = 0; i < bitCount; ++i, ++position)
+				bits[position / 64] |= uint64_t{ (value >> i) & 1 } << (position % 64);
+		}
+	};
+
+	void EncodeBc7(const Block& block, std::byte* dst)
+	{
+		Color start, end;
+		FitLine(block, 4, start, end);
+		Bc7Block bc7 = EncodeBc7Colors(block, start, end);
+
+		// Refit the endpoints to the selected indices
+		float weights[kBlockPixelCount];
+		for (uint32_t i = 0; i < kBlockPixelCount; ++i)
+			weights[i] = kBc7Weights[bc7.indices[i]] / 64.0f;
+		if (FitEndpoints(block, 4, weights, start, end))
+		{
+			Bc7Block refined = EncodeBc7Colors(block, start, end);
+			if (refined.error < bc7.error)
+				bc7 = refined;
+		}
+
+		// The most significant bit of the first index is implicitly 0
+		if (bc7.indices[0] >= 8)
+		{
+			std::swap(bc7.endpoints[0], bc7.endpoints[1]);
+			for (uint8_t& index : bc7.indices)
+				index = 15 - index;
+		}
+
+		BitWriter writer;
+		writer.Write(1 << 6, 7); // mode 6
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			writer.Write(bc7.endpoints[0].color[c], 7);
+			writer.Write(bc7.endpoints[1].color[c], 7);
+		}
+		writer.Write(bc7.endpoints[0].pBit, 1);
+		writer.Write(bc7.endpoints[1].pBit, 1);
+		writer.Write(bc7.indices[0], 3);
+		for (uint32_t i = 1; i < kBlockPixelCount; ++i)
+			writer.Write(bc7.indices[i], 4);
+		assert(writer.position == 128);
+
+		WriteLittleEndian(writer.bits[0], 8, dst);
+		WriteLittleEndian(writer.bits[1], 8, dst + 8);
+	}
+
+	float SrgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float LinearToSrgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+}
+
+uint32_t GetBlockFormatSize(BlockFormat format)
+{
+	return format == BlockFormat::eBC1 || format == BlockFormat::eBC4 ? 8 : 16;
+}
+
+size_t GetEncodedImageSize(BlockFormat format, uint32_t width, uint32_t height)
+{
+	return size_t{ (std::max)((width + 3) / 4, 1u) } * (std::max)((height + 3) / 4, 1u) * GetBlockFormatSize(format);
+}
+
+void EncodeBlocks(BlockFormat format, gsl::span<const uint8_t> rgba, uint32_t width, uint32_t height, gsl::span<std::byte> dst)
+{
+	assert(rgba.size() >= size_t{ width } * height * 4);
+	assert(dst.size() >= GetEncodedImageSize(format, width, height));
+
+	const uint32_t blockCountX = (std::max)((width + 3) / 4, 1u);
+	const uint32_t blockCountY = (std::max)((height + 3) / 4, 1u);
+	const uint32_t blockSize = GetBlockFormatSize(format);
+
+	Block block;
+	std::byte* blockData = dst.data();
+	for (uint32_t blockY = 0; blockY < blockCountY; ++blockY)
+	{
+		for (uint32_t blockX = 0; blockX < blockCountX; ++blockX, blockData += blockSize)
+		{
+			LoadBlock(rgba, width, height, blockX, blockY, block);
+			switch (format)
+			{
+			case BlockFormat::eBC1:
+				EncodeBc1(block, blockData);
+				break;
+			case BlockFormat::eBC3:
+				EncodeBc4(block, 3, blockData);
+				EncodeBc1(block, blockData + 8);
+				break;
+			case BlockFormat::eBC4:
+				EncodeBc4(block, 0, blockData);
+				break;
+			case BlockFormat::eBC5:
+				EncodeBc4(block, 0, blockData);
+				EncodeBc4(block, 1, blockData + 8);
+				break;
+			case BlockFormat::eBC7:
+				EncodeBc7(block, blockData);
+				break;
+			}
+		}
+	}
+}
+
+std::vector<uint8_t> DownsampleImage(gsl::span<const uint8_t> rgba, uint32_t width, uint32_t height, bool isSrgb)
+{
+	static const std::array<float, 256> srgbToLinear = []() {
+		std::array<float, 256> table;
+		for (uint32_t i = 0; i < table.size(); ++i)
+			table[i] = SrgbToLinear(i / 255.0f);
+		return table;
+	}();
+
+	const uint32_t dstWidth = (std::max)(width / 2, 1u);
+	const uint32_t dstHeight = (std::max)(height / 2, 1u);
+	std::vector<uint8_t> dst(size_t{ dstWidth } * dstHeight * 4);
+	for (uint32_t y = 0; y < dstHeight; ++y)
+	{
+		const uint32_t srcRows[2] = { (std::min)(2 * y, height - 1), (std::min)(2 * y + 1, height - 1) };
+		for (uint32_t x = 0; x < dstWidth; ++x)
+		{
+			const uint32_t srcColumns[2] = { (std::min)(2 * x, width - 1), (std::min)(2 * x + 1, width - 1) };
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const bool isLinearized = isSrgb && c < 3;
+				float sum = 0.0f;
+				for (uint32_t srcY : srcRows)
+				{
+					for (uint32_t srcX : srcColumns)
+					{
+						const uint8_t value = rgba[(size_t{ srcY } * width + srcX) * 4 + c];
+						sum += isLinearized ? srgbToLinear[value] : value;
+					}
+				}
+				const float average = isLinearized ? LinearToSrgb(sum / 4.0f) * 255.0f : sum / 4.0f;
+				dst[(size_t{ y } * dstWidth + x) * 4 + c] = static_cast<uint8_t>(std::clamp(std::lround(average), 0L, 255L));
+			}
+		}
+	}
+	return dst;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <gsl/span>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU encoding of RGBA8 images to block-compressed formats, for sources that don't come compressed.
+// Images are split in 4x4 pixel blocks encoded independently, pixels past the edges repeat the last row or column.
+
+enum class BlockFormat
+{
+	eBC1, // RGB, alpha is ignored
+	eBC3, // RGBA
+	eBC4, // R
+	eBC5, // RG
+	eBC7, // RGBA, mode 6 only (single subset with 4-bit indices)
+};
+
+// Bytes per 4x4 block
+uint32_t GetBlockFormatSize(BlockFormat format);
+
+size_t GetEncodedImageSize(BlockFormat format, uint32_t width, uint32_t height);
+
+// Encodes width * height RGBA8 pixels to dst, GetEncodedImageSize() bytes. Pixels of a block are matched
+// to their palette with SSE2 when available.
+void EncodeBlocks(BlockFormat format, gsl::span<const uint8_t> rgba, uint32_t width, uint32_t height, gsl::span<std::byte> dst);
+
+// Box-filtered RGBA8 image of half the size, at least 1x1. Color channels are averaged in linear space when isSrgb.
+std::vector<uint8_t> DownsampleImage(gsl::span<const uint8_t> rgba, uint32_t width, uint32_t height, bool isSrgb);
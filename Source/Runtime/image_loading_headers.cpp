@@ -1,3 +1,5 @@
+// Decode the blocks of an image in parallel
+#define TINYEXR_USE_THREAD 1
 #define TINYEXR_IMPLEMENTATION
 #include <tinyexr.h>
 
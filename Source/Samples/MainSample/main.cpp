@@ -10,6 +10,10 @@
 #include <Renderer/CameraViewSystem.h>
 #include <Renderer/Renderer.h>
 #include <Renderer/RenderScene.h>
+#include <Renderer/MeshAllocator.h>
+#include <Renderer/SceneTree.h>
+#include <Renderer/TextureCache.h>
+#include <RHI/Device.h>
 #include <RHI/Window.h>
 #include <RHI/vk_utils.h>
 #include <ArgumentParser.h>
@@ -28,16 +32,29 @@ public:
 		bool showShadowMapPreview = false;
 	} m_options;
 
-	App(VkInstance instance, vk::SurfaceKHR surface, vk::Extent2D extent, Window& window, std::string basePath, std::string sceneFile)
+	App(VkInstance instance, vk::SurfaceKHR surface, vk::Extent2D extent, Window& window, std::string basePath, std::string sceneFile, VertexFormat vertexFormat,
+		TextureCompression textureCompression, std::filesystem::path textureCacheDirectory, std::optional<vk::DeviceSize> textureBudget, bool useVirtualTextures,
+		bool validateCulling)
 		: Renderer(instance, surface, extent, window)
 		, m_scene(std::make_unique<AssimpSceneLoader>(std::move(basePath), std::move(sceneFile), *this))
+		, m_isValidatingCulling(validateCulling)
 	{
+		if (validateCulling)
+			GetRenderScene()->EnableGPUCullingValidation();
+		GetRenderScene()->GetMeshAllocator()->SetVertexFormat(vertexFormat);
+		GetTextureCache()->SetCompression(textureCompression, std::move(textureCacheDirectory));
+		if (textureBudget.has_value())
+			GetTextureCache()->SetStreamingBudget(*textureBudget);
+		if (useVirtualTextures)
+			GetTextureCache()->EnableVirtualTexturing();
 		window.SetMouseButtonCallback(reinterpret_cast<void*>(&m_inputSystem), InputSystem::OnMouseButton);
 		window.SetMouseScrollCallback(reinterpret_cast<void*>(&m_inputSystem), InputSystem::OnMouseScroll);
 		window.SetCursorPositionCallback(reinterpret_cast<void*>(&m_inputSystem), InputSystem::OnCursorPosition);
 		window.SetKeyCallback(reinterpret_cast<void*>(&m_inputSystem), InputSystem::OnKey);
 	}
 
+	bool IsCullingValid() const { return m_isCullingValid; }
+
 protected:
 	Inputs m_inputs;
 
@@ -72,6 +89,13 @@ protected:
 
 	void Update() override
 	{
+		if (m_isValidatingCulling)
+		{
+			ValidateCulling();
+			Renderer::Update();
+			return;
+		}
+
 		std::chrono::duration<float> dt_s = GetDeltaTime();
 		const Inputs& inputs = m_inputSystem.GetFrameInputs();
 		HandleOptionsKeys(inputs);
@@ -140,9 +164,53 @@ protected:
 				static_cast<ViewDebugEquation>(m_imGuiState.selectedViewDebugEquation));
 		}
 
+		// Geometry heaps, fragmentation is 0 when all free space is contiguous
+		gsl::not_null<MeshAllocator*> meshAllocator = m_renderScene->GetMeshAllocator();
+		const std::pair<const char*, const GeometryHeap*> heaps[] = {
+			{ "Vertices", &meshAllocator->GetVertexHeap() },
+			{ "Indices", &meshAllocator->GetIndexHeap(vk::IndexType::eUint32) },
+			{ "Indices (16-bit)", &meshAllocator->GetIndexHeap(vk::IndexType::eUint16) },
+		};
+		ImGui::Separator();
+		for (const auto& [name, heap] : heaps)
+		{
+			const OffsetAllocator::Stats stats = heap->GetStats();
+			const float toMiB = static_cast<float>(heap->GetElementSize()) / (1 << 20);
+			ImGui::Text("%s: %.1f / %.1f MiB, %u free ranges, fragmentation %.2f",
+				name, stats.usedSize * toMiB, stats.size * toMiB, stats.freeRangeCount, stats.GetFragmentation());
+		}
+
+		// Scene node whose bounding box is under the cursor
+		ImGui::Separator();
+		if (!ImGui::GetIO().WantCaptureMouse)
+		{
+			const Camera& camera = m_renderScene->GetCameraViewSystem()->GetCamera();
+			const ImVec2 framebufferScale = ImGui::GetIO().DisplayFramebufferScale;
+			const glm::vec2 cursorPixel = m_inputSystem.GetFrameInputs().cursorPos * glm::vec2(framebufferScale.x, framebufferScale.y);
+			m_hoveredNode = m_renderScene->GetSceneTree()->PickNode(camera.GetEye(), camera.ComputeRayDirection(cursorPixel));
+		}
+		if (m_hoveredNode != SceneNodeHandle::Invalid)
+			ImGui::Text("Node under cursor: %u", static_cast<uint32_t>(m_hoveredNode));
+		else
+			ImGui::Text("Node under cursor: none");
+
 		ImGui::End();
 	}
 
+	// Renders from the initial camera until every frame in flight culled the same views,
+	// then compares the counts of the last frame with CPU culling and closes the window
+	void ValidateCulling()
+	{
+		if (++m_validationFrameCount <= RHIConstants::kMaxFramesInFlight + 1)
+			return;
+
+		g_device->Get().waitIdle();
+		const uint32_t lastFrameIndex = (GetFrameIndex() + RHIConstants::kMaxFramesInFlight - 1) % RHIConstants::kMaxFramesInFlight;
+		m_isCullingValid = m_renderScene->ValidateGPUCulling(lastFrameIndex);
+		std::cout << "GPU culling " << (m_isCullingValid ? "matches" : "doesn't match") << " CPU culling" << std::endl;
+		m_window.Close();
+	}
+
 	bool HandleOptionsKeys(const Inputs& inputs)
 	{
 		auto it = inputs.keyState.find(GLFW_KEY_G);
@@ -156,8 +224,12 @@ protected:
 
 private:
 	InputSystem m_inputSystem;
+	SceneNodeHandle m_hoveredNode = SceneNodeHandle::Invalid;
 	std::unique_ptr<AssimpSceneLoader> m_scene;
 	std::unique_ptr<CameraController> m_cameraController;
+	bool m_isValidatingCulling = false;
+	bool m_isCullingValid = true;
+	uint32_t m_validationFrameCount = 0;
 };
 
 int main(int argc, char* argv[])
@@ -166,7 +238,12 @@ int main(int argc, char* argv[])
 		.name = "MainSample.exe", .description = "The main sample",
 		.options = std::vector {
 			Argument{ .name = "gameDir", .value = "dirPath" },
-			Argument{ .name = "scenePath", .value = "filePath.dae" }
+			Argument{ .name = "scenePath", .value = "filePath.dae" },
+			Argument{ .name = "vertexFormat", .help = "optional, quantized vertices use half the memory", .value = "float|quantized" },
+			Argument{ .name = "textureCompression", .help = "optional, block-compresses textures on first load", .value = "none|fast|high" },
+			Argument{ .name = "textureBudget", .help = "optional, video memory of streamed mip levels (.ktx2 or compressed textures)", .value = "megabytes" },
+			Argument{ .name = "virtualTextures", .help = "optional, only the pages seen on screen of large .ktx2 or compressed textures are resident", .value = "on|off" },
+			Argument{ .name = "validateCulling", .help = "optional, compares GPU culling with CPU culling from the initial camera then exits", .value = "on|off" }
 		}
 	};
 	ArgumentParser argParser(std::move(args));
@@ -178,6 +255,18 @@ int main(int argc, char* argv[])
 	// todo (hbedard): only if args are valid
 	std::optional<std::string> gameDirectory = argParser.GetString("gameDir");
 	std::optional<std::string> sceneFilePathStr = argParser.GetString("scenePath");
+	const VertexFormat vertexFormat = argParser.GetString("vertexFormat") == "quantized" ? VertexFormat::eQuantized : VertexFormat::eFloat;
+	const std::optional<std::string> textureCompressionStr = argParser.GetString("textureCompression");
+	const TextureCompression textureCompression =
+		textureCompressionStr == "fast" ? TextureCompression::eFast :
+		textureCompressionStr == "high" ? TextureCompression::eHighQuality :
+		TextureCompression::eNone;
+	const std::optional<std::string> textureBudgetStr = argParser.GetString("textureBudget");
+	const std::optional<vk::DeviceSize> textureBudget = textureBudgetStr.has_value() ?
+		std::optional<vk::DeviceSize>(std::stoull(*textureBudgetStr) << 20) :
+		std::nullopt;
+	const bool useVirtualTextures = argParser.GetString("virtualTextures") == "on";
+	const bool validateCulling = argParser.GetString("validateCulling") == "on";
 	// todo (hbedard): check that those are good :)
 
 	std::filesystem::path engineDir = std::filesystem::absolute((std::filesystem::current_path()));
@@ -193,14 +282,18 @@ int main(int argc, char* argv[])
 
 	PhysicalDevice::Init(instance.Get(), surface.get());
 	Device::Init(instance, *g_physicalDevice);
+	bool isCullingValid = true;
 	{
 		std::filesystem::path scenePath(sceneFilePathStr.value());
-		App app(instance.Get(), surface.get(), extent, window, scenePath.parent_path().string(), scenePath.filename().string());
+		App app(instance.Get(), surface.get(), extent, window, scenePath.parent_path().string(), scenePath.filename().string(), vertexFormat,
+			textureCompression, std::filesystem::path(gameDirectory.value()) / "Generated" / "Textures", textureBudget, useVirtualTextures,
+			validateCulling);
 		app.Init();
 		app.Run();
+		isCullingValid = app.IsCullingValid();
 	}
 	Device::Term();
 	PhysicalDevice::Term();
 
-	return 0;
+	return isCullingValid ? 0 : 1;
 }
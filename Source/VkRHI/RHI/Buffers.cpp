@@ -21,6 +21,11 @@ void UniqueBuffer::Flush(VkDeviceSize offset, VkDeviceSize size) const
 	vmaFlushAllocation(g_device->GetAllocator(), m_allocation, offset, size);
 }
 
+void UniqueBuffer::Invalidate(VkDeviceSize offset, VkDeviceSize size) const
+{
+	vmaInvalidateAllocation(g_device->GetAllocator(), m_allocation, offset, size);
+}
+
 UniqueBufferWithStaging::UniqueBufferWithStaging(size_t size, vk::BufferUsageFlags bufferUsage)
 	: m_stagingBuffer(std::make_unique<UniqueBuffer>(
 		vk::BufferCreateInfo({}, size,  vk::BufferUsageFlagBits::eTransferSrc),
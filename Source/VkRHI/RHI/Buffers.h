@@ -27,6 +27,9 @@ struct UniqueBuffer : public DeferredDestructible
 	// Required after writting to mapped data if memory is not HOST_COHERENT
 	void Flush(VkDeviceSize offset, VkDeviceSize size) const;
 
+	// Required before reading mapped data written by the GPU if memory is not HOST_COHERENT
+	void Invalidate(VkDeviceSize offset, VkDeviceSize size) const;
+
 private:
 	size_t m_size;
 	VkBuffer m_buffer;
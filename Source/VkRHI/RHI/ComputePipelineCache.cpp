@@ -0,0 +1,75 @@
+#include <RHI/ComputePipelineCache.h>
+
+#include <RHI/GraphicsPipelineCache.h>
+#include <RHI/Device.h>
+
+ComputePipelineCache::ComputePipelineCache(ShaderCache& shaderCache)
+	: m_shaderCache(&shaderCache)
+{}
+
+void ComputePipelineCache::SetCommonLayout(vk::PipelineLayout pipelineLayout)
+{
+	assert(m_pipelines.empty()); // existing pipelines would keep their layout
+	m_commonPipelineLayout = pipelineLayout;
+}
+
+ComputePipelineID ComputePipelineCache::CreateComputePipeline(ShaderInstanceID computeShaderID)
+{
+	ComputePipelineID id = static_cast<ComputePipelineID>(m_shaders.size());
+	m_shaders.push_back(computeShaderID);
+	m_pipelines.emplace_back();
+	m_descriptorSetLayouts.emplace_back();
+	m_pipelineLayouts.emplace_back();
+
+	if (!m_commonPipelineLayout)
+	{
+		CreateReflectedLayout(id);
+	}
+
+	ResetComputePipeline(id);
+	return id;
+}
+
+void ComputePipelineCache::ResetComputePipeline(ComputePipelineID id)
+{
+	vk::SpecializationInfo specializationInfo;
+	vk::PipelineShaderStageCreateInfo shaderStage = m_shaderCache->GetShaderStageInfo(m_shaders[id], specializationInfo);
+	assert(shaderStage.stage == vk::ShaderStageFlagBits::eCompute);
+
+	vk::ComputePipelineCreateInfo createInfo(
+		{}, // flags
+		shaderStage,
+		GetPipelineLayout(id)
+	);
+	m_pipelines[id] = g_device->Get().createComputePipelineUnique({}, createInfo).value;
+}
+
+vk::PipelineLayout ComputePipelineCache::GetPipelineLayout(ComputePipelineID id) const
+{
+	return m_commonPipelineLayout ? m_commonPipelineLayout : m_pipelineLayouts[id].get();
+}
+
+void ComputePipelineCache::CreateReflectedLayout(ComputePipelineID id)
+{
+	using namespace GraphicsPipelineHelpers;
+
+	const ShaderInstanceID shaderID = m_shaders[id];
+	SmallVector<vk::PushConstantRange> pushConstantRanges = m_shaderCache->GetPushConstantRanges(shaderID);
+	m_descriptorSetLayouts[id] = CreateDescriptorSetLayoutsFromBindings(m_shaderCache->GetDescriptorSetLayoutBindings(shaderID));
+
+	if (m_descriptorSetLayouts[id].empty())
+	{
+		vk::PipelineLayoutCreateInfo pipelineLayoutInfo(
+			{},
+			0, nullptr,
+			static_cast<uint32_t>(pushConstantRanges.size()), pushConstantRanges.data()
+		);
+		m_pipelineLayouts[id] = g_device->Get().createPipelineLayoutUnique(pipelineLayoutInfo);
+		return;
+	}
+
+	// The last layout contains all sets
+	SetVector<vk::UniquePipelineLayout> pipelineLayouts = CreatePipelineLayoutsFromDescriptorSetLayouts(
+		m_descriptorSetLayouts[id], std::move(pushConstantRanges));
+	m_pipelineLayouts[id] = std::move(pipelineLayouts.back());
+}
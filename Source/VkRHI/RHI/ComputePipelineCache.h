@@ -0,0 +1,48 @@
+#pragma once
+
+#include <RHI/ShaderCache.h>
+#include <RHI/SmallVector.h>
+#include <gsl/pointers>
+#include <vulkan/vulkan.hpp>
+
+#include <limits>
+#include <vector>
+
+using ComputePipelineID = uint32_t;
+inline constexpr ComputePipelineID kInvalidComputePipelineID = (std::numeric_limits<uint32_t>::max)();
+
+// Handles all compute pipelines, they share the common layout when one is set,
+// otherwise each pipeline gets a layout generated from its shader reflection.
+class ComputePipelineCache
+{
+public:
+	ComputePipelineCache(ShaderCache& shaderCache);
+
+	ShaderCache& GetShaderCache() const { return *m_shaderCache; }
+
+	void SetCommonLayout(vk::PipelineLayout pipelineLayout);
+
+	ComputePipelineID CreateComputePipeline(ShaderInstanceID computeShaderID);
+
+	// Recreates the pipeline from its shader, e.g. after a shader was reloaded
+	void ResetComputePipeline(ComputePipelineID id);
+
+	vk::Pipeline GetPipeline(ComputePipelineID id) const { return m_pipelines[id].get(); }
+
+	vk::PipelineLayout GetPipelineLayout(ComputePipelineID id) const;
+
+private:
+	void CreateReflectedLayout(ComputePipelineID id);
+
+	gsl::not_null<ShaderCache*> m_shaderCache;
+
+	// ComputePipelineID -> Array Index
+	std::vector<ShaderInstanceID> m_shaders; // [id]
+	std::vector<vk::UniquePipeline> m_pipelines; // [id]
+
+	// Only used without a common layout
+	std::vector<SetVector<vk::UniqueDescriptorSetLayout>> m_descriptorSetLayouts; // [id][set]
+	std::vector<vk::UniquePipelineLayout> m_pipelineLayouts; // [id]
+
+	vk::PipelineLayout m_commonPipelineLayout;
+};
@@ -37,27 +37,47 @@ Device::Device(const Instance& instance, const PhysicalDevice& physicalDevice)
 		);
 	}
 
-	vk::PhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures;
+	// Vulkan 1.2 features include descriptor indexing
+	vk::PhysicalDeviceVulkan12Features vulkan12Features;
 	vk::PhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeature(true);
 	vk::PhysicalDeviceSynchronization2FeaturesKHR synchronizationFeature(true);
-	descriptorIndexingFeatures.pNext = &dynamicRenderingFeature;
+	vulkan12Features.pNext = &dynamicRenderingFeature;
 	dynamicRenderingFeature.pNext = &synchronizationFeature;
 
 	vk::PhysicalDeviceFeatures2 deviceFeatures;
-	deviceFeatures.pNext = descriptorIndexingFeatures;
+	deviceFeatures.pNext = &vulkan12Features;
 	vkGetPhysicalDeviceFeatures2(physicalDevice.Get(), deviceFeatures);
 	deviceFeatures.features.samplerAnisotropy = true;
 
 	// For bindless:
 	// Non-uniform indexing and update after bind
 	// binding flags for textures, uniforms, and buffers
-	assert(descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing);
-	assert(descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind);
-	assert(descriptorIndexingFeatures.shaderUniformBufferArrayNonUniformIndexing);
-	assert(descriptorIndexingFeatures.descriptorBindingUniformBufferUpdateAfterBind);
-	assert(descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing);
-	assert(descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind);
-	assert(descriptorIndexingFeatures.descriptorBindingPartiallyBound);
+	assert(vulkan12Features.shaderSampledImageArrayNonUniformIndexing);
+	assert(vulkan12Features.descriptorBindingSampledImageUpdateAfterBind);
+	assert(vulkan12Features.shaderUniformBufferArrayNonUniformIndexing);
+	assert(vulkan12Features.descriptorBindingUniformBufferUpdateAfterBind);
+	assert(vulkan12Features.shaderStorageBufferArrayNonUniformIndexing);
+	assert(vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind);
+	assert(vulkan12Features.descriptorBindingPartiallyBound);
+	assert(vulkan12Features.descriptorBindingUpdateUnusedWhilePending);
+
+	// For indirect draws:
+	// many draws per call and per-draw data fetched with gl_InstanceIndex
+	assert(deviceFeatures.features.multiDrawIndirect);
+	assert(deviceFeatures.features.drawIndirectFirstInstance);
+
+	// For GPU culling:
+	// draw count written by compute shaders
+	assert(vulkan12Features.drawIndirectCount);
+
+	// For mip generation:
+	// all mip levels written by one dispatch, whatever the format of the texture
+	assert(deviceFeatures.features.shaderStorageImageWriteWithoutFormat);
+	assert(deviceFeatures.features.shaderStorageImageArrayDynamicIndexing);
+
+	// For virtual textures:
+	// pages missed by fragment shaders appended to a feedback buffer
+	assert(deviceFeatures.features.fragmentStoresAndAtomics);
 
 	vk::DeviceCreateInfo createInfo(
 		vk::DeviceCreateFlags{},						// flags
@@ -26,9 +26,15 @@ Image::Image(
 
 void Image::CreateImage(vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::SampleCountFlagBits nbSamples)
 {
+	m_usage = usage;
+
+	vk::ImageCreateFlags flags = m_imageViewType == vk::ImageViewType::eCube ? vk::ImageCreateFlagBits::eCubeCompatible : vk::ImageCreateFlagBits{};
+	if ((usage & vk::ImageUsageFlagBits::eStorage) && GetStorageFormat(m_format) != m_format)
+		flags |= vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage;
+
 	uint32_t queueFamilies[] = { g_physicalDevice->GetQueueFamilies().graphicsFamily.value() };
 	vk::ImageCreateInfo imageInfo(
-		m_imageViewType == vk::ImageViewType::eCube ? vk::ImageCreateFlagBits::eCubeCompatible : vk::ImageCreateFlagBits{},
+		flags,
 		vk::ImageType::e2D,
 		m_format,
 		m_extent,
@@ -114,5 +120,60 @@ void Image::CreateImageView(vk::ImageAspectFlags aspectFlags)
 			0, m_layerCount
 		)
 	);
+
+	// The format of the view doesn't support the storage usage of the image
+	vk::ImageViewUsageCreateInfo usageInfo(m_usage & ~vk::ImageUsageFlags(vk::ImageUsageFlagBits::eStorage));
+	if ((m_usage & vk::ImageUsageFlagBits::eStorage) && GetStorageFormat(m_format) != m_format)
+		createInfo.pNext = &usageInfo;
+
 	m_imageView = g_device->Get().createImageViewUnique(createInfo);
 }
+
+vk::UniqueImageView Image::CreateLayerArrayView(uint32_t mipLevel, vk::ImageUsageFlagBits usage) const
+{
+	assert(m_usage & usage);
+	vk::ImageViewCreateInfo createInfo(
+		vk::ImageViewCreateFlags(),
+		m_image.Get(),
+		vk::ImageViewType::e2DArray,
+		usage == vk::ImageUsageFlagBits::eStorage ? GetStorageFormat(m_format) : m_format,
+		vk::ComponentMapping(vk::ComponentSwizzle::eIdentity),
+		vk::ImageSubresourceRange(
+			vk::ImageAspectFlagBits::eColor,
+			mipLevel, 1,
+			0, m_layerCount
+		)
+	);
+	vk::ImageViewUsageCreateInfo usageInfo(usage);
+	createInfo.pNext = &usageInfo;
+	return g_device->Get().createImageViewUnique(createInfo);
+}
+
+vk::ImageMemoryBarrier2 Image::MakeLayoutBarrier(
+	vk::ImageLayout newLayout,
+	vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+	vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask)
+{
+	vk::ImageMemoryBarrier2 barrier;
+	barrier.srcStageMask = srcStageMask;
+	barrier.srcAccessMask = srcAccessMask;
+	barrier.dstStageMask = dstStageMask;
+	barrier.dstAccessMask = dstAccessMask;
+	barrier.oldLayout = m_imageLayout;
+	barrier.newLayout = newLayout;
+	barrier.image = m_image.Get();
+	barrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, m_mipLevels, 0, m_layerCount);
+
+	m_imageLayout = newLayout;
+	return barrier;
+}
+
+vk::Format Image::GetStorageFormat(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eR8G8B8A8Srgb: return vk::Format::eR8G8B8A8Unorm;
+	case vk::Format::eB8G8R8A8Srgb: return vk::Format::eB8G8R8A8Unorm;
+	default: return format;
+	}
+}
@@ -33,10 +33,28 @@ public:
 
 	const vk::Format& GetFormat() const { return m_format; }
 
+	const vk::Extent3D& GetExtent() const { return m_extent; }
+
 	uint32_t GetMipLevels() const { return m_mipLevels; }
 
+	uint32_t GetLayerCount() const { return m_layerCount; }
+
 	value_type Get() const { return m_image.Get(); }
 
+	// View of a single mip level with all layers, e.g. to read or write the faces of a cube map from a compute shader.
+	// Storage views use GetStorageFormat().
+	vk::UniqueImageView CreateLayerArrayView(uint32_t mipLevel, vk::ImageUsageFlagBits usage) const;
+
+	// Barrier to newLayout over all mip levels and layers, recorded by the caller along with the barriers of other images.
+	// The image is considered in newLayout from then on.
+	vk::ImageMemoryBarrier2 MakeLayoutBarrier(
+		vk::ImageLayout newLayout,
+		vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+		vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask);
+
+	// sRGB formats can't be written by shaders, their images are written through views of the matching UNORM format
+	static vk::Format GetStorageFormat(vk::Format format);
+
 protected:
 	void TransitionLayout(vk::CommandBuffer& commandBuffer, vk::ImageLayout newLayout);
 
@@ -48,6 +66,7 @@ protected:
 	vk::Format m_format;
 	uint32_t m_mipLevels;
 	uint32_t m_layerCount;
+	vk::ImageUsageFlags m_usage;
 	vk::ImageLayout m_imageLayout{ vk::ImageLayout::eUndefined };
 	vk::ImageViewType m_imageViewType;
 	vk::UniqueImageView m_imageView;
@@ -3,6 +3,8 @@
 #include <RHI/Device.h>
 #include <RHI/PhysicalDevice.h>
 
+#include <algorithm>
+
 Texture::Texture(
 	uint32_t width, uint32_t height, uint32_t depth,
 	vk::Format format,
@@ -22,11 +24,61 @@ Texture::Texture(
 {
 }
 
+Texture::Texture(
+	uint32_t width, uint32_t height,
+	vk::Format format,
+	vk::ImageUsageFlags usage,
+	std::vector<vk::DeviceSize> mipOffsets,
+	vk::DeviceSize stagingSize
+)
+	: Image(width, height, format, vk::ImageTiling::eOptimal, usage | vk::ImageUsageFlagBits::eTransferDst, vk::ImageAspectFlagBits::eColor,
+		vk::ImageViewType::e2D, static_cast<uint32_t>(mipOffsets.size()), 1)
+	, m_depth(0)
+	, m_stagingBuffer(std::make_unique<UniqueBuffer>(
+		vk::BufferCreateInfo({}, stagingSize, vk::BufferUsageFlagBits::eTransferSrc),
+		VmaAllocationCreateInfo{ VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, }
+	))
+	, m_mipOffsets(std::move(mipOffsets))
+{
+}
+
 void Texture::UploadStagingToGPU(vk::CommandBuffer& commandBuffer, vk::ImageLayout dstImageLayout)
 {
 	if (m_imageLayout == vk::ImageLayout::eUndefined)
 		TransitionLayout(commandBuffer, vk::ImageLayout::eTransferDstOptimal);
 
+	CopyStagingToImage(commandBuffer);
+
+	if (HasMipsToGenerate())
+		GenerateMipmaps(commandBuffer, dstImageLayout); // transfers the image layout for each mip level
+	else
+		TransitionLayout(commandBuffer, dstImageLayout);
+}
+
+void Texture::CopyStagingToImage(vk::CommandBuffer& commandBuffer)
+{
+	assert(m_imageLayout == vk::ImageLayout::eTransferDstOptimal);
+
+	if (!m_mipOffsets.empty())
+	{
+		// Copy all mip levels from the staging buffer
+		std::vector<vk::BufferImageCopy> regions;
+		regions.reserve(m_mipOffsets.size());
+		for (uint32_t mipLevel = 0; mipLevel < m_mipOffsets.size(); ++mipLevel)
+		{
+			regions.emplace_back(
+				m_mipOffsets[mipLevel], // bufferOffset
+				0UL, // bufferRowLength
+				0UL, // bufferImageHeight
+				vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, mipLevel, 0, m_layerCount),
+				vk::Offset3D(0, 0, 0),
+				vk::Extent3D((std::max)(m_extent.width >> mipLevel, 1u), (std::max)(m_extent.height >> mipLevel, 1u), 1)
+			);
+		}
+		commandBuffer.copyBufferToImage(m_stagingBuffer->Get(), m_image.Get(), vk::ImageLayout::eTransferDstOptimal, regions);
+		return;
+	}
+
 	// Copy staging buffer to image
 	vk::BufferImageCopy region(
 		vk::DeviceSize(0), // bufferOffset
@@ -40,11 +92,6 @@ void Texture::UploadStagingToGPU(vk::CommandBuffer& commandBuffer, vk::ImageLayo
 		vk::Offset3D(0, 0, 0), m_extent
 	);
 	commandBuffer.copyBufferToImage(m_stagingBuffer->Get(), m_image.Get(), vk::ImageLayout::eTransferDstOptimal, 1, &region);
-
-	if (m_mipLevels > 1)
-		GenerateMipmaps(commandBuffer, dstImageLayout); // transfers the image layout for each mip level
-	else
-		TransitionLayout(commandBuffer, dstImageLayout);
 }
 
 void Texture::GenerateMipmaps(vk::CommandBuffer& commandBuffer, vk::ImageLayout dstImageLayout)
@@ -60,7 +107,7 @@ void Texture::GenerateMipmaps(vk::CommandBuffer& commandBuffer, vk::ImageLayout
 	barrier.image = m_image.Get();
 	barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;// VK_IMAGE_ASPECT_COLOR_BIT;
 	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
+	barrier.subresourceRange.layerCount = m_layerCount;
 	barrier.subresourceRange.levelCount = 1;
 
 	int32_t mipWidth = m_extent.width;
@@ -87,13 +134,13 @@ void Texture::GenerateMipmaps(vk::CommandBuffer& commandBuffer, vk::ImageLayout
 		blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
 		blit.srcSubresource.mipLevel = i - 1;
 		blit.srcSubresource.baseArrayLayer = 0;
-		blit.srcSubresource.layerCount = 1;
+		blit.srcSubresource.layerCount = m_layerCount;
 		blit.dstOffsets[0] = vk::Offset3D(0, 0, 0);
 		blit.dstOffsets[1] = vk::Offset3D(mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1);
 		blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
 		blit.dstSubresource.mipLevel = i;
 		blit.dstSubresource.baseArrayLayer = 0;
-		blit.dstSubresource.layerCount = 1;
+		blit.dstSubresource.layerCount = m_layerCount;
 
 		commandBuffer.blitImage(
 			m_image.Get(), vk::ImageLayout::eTransferSrcOptimal,
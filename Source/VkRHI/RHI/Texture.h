@@ -4,6 +4,7 @@
 #include <vulkan/vulkan.hpp>
 
 #include <memory>
+#include <vector>
 
 // An extension of Image to support mipmaps and copying data to the image buffer
 class Texture : public Image
@@ -23,6 +24,16 @@ public:
 		uint32_t layerCount = 1 // e.g. 6 for cube map
 	);
 
+	// Mip levels are copied from the staging buffer instead of generated, level i starts at mipOffsets[i].
+	// For formats that can't be blitted, e.g. block-compressed formats.
+	Texture(
+		uint32_t width, uint32_t height,
+		vk::Format format,
+		vk::ImageUsageFlags usage,
+		std::vector<vk::DeviceSize> mipOffsets,
+		vk::DeviceSize stagingSize
+	);
+
 	// Useful for one time upload
 	UniqueBuffer* ReleaseStagingBuffer() { return m_stagingBuffer.release(); }
 
@@ -30,9 +41,18 @@ public:
 
 	void UploadStagingToGPU(vk::CommandBuffer& commandBuffer, vk::ImageLayout dstImageLayout);
 
+	// Copies mip level 0, or all mip levels when they come from the staging buffer.
+	// The image must be in the transfer destination layout, see MakeLayoutBarrier().
+	void CopyStagingToImage(vk::CommandBuffer& commandBuffer);
+
+	// True if mip levels after the first must be generated once the staging buffer is copied
+	bool HasMipsToGenerate() const { return m_mipOffsets.empty() && m_mipLevels > 1; }
+
+	// Blits each mip level from the previous one, for all layers
 	void GenerateMipmaps(vk::CommandBuffer& commandBuffer, vk::ImageLayout dstImageLayout);
 
 private:
 	uint32_t m_depth;
 	std::unique_ptr<UniqueBuffer> m_stagingBuffer;
+	std::vector<vk::DeviceSize> m_mipOffsets; // empty when mip levels are generated
 };
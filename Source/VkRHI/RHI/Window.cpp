@@ -50,6 +50,11 @@ bool Window::ShouldClose() const
 	return glfwWindowShouldClose(m_window) == GLFW_TRUE;
 }
 
+void Window::Close() const
+{
+	glfwSetWindowShouldClose(m_window, GLFW_TRUE);
+}
+
 void Window::PollEvents() const
 {
 	glfwPollEvents();
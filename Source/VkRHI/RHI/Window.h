@@ -23,6 +23,7 @@ public:
 	GLFWwindow* GetGLFWWindow() const { return m_window; }
 
 	bool ShouldClose() const;
+	void Close() const;
 	void PollEvents() const;
 	void WaitForEvents() const;
 	void SetInputMode(int mode, int value) const;
@@ -290,6 +290,8 @@ namespace spirv_vk
 			return vk::ShaderStageFlagBits::eTessellationControl;
 		case spv::ExecutionModelTessellationEvaluation:
 			return vk::ShaderStageFlagBits::eTessellationEvaluation;
+		case spv::ExecutionModelGLCompute:
+			return vk::ShaderStageFlagBits::eCompute;
 		default:
 			throw std::runtime_error("Unknown execution model");
 		}